@@ -7,19 +7,29 @@ language: C++11 not required
 source: no source file needed
 
 class:
+	aes_cipher
+	aes128_cipher
+	aes192_cipher
 	aes256_cipher
+
+functions:
+	bool aes_known_answer_test()
+	void secure_wipe(void* p, std::size_t n)
 */
 
 #pragma once
 
 #include <assert.h>
+#include <cstddef>
 
 
 namespace crypto{
 
-		// CLASS Aes_types
-	class Aes_types
-	{   // types used in the AES implementation
+		// TEMPLATE CLASS Aes_tables
+template<class Dummy = void>
+	class Aes_tables
+	{   // types and lookup tables used in the AES implementation
+		// (a template, so the tables may be defined in this header)
 protected:
   #ifdef _MSC_VER
 	typedef unsigned __int8 B;
@@ -32,7 +42,7 @@ public:
 	typedef B bit8;
 	typedef W bit32;
 
-	static const bit32 Rcon[];
+	static const bit32 Rcon[10];
 	static const bit8 T2[256];
 	static const bit8 T3[256];
 	static const bit8 T9[256];
@@ -43,13 +53,15 @@ public:
 	static const bit8 Rsbox[256];
 	};
 
-const Aes_types::bit32 Aes_types::Rcon[] = {  // Rijndael RCON Table
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit32 Aes_tables<Dummy>::Rcon[10] = {  // Rijndael RCON Table
 	0x01000000,0x02000000,0x04000000,0x08000000,
 	0x10000000,0x20000000,0x40000000,0x80000000,
 	0x1B000000,0x36000000};
 
 //Rijndel Galois Multiplication lookup tables
-const Aes_types::bit8 Aes_types::T2[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T2[256] = {
 	0x00,0x02,0x04,0x06,0x08,0x0a,0x0c,0x0e,0x10,0x12,0x14,0x16,0x18,0x1a,0x1c,0x1e,
 	0x20,0x22,0x24,0x26,0x28,0x2a,0x2c,0x2e,0x30,0x32,0x34,0x36,0x38,0x3a,0x3c,0x3e,
 	0x40,0x42,0x44,0x46,0x48,0x4a,0x4c,0x4e,0x50,0x52,0x54,0x56,0x58,0x5a,0x5c,0x5e,
@@ -66,7 +78,8 @@ const Aes_types::bit8 Aes_types::T2[256] = {
 	0xbb,0xb9,0xbf,0xbd,0xb3,0xb1,0xb7,0xb5,0xab,0xa9,0xaf,0xad,0xa3,0xa1,0xa7,0xa5,
 	0xdb,0xd9,0xdf,0xdd,0xd3,0xd1,0xd7,0xd5,0xcb,0xc9,0xcf,0xcd,0xc3,0xc1,0xc7,0xc5,
 	0xfb,0xf9,0xff,0xfd,0xf3,0xf1,0xf7,0xf5,0xeb,0xe9,0xef,0xed,0xe3,0xe1,0xe7,0xe5};
-const Aes_types::bit8 Aes_types::T3[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T3[256] = {
 	0x00,0x03,0x06,0x05,0x0c,0x0f,0x0a,0x09,0x18,0x1b,0x1e,0x1d,0x14,0x17,0x12,0x11,
 	0x30,0x33,0x36,0x35,0x3c,0x3f,0x3a,0x39,0x28,0x2b,0x2e,0x2d,0x24,0x27,0x22,0x21,
 	0x60,0x63,0x66,0x65,0x6c,0x6f,0x6a,0x69,0x78,0x7b,0x7e,0x7d,0x74,0x77,0x72,0x71,
@@ -83,7 +96,8 @@ const Aes_types::bit8 Aes_types::T3[256] = {
 	0x6b,0x68,0x6d,0x6e,0x67,0x64,0x61,0x62,0x73,0x70,0x75,0x76,0x7f,0x7c,0x79,0x7a,
 	0x3b,0x38,0x3d,0x3e,0x37,0x34,0x31,0x32,0x23,0x20,0x25,0x26,0x2f,0x2c,0x29,0x2a,
 	0x0b,0x08,0x0d,0x0e,0x07,0x04,0x01,0x02,0x13,0x10,0x15,0x16,0x1f,0x1c,0x19,0x1a};
-const Aes_types::bit8 Aes_types::T9[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T9[256] = {
 	0x00,0x09,0x12,0x1b,0x24,0x2d,0x36,0x3f,0x48,0x41,0x5a,0x53,0x6c,0x65,0x7e,0x77,
 	0x90,0x99,0x82,0x8b,0xb4,0xbd,0xa6,0xaf,0xd8,0xd1,0xca,0xc3,0xfc,0xf5,0xee,0xe7,
 	0x3b,0x32,0x29,0x20,0x1f,0x16,0x0d,0x04,0x73,0x7a,0x61,0x68,0x57,0x5e,0x45,0x4c,
@@ -100,7 +114,8 @@ const Aes_types::bit8 Aes_types::T9[256] = {
 	0x0a,0x03,0x18,0x11,0x2e,0x27,0x3c,0x35,0x42,0x4b,0x50,0x59,0x66,0x6f,0x74,0x7d,
 	0xa1,0xa8,0xb3,0xba,0x85,0x8c,0x97,0x9e,0xe9,0xe0,0xfb,0xf2,0xcd,0xc4,0xdf,0xd6,
 	0x31,0x38,0x23,0x2a,0x15,0x1c,0x07,0x0e,0x79,0x70,0x6b,0x62,0x5d,0x54,0x4f,0x46};
-const Aes_types::bit8 Aes_types::T11[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T11[256] = {
 	0x00,0x0b,0x16,0x1d,0x2c,0x27,0x3a,0x31,0x58,0x53,0x4e,0x45,0x74,0x7f,0x62,0x69,
 	0xb0,0xbb,0xa6,0xad,0x9c,0x97,0x8a,0x81,0xe8,0xe3,0xfe,0xf5,0xc4,0xcf,0xd2,0xd9,
 	0x7b,0x70,0x6d,0x66,0x57,0x5c,0x41,0x4a,0x23,0x28,0x35,0x3e,0x0f,0x04,0x19,0x12,
@@ -117,7 +132,8 @@ const Aes_types::bit8 Aes_types::T11[256] = {
 	0xb1,0xba,0xa7,0xac,0x9d,0x96,0x8b,0x80,0xe9,0xe2,0xff,0xf4,0xc5,0xce,0xd3,0xd8,
 	0x7a,0x71,0x6c,0x67,0x56,0x5d,0x40,0x4b,0x22,0x29,0x34,0x3f,0x0e,0x05,0x18,0x13,
 	0xca,0xc1,0xdc,0xd7,0xe6,0xed,0xf0,0xfb,0x92,0x99,0x84,0x8f,0xbe,0xb5,0xa8,0xa3};
-const Aes_types::bit8 Aes_types::T13[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T13[256] = {
 	0x00,0x0d,0x1a,0x17,0x34,0x39,0x2e,0x23,0x68,0x65,0x72,0x7f,0x5c,0x51,0x46,0x4b,
 	0xd0,0xdd,0xca,0xc7,0xe4,0xe9,0xfe,0xf3,0xb8,0xb5,0xa2,0xaf,0x8c,0x81,0x96,0x9b,
 	0xbb,0xb6,0xa1,0xac,0x8f,0x82,0x95,0x98,0xd3,0xde,0xc9,0xc4,0xe7,0xea,0xfd,0xf0,
@@ -134,7 +150,8 @@ const Aes_types::bit8 Aes_types::T13[256] = {
 	0x67,0x6a,0x7d,0x70,0x53,0x5e,0x49,0x44,0x0f,0x02,0x15,0x18,0x3b,0x36,0x21,0x2c,
 	0x0c,0x01,0x16,0x1b,0x38,0x35,0x22,0x2f,0x64,0x69,0x7e,0x73,0x50,0x5d,0x4a,0x47,
 	0xdc,0xd1,0xc6,0xcb,0xe8,0xe5,0xf2,0xff,0xb4,0xb9,0xae,0xa3,0x80,0x8d,0x9a,0x97};
-const Aes_types::bit8 Aes_types::T14[256] = {
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::T14[256] = {
 	0x00,0x0e,0x1c,0x12,0x38,0x36,0x24,0x2a,0x70,0x7e,0x6c,0x62,0x48,0x46,0x54,0x5a,
 	0xe0,0xee,0xfc,0xf2,0xd8,0xd6,0xc4,0xca,0x90,0x9e,0x8c,0x82,0xa8,0xa6,0xb4,0xba,
 	0xdb,0xd5,0xc7,0xc9,0xe3,0xed,0xff,0xf1,0xab,0xa5,0xb7,0xb9,0x93,0x9d,0x8f,0x81,
@@ -152,7 +169,8 @@ const Aes_types::bit8 Aes_types::T14[256] = {
 	0x37,0x39,0x2b,0x25,0x0f,0x01,0x13,0x1d,0x47,0x49,0x5b,0x55,0x7f,0x71,0x63,0x6d,
 	0xd7,0xd9,0xcb,0xc5,0xef,0xe1,0xf3,0xfd,0xa7,0xa9,0xbb,0xb5,0x9f,0x91,0x83,0x8d};
 
-const Aes_types::bit8 Aes_types::Sbox[256] = {  // Rijndael S-BOX
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::Sbox[256] = {  // Rijndael S-BOX
 	0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
 	0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
 	0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
@@ -169,7 +187,8 @@ const Aes_types::bit8 Aes_types::Sbox[256] = {  // Rijndael S-BOX
 	0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
 	0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
 	0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16};
-const Aes_types::bit8 Aes_types::Rsbox[256] = { // Rijndael reverse S-BOX
+template<class Dummy>
+	const typename Aes_tables<Dummy>::bit8 Aes_tables<Dummy>::Rsbox[256] = { // Rijndael reverse S-BOX
 	0x52,0x09,0x6a,0xd5,0x30,0x36,0xa5,0x38,0xbf,0x40,0xa3,0x9e,0x81,0xf3,0xd7,0xfb,
 	0x7c,0xe3,0x39,0x82,0x9b,0x2f,0xff,0x87,0x34,0x8e,0x43,0x44,0xc4,0xde,0xe9,0xcb,
 	0x54,0x7b,0x94,0x32,0xa6,0xc2,0x23,0x3d,0xee,0x4c,0x95,0x0b,0x42,0xfa,0xc3,0x4e,
@@ -187,228 +206,290 @@ const Aes_types::bit8 Aes_types::Rsbox[256] = { // Rijndael reverse S-BOX
 	0xa0,0xe0,0x3b,0x4d,0xae,0x2a,0xf5,0xb0,0xc8,0xeb,0xbb,0x3c,0x83,0x53,0x99,0x61,
 	0x17,0x2b,0x04,0x7e,0xba,0x77,0xd6,0x26,0xe1,0x69,0x14,0x63,0x55,0x21,0x0c,0x7d};
 
-		// TEMPLATE CLASS Aes256_cipher
-template<class Types>
-	class Aes256_cipher
+		// CLASS Aes_types
+	class Aes_types
+		: public Aes_tables<>
+	{   // types and tables used in the AES implementation
+	};
+
+/*
+TEMPLATE CLASS Aes_cipher
+
+AES block cipher (FIPS-197) for all three key lengths.
+the key length is a template parameter, thus the number of rounds and the
+size of the key schedule are compile time constants.
+
+Nk:  4 -> AES-128 (10 rounds)
+     6 -> AES-192 (12 rounds)
+     8 -> AES-256 (14 rounds)
+
+-> notice: blocks are 16 bytes in the byte order of FIPS-197 (column by column)
+-> notice: key words are big endian numbers, e.g. key 00 01 02 03 ... -> 0x00010203
+-> usage:   aes128_cipher c;
+			c.initialize(key);       // 16 key bytes or 4 key words
+			c.encrypt_block(block);  // 16 bytes, in place
+*/
+
+		// TEMPLATE CLASS Aes_cipher
+template<int Nk, class Types = Aes_types>
+	class Aes_cipher
 		: protected Types
-	{   // AES-256 cipher (blocksize: 128bit; keylen: 256bit)
+	{   // AES cipher (blocksize: 128bit; keylen: Nk*32bit)
 private:
 	typedef Types Mybase;
 	typedef typename Mybase::W W;
 	typedef typename Mybase::B B;
+	using Mybase::Rcon;   // tables of a dependent base class have to be
+	using Mybase::T2;     // made visible explicitly (two-phase lookup)
+	using Mybase::T3;
+	using Mybase::T9;
+	using Mybase::T11;
+	using Mybase::T13;
+	using Mybase::T14;
+	using Mybase::Sbox;
+	using Mybase::Rsbox;
+
+	typedef char Nk_check[(Nk==4 || Nk==6 || Nk==8) ? 1 : -1]; // only AES-128/192/256
 public:
 	typedef typename Mybase::bit32 bit32;
 	typedef typename Mybase::bit8 bit8;
 
+	enum {
+		key_words = Nk,                 // keylength in 32bit words
+		key_bytes = 4*Nk,               // keylength in bytes
+		block_bytes = 16,               // blocksize in bytes
+		rounds = Nk+6,                  // number of rounds
+		schedule_words = 4*(Nk+6+1)     // number of round key words
+		};
+
 	void initialize(const W* k)
-		{   // initialize cipher and create round keys (keylen=8)
-		//magic number: 4->blocksize in 32bit words
-		//              8->keylength in 32bit words
-		//             14->number of rounds
-		//             60->4*(14+1)
+		{   // initialize cipher and create round keys (key as Nk words)
+		assert(k);
+		W w[schedule_words];
+		for(int i=0; i<Nk; ++i)
+			w[i] = k[i];
+		Expand(w);
+		}
+
+	void initialize(const B* k)
+		{   // initialize cipher and create round keys (key as 4*Nk bytes)
 		assert(k);
-		MyKeys[0] = k[0];
-		MyKeys[1] = k[1];
-		MyKeys[2] = k[2];
-		MyKeys[3] = k[3];
-		MyKeys[4] = k[4];
-		MyKeys[5] = k[5];
-		MyKeys[6] = k[6];
-		MyKeys[7] = k[7];
-		for(B i=8; i<60; ++i)
+		W w[schedule_words];
+		for(int i=0; i<Nk; ++i, k+=4)
+			w[i] = (W(k[0])<<24) | (W(k[1])<<16) | (W(k[2])<<8) | W(k[3]);
+		Expand(w);
+		}
+
+	void encrypt_block(B* b) const
+		{   // encrypt one block in place
+		assert(b);
+		Add_round_key(b, 0);
+		for(int r=1; r<rounds; ++r)
 			{
-			B imod8 = i&7;
-			W tmp = MyKeys[i-1];
-			if(imod8==0)
-				{
-				tmp = (tmp<<8)|(tmp>>24);
-				B* p=(B*)(&tmp);
-				p[0] = Sbox[p[0]]; p[1] = Sbox[p[1]];
-				p[2] = Sbox[p[2]]; p[3] = Sbox[p[3]];
-				tmp = *((W*)p);
-				tmp ^= Rcon[i/8];
-				}
-			else if(imod8==4)
-				{
-				B* p=(B*)(&tmp);
-				p[0] = Sbox[p[0]]; p[1] = Sbox[p[1]];
-				p[2] = Sbox[p[2]]; p[3] = Sbox[p[3]];
-				tmp = *((W*)p);
-				}
-			MyKeys[i] = MyKeys[i-8] ^ tmp;
+			Sub_shift(b);
+			Mix_columns(b);
+			Add_round_key(b, r);
 			}
+		Sub_shift(b);
+		Add_round_key(b, rounds);
 		}
 
-	void encrypt_block(B* b)
-		{
+	void decrypt_block(B* b) const
+		{   // decrypt one block in place
 		assert(b);
-		B cpy[4];
-		*((W*)b) ^= MyKeys[0];    // add roundkey
-		*((W*)(b+4)) ^= MyKeys[1];
-		*((W*)(b+8)) ^= MyKeys[2];
-		*((W*)(b+12)) ^= MyKeys[3];
+		Add_round_key(b, rounds);
+		for(int r=rounds-1; r>0; --r)
+			{
+			Inv_sub_shift(b);
+			Add_round_key(b, r);
+			Inv_mix_columns(b);
+			}
+		Inv_sub_shift(b);
+		Add_round_key(b, 0);
+		}
 
-		for(B r=1; r<14; ++r)
+private:
+	void Expand(W* w)
+		{   // expand the key (w[0..Nk)) to the full schedule
+		for(int i=Nk; i<schedule_words; ++i)
 			{
-			b[ 0] = Sbox[b[ 0]]; b[ 1] = Sbox[b[ 1]];   // sub bytes
-			b[ 2] = Sbox[b[ 2]]; b[ 3] = Sbox[b[ 3]];
-			b[ 4] = Sbox[b[ 4]]; b[ 5] = Sbox[b[ 5]];
-			b[ 6] = Sbox[b[ 6]]; b[ 7] = Sbox[b[ 7]];
-			b[ 8] = Sbox[b[ 8]]; b[ 9] = Sbox[b[ 9]];
-			b[10] = Sbox[b[10]]; b[11] = Sbox[b[11]];
-			b[12] = Sbox[b[12]]; b[13] = Sbox[b[13]];
-			b[14] = Sbox[b[14]]; b[15] = Sbox[b[15]];
-
-			*((W*)(b+4)) = ((*((W*)(b+4))<< 8)|(*((W*)(b+4))>>24)); // shift rows left
-			*((W*)(b+8)) = ((*((W*)(b+8))<<16)|(*((W*)(b+8))>>16));
-			*((W*)(b+12)) = ((*((W*)(b+12))<<24)|(*((W*)(b+12))>> 8));
-
-			// mix columns
-			cpy[0] = b[ 0];
-			cpy[1] = b[ 4];
-			cpy[2] = b[ 8];
-			cpy[3] = b[12];
-			b[ 0] =  T2[cpy[0]] ^ T3[cpy[1]] ^    cpy[2]  ^    cpy[3];
-			b[ 4] =     cpy[0]  ^ T2[cpy[1]] ^ T3[cpy[2]] ^    cpy[3];
-			b[ 8] =     cpy[0]  ^    cpy[1]  ^ T2[cpy[2]] ^ T3[cpy[3]];
-			b[12] =  T3[cpy[0]] ^    cpy[1]  ^    cpy[2]  ^ T2[cpy[3]];
-			cpy[0] = b[ 1];
-			cpy[1] = b[ 5];
-			cpy[2] = b[ 9];
-			cpy[3] = b[13];
-			b[ 1] =  T2[cpy[0]] ^ T3[cpy[1]] ^    cpy[2]  ^    cpy[3];
-			b[ 5] =     cpy[0]  ^ T2[cpy[1]] ^ T3[cpy[2]] ^    cpy[3];
-			b[ 9] =     cpy[0]  ^    cpy[1]  ^ T2[cpy[2]] ^ T3[cpy[3]];
-			b[13] =  T3[cpy[0]] ^    cpy[1]  ^    cpy[2]  ^ T2[cpy[3]];
-			cpy[0] = b[ 2];
-			cpy[1] = b[ 6];
-			cpy[2] = b[10];
-			cpy[3] = b[14];
-			b[ 2] =  T2[cpy[0]] ^ T3[cpy[1]] ^    cpy[2]  ^    cpy[3];
-			b[ 6] =     cpy[0]  ^ T2[cpy[1]] ^ T3[cpy[2]] ^    cpy[3];
-			b[10] =     cpy[0]  ^    cpy[1]  ^ T2[cpy[2]] ^ T3[cpy[3]];
-			b[14] =  T3[cpy[0]] ^    cpy[1]  ^    cpy[2]  ^ T2[cpy[3]];
-			cpy[0] = b[ 3];
-			cpy[1] = b[ 7];
-			cpy[2] = b[11];
-			cpy[3] = b[15];
-			b[ 3] =  T2[cpy[0]] ^ T3[cpy[1]] ^    cpy[2]  ^    cpy[3];
-			b[ 7] =     cpy[0]  ^ T2[cpy[1]] ^ T3[cpy[2]] ^    cpy[3];
-			b[11] =     cpy[0]  ^    cpy[1]  ^ T2[cpy[2]] ^ T3[cpy[3]];
-			b[15] =  T3[cpy[0]] ^    cpy[1]  ^    cpy[2]  ^ T2[cpy[3]];
-
-			*((W*)b) ^= MyKeys[r*4  ];   // add roundkey
-			*((W*)(b+4)) ^= MyKeys[r*4+1];
-			*((W*)(b+8)) ^= MyKeys[r*4+2];
-			*((W*)(b+12)) ^= MyKeys[r*4+3];
+			W tmp = w[i-1];
+			if(i%Nk == 0)
+				tmp = Sub_word((tmp<<8)|(tmp>>24)) ^ Rcon[i/Nk-1]; // rotate, substitute
+			else if(Nk > 6 && i%Nk == 4)
+				tmp = Sub_word(tmp);
+			w[i] = w[i-Nk] ^ tmp;
 			}
 
-		b[ 0] = Sbox[b[ 0]]; b[ 1] = Sbox[b[ 1]];   // sub bytes
-		b[ 2] = Sbox[b[ 2]]; b[ 3] = Sbox[b[ 3]];
-		b[ 4] = Sbox[b[ 4]]; b[ 5] = Sbox[b[ 5]];
-		b[ 6] = Sbox[b[ 6]]; b[ 7] = Sbox[b[ 7]];
-		b[ 8] = Sbox[b[ 8]]; b[ 9] = Sbox[b[ 9]];
-		b[10] = Sbox[b[10]]; b[11] = Sbox[b[11]];
-		b[12] = Sbox[b[12]]; b[13] = Sbox[b[13]];
-		b[14] = Sbox[b[14]]; b[15] = Sbox[b[15]];
-
-		*((W*)(b+4)) = ((*((W*)(b+4))<< 8)|(*((W*)(b+4))>>24)); // shift rows left
-		*((W*)(b+8)) = ((*((W*)(b+8))<<16)|(*((W*)(b+8))>>16));
-		*((W*)(b+12)) = ((*((W*)(b+12))<<24)|(*((W*)(b+12))>> 8));
-
-		*((W*)b) ^= MyKeys[108];   // add roundkey
-		*((W*)(b+4)) ^= MyKeys[109];
-		*((W*)(b+8)) ^= MyKeys[110];
-		*((W*)(b+12)) ^= MyKeys[111];
+		for(int i=0; i<schedule_words; ++i)
+			{   // store round keys in the byte order of the state
+			MyKeys[4*i  ] = B(w[i]>>24);
+			MyKeys[4*i+1] = B(w[i]>>16);
+			MyKeys[4*i+2] = B(w[i]>> 8);
+			MyKeys[4*i+3] = B(w[i]    );
+			}
 		}
 
-	void decrypt_block(B* b)
-		{
-		assert(b);
-		B cpy[4];
-		*((W*)b) ^= MyKeys[108];   // add roundkey
-		*((W*)(b+4)) ^= MyKeys[109];
-		*((W*)(b+8)) ^= MyKeys[110];
-		*((W*)(b+12)) ^= MyKeys[111];
+	static W Sub_word(W w)
+		{   // apply the s-box to all bytes of a word
+		return (W(Sbox[(w>>24)&0xff])<<24) | (W(Sbox[(w>>16)&0xff])<<16)
+			 | (W(Sbox[(w>> 8)&0xff])<< 8) |  W(Sbox[ w     &0xff]);
+		}
+
+	void Add_round_key(B* b, int r) const
+		{   // xor round key r
+		const B* k = MyKeys + 16*r;
+		for(int i=0; i<16; ++i)
+			b[i] ^= k[i];
+		}
+
+	static void Sub_shift(B* b)
+		{   // sub bytes and shift rows left (state: b[4*column+row])
+		B t;
+		b[ 0] = Sbox[b[ 0]]; b[ 4] = Sbox[b[ 4]];   // row 0: no shift
+		b[ 8] = Sbox[b[ 8]]; b[12] = Sbox[b[12]];
+		t = b[ 1];                                   // row 1: shift by 1
+		b[ 1] = Sbox[b[ 5]]; b[ 5] = Sbox[b[ 9]];
+		b[ 9] = Sbox[b[13]]; b[13] = Sbox[t];
+		t = b[ 2];                                   // row 2: shift by 2
+		b[ 2] = Sbox[b[10]]; b[10] = Sbox[t];
+		t = b[ 6];
+		b[ 6] = Sbox[b[14]]; b[14] = Sbox[t];
+		t = b[15];                                   // row 3: shift by 3
+		b[15] = Sbox[b[11]]; b[11] = Sbox[b[ 7]];
+		b[ 7] = Sbox[b[ 3]]; b[ 3] = Sbox[t];
+		}
+
+	static void Inv_sub_shift(B* b)
+		{   // inverse sub bytes and shift rows right
+		B t;
+		b[ 0] = Rsbox[b[ 0]]; b[ 4] = Rsbox[b[ 4]];  // row 0: no shift
+		b[ 8] = Rsbox[b[ 8]]; b[12] = Rsbox[b[12]];
+		t = b[13];                                   // row 1: shift by 1
+		b[13] = Rsbox[b[ 9]]; b[ 9] = Rsbox[b[ 5]];
+		b[ 5] = Rsbox[b[ 1]]; b[ 1] = Rsbox[t];
+		t = b[ 2];                                   // row 2: shift by 2
+		b[ 2] = Rsbox[b[10]]; b[10] = Rsbox[t];
+		t = b[ 6];
+		b[ 6] = Rsbox[b[14]]; b[14] = Rsbox[t];
+		t = b[ 3];                                   // row 3: shift by 3
+		b[ 3] = Rsbox[b[ 7]]; b[ 7] = Rsbox[b[11]];
+		b[11] = Rsbox[b[15]]; b[15] = Rsbox[t];
+		}
 
-		for(B r=13; r>0; --r)
+	static void Mix_columns(B* b)
+		{   // mix columns
+		for(int c=0; c<16; c+=4)
 			{
-			*((W*)(b+4)) = ((*((W*)(b+4))>> 8)|(*((W*)(b+4))<<24));  // shift rows right
-			*((W*)(b+8)) = ((*((W*)(b+8))>>16)|(*((W*)(b+8))<<16));
-			*((W*)(b+12)) = ((*((W*)(b+12))>>24)|(*((W*)(b+12))<< 8));
-
-			b[ 0] = Rsbox[b[ 0]]; b[ 1] = Rsbox[b[ 1]];  // inverse sub bytes
-			b[ 2] = Rsbox[b[ 2]]; b[ 3] = Rsbox[b[ 3]];
-			b[ 4] = Rsbox[b[ 4]]; b[ 5] = Rsbox[b[ 5]];
-			b[ 6] = Rsbox[b[ 6]]; b[ 7] = Rsbox[b[ 7]];
-			b[ 8] = Rsbox[b[ 8]]; b[ 9] = Rsbox[b[ 9]];
-			b[10] = Rsbox[b[10]]; b[11] = Rsbox[b[11]];
-			b[12] = Rsbox[b[12]]; b[13] = Rsbox[b[13]];
-			b[14] = Rsbox[b[14]]; b[15] = Rsbox[b[15]];
-
-			*((W*)b) ^= MyKeys[r*4  ];   // add roundkey
-			*((W*)(b+4)) ^= MyKeys[r*4+1];
-			*((W*)(b+8)) ^= MyKeys[r*4+2];
-			*((W*)(b+12)) ^= MyKeys[r*4+3];
-
-			// inverse mix columns
-			cpy[0] = b[ 0];
-			cpy[1] = b[ 4];
-			cpy[2] = b[ 8];
-			cpy[3] = b[12];
-			b[ 0] =  T14[cpy[0]] ^ T11[cpy[1]] ^ T13[cpy[2]] ^ T9 [cpy[3]];
-			b[ 4] =  T9 [cpy[0]] ^ T14[cpy[1]] ^ T11[cpy[2]] ^ T13[cpy[3]];
-			b[ 8] =  T13[cpy[0]] ^ T9 [cpy[1]] ^ T14[cpy[2]] ^ T11[cpy[3]];
-			b[12] =  T11[cpy[0]] ^ T13[cpy[1]] ^ T9 [cpy[2]] ^ T14[cpy[3]];
-			cpy[0] = b[ 1];
-			cpy[1] = b[ 5];
-			cpy[2] = b[ 9];
-			cpy[3] = b[13];
-			b[   1] =  T14[cpy[0]] ^ T11[cpy[1]] ^ T13[cpy[2]] ^ T9 [cpy[3]];
-			b[ 4+1] =  T9 [cpy[0]] ^ T14[cpy[1]] ^ T11[cpy[2]] ^ T13[cpy[3]];
-			b[ 8+1] =  T13[cpy[0]] ^ T9 [cpy[1]] ^ T14[cpy[2]] ^ T11[cpy[3]];
-			b[12+1] =  T11[cpy[0]] ^ T13[cpy[1]] ^ T9 [cpy[2]] ^ T14[cpy[3]];
-			cpy[0] = b[ 2];
-			cpy[1] = b[ 6];
-			cpy[2] = b[10];
-			cpy[3] = b[14];
-			b[ 2] =  T14[cpy[0]] ^ T11[cpy[1]] ^ T13[cpy[2]] ^ T9 [cpy[3]];
-			b[ 6] =  T9 [cpy[0]] ^ T14[cpy[1]] ^ T11[cpy[2]] ^ T13[cpy[3]];
-			b[10] =  T13[cpy[0]] ^ T9 [cpy[1]] ^ T14[cpy[2]] ^ T11[cpy[3]];
-			b[14] =  T11[cpy[0]] ^ T13[cpy[1]] ^ T9 [cpy[2]] ^ T14[cpy[3]];
-			cpy[0] = b[ 3];
-			cpy[1] = b[ 7];
-			cpy[2] = b[11];
-			cpy[3] = b[15];
-			b[ 3] =  T14[cpy[0]] ^ T11[cpy[1]] ^ T13[cpy[2]] ^ T9 [cpy[3]];
-			b[ 7] =  T9 [cpy[0]] ^ T14[cpy[1]] ^ T11[cpy[2]] ^ T13[cpy[3]];
-			b[11] =  T13[cpy[0]] ^ T9 [cpy[1]] ^ T14[cpy[2]] ^ T11[cpy[3]];
-			b[15] =  T11[cpy[0]] ^ T13[cpy[1]] ^ T9 [cpy[2]] ^ T14[cpy[3]];
+			const B a0 = b[c], a1 = b[c+1], a2 = b[c+2], a3 = b[c+3];
+			b[c  ] =  T2[a0] ^ T3[a1] ^    a2  ^    a3;
+			b[c+1] =     a0  ^ T2[a1] ^ T3[a2] ^    a3;
+			b[c+2] =     a0  ^    a1  ^ T2[a2] ^ T3[a3];
+			b[c+3] =  T3[a0] ^    a1  ^    a2  ^ T2[a3];
 			}
+		}
 
-		*((W*)(b+4)) = ((*((W*)(b+4))>> 8)|(*((W*)(b+4))<<24));  // shift rows right
-		*((W*)(b+8)) = ((*((W*)(b+8))>>16)|(*((W*)(b+8))<<16));
-		*((W*)(b+12)) = ((*((W*)(b+12))>>24)|(*((W*)(b+12))<< 8));
-
-		b[ 0] = Rsbox[b[ 0]]; b[ 1] = Rsbox[b[ 1]];  // inverse sub bytes
-		b[ 2] = Rsbox[b[ 2]]; b[ 3] = Rsbox[b[ 3]];
-		b[ 4] = Rsbox[b[ 4]]; b[ 5] = Rsbox[b[ 5]];
-		b[ 6] = Rsbox[b[ 6]]; b[ 7] = Rsbox[b[ 7]];
-		b[ 8] = Rsbox[b[ 8]]; b[ 9] = Rsbox[b[ 9]];
-		b[10] = Rsbox[b[10]]; b[11] = Rsbox[b[11]];
-		b[12] = Rsbox[b[12]]; b[13] = Rsbox[b[13]];
-		b[14] = Rsbox[b[14]]; b[15] = Rsbox[b[15]];
-
-		*((W*)b) ^= MyKeys[0];    // add roundkey
-		*((W*)(b+4)) ^= MyKeys[1];
-		*((W*)(b+8)) ^= MyKeys[2];
-		*((W*)(b+12)) ^= MyKeys[3];
+	static void Inv_mix_columns(B* b)
+		{   // inverse mix columns
+		for(int c=0; c<16; c+=4)
+			{
+			const B a0 = b[c], a1 = b[c+1], a2 = b[c+2], a3 = b[c+3];
+			b[c  ] =  T14[a0] ^ T11[a1] ^ T13[a2] ^ T9 [a3];
+			b[c+1] =  T9 [a0] ^ T14[a1] ^ T11[a2] ^ T13[a3];
+			b[c+2] =  T13[a0] ^ T9 [a1] ^ T14[a2] ^ T11[a3];
+			b[c+3] =  T11[a0] ^ T13[a1] ^ T9 [a2] ^ T14[a3];
+			}
 		}
 
-private:
-	W MyKeys[112];
+	B MyKeys[4*schedule_words]; // round keys (16 bytes per round)
 	};
 
+		// TEMPLATE CLASS Aes256_cipher
+template<class Types>
+	class Aes256_cipher
+		: public Aes_cipher<8, Types>
+	{   // AES-256 cipher (blocksize: 128bit; keylen: 256bit)
+	};
+
+	typedef Aes_cipher<4> aes128_cipher;
+	typedef Aes_cipher<6> aes192_cipher;
 	typedef Aes256_cipher<Aes_types> aes256_cipher;
 
+
+/*
+FUNCTION aes_known_answer_test
+
+encrypt and decrypt the example vectors of FIPS-197 (appendix C)
+with all three key lengths. returns true if all results are correct.
+*/
+
+	// TEMPLATE FUNCTION Aes_known_answer
+template<class Cipher>
+	bool Aes_known_answer(const Aes_types::bit8* expected)
+	{   // test one key length (key: 00 01 02 ..., plaintext: 00 11 22 ...)
+	typedef Aes_types::bit8 B;
+	B key[32];
+	B block[16];
+	B plain[16];
+	for(int i=0; i<32; ++i)
+		key[i] = B(i);
+	for(int i=0; i<16; ++i)
+		plain[i] = block[i] = B(i*0x11);
+
+	Cipher c;
+	c.initialize(key);
+	c.encrypt_block(block);
+	for(int i=0; i<16; ++i)
+		if(block[i] != expected[i])
+			return false;
+	c.decrypt_block(block);
+	for(int i=0; i<16; ++i)
+		if(block[i] != plain[i])
+			return false;
+
+	Aes_types::bit32 words[8]; // the same key as words has to give the same result
+	for(int i=0; i<8; ++i)
+		words[i] = (Aes_types::bit32(key[4*i])<<24) | (Aes_types::bit32(key[4*i+1])<<16)
+				 | (Aes_types::bit32(key[4*i+2])<<8) | Aes_types::bit32(key[4*i+3]);
+	Cipher w;
+	w.initialize(words);
+	w.encrypt_block(block);
+	for(int i=0; i<16; ++i)
+		if(block[i] != expected[i])
+			return false;
+	return true;
+	}
+
+	// FUNCTION aes_known_answer_test
+inline bool aes_known_answer_test()
+	{   // FIPS-197 appendix C.1, C.2 and C.3
+	static const Aes_types::bit8 c128[16] = {
+		0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a};
+	static const Aes_types::bit8 c192[16] = {
+		0xdd,0xa9,0x7c,0xa4,0x86,0x4c,0xdf,0xe0,0x6e,0xaf,0x70,0xa0,0xec,0x0d,0x71,0x91};
+	static const Aes_types::bit8 c256[16] = {
+		0x8e,0xa2,0xb7,0xca,0x51,0x67,0x45,0xbf,0xea,0xfc,0x49,0x90,0x4b,0x49,0x60,0x89};
+	return Aes_known_answer<aes128_cipher>(c128)
+		&& Aes_known_answer<aes192_cipher>(c192)
+		&& Aes_known_answer<aes256_cipher>(c256);
+	}
+
+/*
+FUNCTION secure_wipe
+
+zero n bytes at p, e.g. a key or a key schedule before it is released.
+the stores are volatile, thus the compiler can't drop them as dead stores
+(which it may do with memset or std::fill on an object about to die).
+
+-> notice: p has to be a trivially copyable object (or raw memory)
+*/
+
+	// FUNCTION secure_wipe
+inline void secure_wipe(void* p, std::size_t n)
+	{   // zero n bytes at p (not removed by the optimizer)
+	volatile unsigned char* q = static_cast<volatile unsigned char*>(p);
+	while(n--)
+		*q++ = 0;
+	}
+
 };//end: namespace
\ No newline at end of file
@@ -0,0 +1,140 @@
+// aes256_ctr.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 not required
+source: no source file needed
+
+class:
+	aes256_ctr
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <cstring>
+#include "aes256_cipher.h"
+
+
+namespace crypto{
+
+/*
+TEMPLATE CLASS Aes_ctr
+
+counter mode (NIST SP 800-38A) on top of a block cipher with 128bit blocks.
+the keystream is the encryption of a 128bit big endian counter, which starts
+at the initial counter block (iv). encryption and decryption are the same
+operation. the keystream is generated several blocks at a time.
+
+-> notice: never reuse a key/iv pair for two different messages
+-> notice: counter mode does not authenticate the data
+-> usage:   aes256_ctr ctr;
+			ctr.initialize(key, iv);
+			ctr.process(in, out, n);   // in and out may be the same buffer
+*/
+
+	// TEMPLATE CLASS Aes_ctr
+template<class Cipher>
+	class Aes_ctr
+	{   // CTR mode stream cipher (blocksize: 128bit)
+public:
+	typedef typename Cipher::bit32 bit32;
+	typedef typename Cipher::bit8 bit8;
+	typedef unsigned long long pos_type;
+	typedef std::size_t size_type;
+
+	enum { blocks_per_batch = 8 }; // blocks encrypted per keystream refill
+
+	void initialize(const bit32* key, const bit8* iv)
+		{   // initialize cipher and set initial counter block
+		assert(key && iv);
+		MyCipher.initialize(key);
+		std::memcpy(MyIv, iv, 16);
+		seek(0);
+		}
+
+	void set_iv(const bit8* iv)
+		{   // set another initial counter block (same key), move to position 0
+		assert(iv);
+		std::memcpy(MyIv, iv, 16);
+		seek(0);
+		}
+
+	void seek(pos_type pos)
+		{   // move to byte position pos of the keystream
+		MyPos = pos;
+		MyUsed = sizeof(MyStream);
+		MyStart = pos - pos%sizeof(MyStream);
+		std::memcpy(MyCounter, MyIv, 16);
+		Add(MyCounter, MyStart/16);
+		}
+
+	pos_type position() const
+		{   // current byte position in the keystream
+		return (MyPos);
+		}
+
+	void process(const bit8* in, bit8* out, size_type n)
+		{   // xor n bytes with the keystream (in and out may be equal)
+		assert(n == 0 || (in && out));
+		while(n > 0)
+			{
+			if(MyUsed == sizeof(MyStream))
+				Refill();
+			size_type num = sizeof(MyStream) - MyUsed;
+			if(num > n)
+				num = n;
+			const bit8* ks = MyStream + MyUsed;
+			for(size_type i=0; i<num; ++i)
+				out[i] = in[i] ^ ks[i];
+			in += num;
+			out += num;
+			n -= num;
+			MyUsed += num;
+			MyPos += num;
+			}
+		}
+
+	void process(bit8* b, size_type n)
+		{   // xor n bytes with the keystream in place
+		process(b, b, n);
+		}
+
+private:
+	void Refill()
+		{   // encrypt the next blocks_per_batch counter blocks
+		MyStart = MyPos - MyPos%sizeof(MyStream);
+		for(int i=0; i<blocks_per_batch; ++i)
+			{
+			std::memcpy(MyStream + 16*i, MyCounter, 16);
+			Add(MyCounter, 1);
+			}
+		for(int i=0; i<blocks_per_batch; ++i)
+			MyCipher.encrypt_block(MyStream + 16*i);
+		MyUsed = static_cast<size_type>(MyPos - MyStart);
+		}
+
+	static void Add(bit8* c, pos_type n)
+		{   // add n to the 128bit big endian counter c
+		for(int i=15; i>=0 && n!=0; --i)
+			{
+			const pos_type sum = c[i] + (n & 0xff);
+			c[i] = static_cast<bit8>(sum & 0xff);
+			n = (n>>8) + (sum>>8);
+			}
+		}
+
+	Cipher MyCipher;
+	bit8 MyIv[16];      // initial counter block
+	bit8 MyCounter[16]; // next counter block to encrypt
+	bit8 MyStream[16*blocks_per_batch]; // keystream starting at MyStart
+	pos_type MyStart;   // keystream position of MyStream[0]
+	pos_type MyPos;     // current keystream position
+	size_type MyUsed;   // consumed bytes of MyStream
+	};
+
+	typedef Aes_ctr<aes256_cipher> aes256_ctr;
+
+};//end: namespace
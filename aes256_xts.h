@@ -0,0 +1,227 @@
+// aes256_xts.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	aes256_xts
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "aes256_cipher.h"
+
+
+namespace crypto{
+
+/*
+TEMPLATE CLASS Aes_xts
+
+XTS mode (IEEE 1619) on top of a block cipher with 128bit blocks.
+every sector is encrypted independently with a tweak derived from its
+sector number. thus a single sector can be rewritten without touching
+the rest of the file (random access at-rest encryption).
+
+-> notice: the sector size has to be at least one block (16 bytes).
+           sizes which are not a multiple of 16 use ciphertext stealing
+-> notice: the data and the tweak key have to be different
+-> usage:   aes256_xts xts;
+			xts.initialize(data_key, tweak_key);
+			filesys::mapped_file f("disk.img", true);
+			xts.encrypt_sectors(f.data(), 4096, 0, f.size()/4096);  // whole file
+			xts.encrypt_sector(f.data()+7*4096, 4096, 7);            // one sector
+*/
+
+	// TEMPLATE CLASS Aes_xts
+template<class Cipher>
+	class Aes_xts
+	{   // XTS-AES sector cipher (blocksize: 128bit; keylen: 2x cipher keylen)
+public:
+	typedef typename Cipher::bit32 bit32;
+	typedef typename Cipher::bit8 bit8;
+	typedef unsigned long long sector_type;
+	typedef std::size_t size_type;
+
+	void initialize(const bit32* data_key, const bit32* tweak_key)
+		{   // initialize both ciphers and create round keys
+		assert(data_key && tweak_key);
+		MyData.initialize(data_key);
+		MyTweak.initialize(tweak_key);
+		}
+
+	void encrypt_sector(bit8* s, size_type size, sector_type sector) const
+		{   // encrypt one sector in place
+		assert(s && size >= 16);
+		bit8 t[16];
+		Make_tweak(t, sector);
+
+		size_type full = size/16;
+		const size_type tail = size%16;
+		if(tail != 0)
+			--full; // the last full block takes part in ciphertext stealing
+
+		for(size_type i=0; i<full; ++i, s+=16)
+			{
+			Encrypt_block(s, t);
+			Next_tweak(t);
+			}
+
+		if(tail != 0)
+			{   // ciphertext stealing
+			Encrypt_block(s, t);
+			Next_tweak(t);
+			bit8* last = s+16;
+			for(size_type i=0; i<tail; ++i)
+				{   // swap the partial block with the head of the last full block
+				bit8 tmp = last[i];
+				last[i] = s[i];
+				s[i] = tmp;
+				}
+			Encrypt_block(s, t);
+			}
+		}
+
+	void decrypt_sector(bit8* s, size_type size, sector_type sector) const
+		{   // decrypt one sector in place
+		assert(s && size >= 16);
+		bit8 t[16];
+		Make_tweak(t, sector);
+
+		size_type full = size/16;
+		const size_type tail = size%16;
+		if(tail != 0)
+			--full; // the last full block takes part in ciphertext stealing
+
+		for(size_type i=0; i<full; ++i, s+=16)
+			{
+			Decrypt_block(s, t);
+			Next_tweak(t);
+			}
+
+		if(tail != 0)
+			{   // ciphertext stealing (tweaks are used in reverse order)
+			bit8 t2[16];
+			std::memcpy(t2, t, 16);
+			Next_tweak(t2);
+			Decrypt_block(s, t2);
+			bit8* last = s+16;
+			for(size_type i=0; i<tail; ++i)
+				{   // swap the partial block with the head of the last full block
+				bit8 tmp = last[i];
+				last[i] = s[i];
+				s[i] = tmp;
+				}
+			Decrypt_block(s, t);
+			}
+		}
+
+	void encrypt_sectors(bit8* s, size_type sector_size, sector_type first_sector,
+		size_type count, unsigned threads = 0) const
+		{   // encrypt count consecutive sectors in place
+		Run(s, sector_size, first_sector, count, threads, &Aes_xts::encrypt_sector);
+		}
+
+	void decrypt_sectors(bit8* s, size_type sector_size, sector_type first_sector,
+		size_type count, unsigned threads = 0) const
+		{   // decrypt count consecutive sectors in place
+		Run(s, sector_size, first_sector, count, threads, &Aes_xts::decrypt_sector);
+		}
+
+private:
+	typedef void (Aes_xts::*sector_fn)(bit8*, size_type, sector_type) const;
+
+	void Run(bit8* s, size_type sector_size, sector_type first_sector,
+		size_type count, unsigned threads, sector_fn fn) const
+		{   // process sectors, split into one contiguous range per thread
+		// a thread is only worth its startup cost for a few hundred KiB of work
+		static const size_type min_bytes_per_thread = 256*1024;
+		if(threads == 0)
+			threads = std::thread::hardware_concurrency();
+		const size_type max_threads = (count*sector_size) / min_bytes_per_thread;
+		if(threads > max_threads)
+			threads = static_cast<unsigned>(max_threads);
+
+		if(threads < 2)
+			{   // not worth spawning threads
+			for(size_type i=0; i<count; ++i)
+				(this->*fn)(s + i*sector_size, sector_size, first_sector + i);
+			return;
+			}
+
+		std::vector<std::thread> workers;
+		workers.reserve(threads-1);
+		const size_type per_thread = count/threads;
+		const size_type remainder = count%threads;
+		size_type first = 0;
+		for(unsigned n=0; n<threads; ++n)
+			{
+			const size_type num = per_thread + (n < remainder ? 1 : 0);
+			auto work = [this, fn, s, sector_size, first, num, first_sector]()
+				{
+				for(size_type i=first; i<first+num; ++i)
+					(this->*fn)(s + i*sector_size, sector_size, first_sector + i);
+				};
+			if(n+1 < threads)
+				workers.push_back(std::thread(work));
+			else
+				work(); // the calling thread takes the last range
+			first += num;
+			}
+		for(auto& w : workers)
+			w.join();
+		}
+
+	void Make_tweak(bit8* t, sector_type sector) const
+		{   // encrypt the sector number (128bit little endian)
+		for(int i=0; i<8; ++i, sector>>=8)
+			t[i] = static_cast<bit8>(sector & 0xff);
+		std::memset(t+8, 0, 8);
+		MyTweak.encrypt_block(t);
+		}
+
+	static void Next_tweak(bit8* t)
+		{   // multiply the tweak by x in GF(2^128)
+		bit8 carry = 0;
+		for(int i=0; i<16; ++i)
+			{
+			const bit8 next = t[i]>>7;
+			t[i] = static_cast<bit8>((t[i]<<1) | carry);
+			carry = next;
+			}
+		if(carry)
+			t[0] ^= 0x87;
+		}
+
+	void Encrypt_block(bit8* b, const bit8* t) const
+		{   // xor-encrypt-xor
+		for(int i=0; i<16; ++i)
+			b[i] ^= t[i];
+		MyData.encrypt_block(b);
+		for(int i=0; i<16; ++i)
+			b[i] ^= t[i];
+		}
+
+	void Decrypt_block(bit8* b, const bit8* t) const
+		{   // xor-decrypt-xor
+		for(int i=0; i<16; ++i)
+			b[i] ^= t[i];
+		MyData.decrypt_block(b);
+		for(int i=0; i<16; ++i)
+			b[i] ^= t[i];
+		}
+
+	Cipher MyData;  // encrypts the data blocks
+	Cipher MyTweak; // encrypts the sector numbers
+	};
+
+	typedef Aes_xts<aes256_cipher> aes256_xts;
+
+};//end: namespace
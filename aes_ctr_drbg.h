@@ -0,0 +1,255 @@
+// aes_ctr_drbg.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	aes256_ctr_drbg
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <thread>
+#include "aes256_cipher.h"
+
+
+namespace crypto{
+
+/*
+TEMPLATE CLASS Ctr_drbg
+
+deterministic random bit generator CTR_DRBG (NIST SP 800-90A) without
+derivation function. the output is the keystream of the block cipher in
+counter mode. after every request the key and the counter are replaced
+(backtracking resistance).
+
+the class is a UniformRandomBitGenerator (<random>): operator() returns
+64bit numbers from an internal buffer, which is refilled with one large
+generate request. generate() writes bulk output directly.
+
+-> notice: an instance is not thread safe. this_thread() returns an
+           instance per thread, which needs no locking at all
+-> notice: the default constructor seeds from std::random_device
+-> usage:   auto& rng = aes256_ctr_drbg::this_thread();
+			std::shuffle(v.begin(), v.end(), rng);
+			std::uniform_int_distribution<int> d(1, 6);
+			int dice = d(rng);
+			rng.generate(buffer, size);  // bulk
+*/
+
+	// TEMPLATE CLASS Ctr_drbg
+template<class Cipher>
+	class Ctr_drbg
+	{   // CTR_DRBG (blocksize: 128bit; keylen: cipher keylen)
+public:
+	typedef typename Cipher::bit8 bit8;
+	typedef unsigned long long result_type;
+	typedef std::size_t size_type;
+
+	enum {
+		key_bytes = Cipher::key_bytes,          // keylen
+		seed_bytes = Cipher::key_bytes + 16,    // seedlen = keylen + outlen
+		max_request = 1<<16,                    // max bytes per generate request (2^19 bits)
+		buffer_bytes = 4096                     // buffer of operator ()
+		};
+
+	static const unsigned long long reseed_interval = 1ULL<<48; // max requests between reseeds
+
+	Ctr_drbg()
+		{   // construct seeded from std::random_device
+		bit8 entropy[seed_bytes];
+		Entropy(entropy);
+		instantiate(entropy);
+		secure_wipe(entropy, sizeof(entropy));
+		}
+
+	Ctr_drbg(const bit8* entropy, const bit8* personalization = nullptr, size_type n = 0)
+		{   // construct from seed_bytes of entropy (and optional personalization string)
+		instantiate(entropy, personalization, n);
+		}
+
+	Ctr_drbg(const Ctr_drbg&) = delete;
+	Ctr_drbg& operator = (const Ctr_drbg&) = delete;
+
+	~Ctr_drbg()
+		{   // destruct (wipe state)
+		secure_wipe(MyV, sizeof(MyV));
+		secure_wipe(MyBuffer, sizeof(MyBuffer));
+		secure_wipe(&MyCipher, sizeof(MyCipher));
+		}
+
+	void instantiate(const bit8* entropy, const bit8* personalization = nullptr, size_type n = 0)
+		{   // instantiate: key = 0, v = 0, update(entropy ^ personalization)
+		assert(entropy);
+		assert(n <= seed_bytes && (n == 0 || personalization));
+		bit8 key[key_bytes] = {};
+		MyCipher.initialize(key);
+		std::memset(MyV, 0, sizeof(MyV));
+		reseed(entropy, personalization, n);
+		}
+
+	void reseed(const bit8* entropy, const bit8* additional = nullptr, size_type n = 0)
+		{   // reseed: update(entropy ^ additional input)
+		assert(entropy);
+		assert(n <= seed_bytes && (n == 0 || additional));
+		bit8 seed[seed_bytes];
+		std::memcpy(seed, entropy, seed_bytes);
+		for(size_type i=0; i<n; ++i)
+			seed[i] ^= additional[i];
+		Update(seed);
+		secure_wipe(seed, sizeof(seed));
+		MyRequests = 1;
+		MyUsed = buffer_bytes; // drop buffered output of the old state
+		}
+
+	void generate(void* out, size_type n, const bit8* additional = nullptr, size_type m = 0)
+		{   // write n random bytes to out
+		assert(n == 0 || out);
+		bit8* p = static_cast<bit8*>(out);
+		while(n > 0)
+			{
+			const size_type num = n < max_request ? n : size_type(max_request);
+			Generate(p, num, additional, m);
+			p += num;
+			n -= num;
+			}
+		}
+
+	result_type operator () ()
+		{   // next 64bit random number
+		if(MyUsed + sizeof(result_type) > buffer_bytes)
+			{
+			Generate(MyBuffer, buffer_bytes, nullptr, 0);
+			MyUsed = 0;
+			}
+		result_type r;
+		std::memcpy(&r, MyBuffer + MyUsed, sizeof(r));
+		MyUsed += sizeof(r);
+		return r;
+		}
+
+	static constexpr result_type (min)()
+		{   // smallest possible result
+		return 0;
+		}
+
+	static constexpr result_type (max)()
+		{   // largest possible result
+		return (std::numeric_limits<result_type>::max)();
+		}
+
+	static Ctr_drbg& this_thread()
+		{   // instance of the calling thread (seeded on first use)
+		static thread_local Ctr_drbg instance((Per_thread_tag()));
+		return instance;
+		}
+
+private:
+	struct Per_thread_tag {};
+
+	explicit Ctr_drbg(Per_thread_tag)
+		{   // construct seeded from std::random_device, personalized with the thread id
+		bit8 entropy[seed_bytes];
+		Entropy(entropy);
+		bit8 personalization[sizeof(std::size_t)];
+		const std::size_t id = std::hash<std::thread::id>()(std::this_thread::get_id());
+		std::memcpy(personalization, &id, sizeof(id));
+		instantiate(entropy, personalization, sizeof(personalization));
+		secure_wipe(entropy, sizeof(entropy));
+		}
+
+	static void Entropy(bit8* p)
+		{   // seed_bytes from the system entropy source
+		std::random_device rd;
+		for(size_type i=0; i<seed_bytes; i+=4)
+			{
+			const unsigned int r = rd();
+			for(size_type j=0; j<4 && i+j<seed_bytes; ++j)
+				p[i+j] = bit8(r >> (8*j));
+			}
+		}
+
+	void Generate(bit8* out, size_type n, const bit8* additional, size_type m)
+		{   // generate request (n <= max_request)
+		assert(m <= seed_bytes && (m == 0 || additional));
+		bit8 add[seed_bytes] = {};
+		if(MyRequests > reseed_interval)
+			{   // reseed required: it consumes the additional input (SP 800-90A 10.2.1.5.1)
+			bit8 entropy[seed_bytes];
+			Entropy(entropy);
+			reseed(entropy, additional, m);
+			secure_wipe(entropy, sizeof(entropy));
+			}
+		else if(m > 0)
+			{
+			std::memcpy(add, additional, m);
+			Update(add);
+			}
+
+		// output: encrypt v+1, v+2, ... (several blocks at a time)
+		bit8 blocks[16*blocks_per_batch];
+		while(n > 0)
+			{
+			const size_type num_blocks = (n+15)/16 < blocks_per_batch ? (n+15)/16 : size_type(blocks_per_batch);
+			for(size_type i=0; i<num_blocks; ++i)
+				{
+				Increment(MyV);
+				std::memcpy(blocks + 16*i, MyV, 16);
+				}
+			for(size_type i=0; i<num_blocks; ++i)
+				MyCipher.encrypt_block(blocks + 16*i);
+			const size_type num = n < 16*num_blocks ? n : 16*num_blocks;
+			std::memcpy(out, blocks, num);
+			out += num;
+			n -= num;
+			}
+		secure_wipe(blocks, sizeof(blocks));
+
+		Update(add);
+		++MyRequests;
+		}
+
+	void Update(const bit8* provided)
+		{   // derive a new key and v from the current state and seed_bytes of input
+		bit8 temp[(seed_bytes+15)/16*16];
+		for(size_type i=0; i<seed_bytes; i+=16)
+			{
+			Increment(MyV);
+			std::memcpy(temp + i, MyV, 16);
+			MyCipher.encrypt_block(temp + i);
+			}
+		for(size_type i=0; i<seed_bytes; ++i)
+			temp[i] ^= provided[i];
+		MyCipher.initialize(temp);
+		std::memcpy(MyV, temp + key_bytes, 16);
+		secure_wipe(temp, sizeof(temp));
+		}
+
+	static void Increment(bit8* v)
+		{   // v = (v+1) mod 2^128 (big endian)
+		for(int i=15; i>=0; --i)
+			if(++v[i] != 0)
+				break;
+		}
+
+	enum { blocks_per_batch = 8 }; // blocks encrypted per loop iteration
+
+	Cipher MyCipher;                // key
+	bit8 MyV[16];                   // counter
+	unsigned long long MyRequests;  // reseed counter
+	bit8 MyBuffer[buffer_bytes];    // output of operator ()
+	size_type MyUsed;               // consumed bytes of MyBuffer
+	};
+
+	typedef Ctr_drbg<aes256_cipher> aes256_ctr_drbg;
+
+};//end: namespace
@@ -0,0 +1,328 @@
+// aes_key_engine.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	aes256_key_engine
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include "aes256_cipher.h"
+
+
+namespace crypto{
+
+/*
+TEMPLATE CLASS Aes_key_engine
+
+key agile encryption: many blocks, each under its own key.
+expanded key schedules are kept in a bounded table with least recently
+used replacement. keys are identified by a number. the raw key of a
+missing number is requested from the key provider.
+
+every schedule occupies its own cache lines. encrypt_many groups the
+blocks by key, thus each schedule is expanded (or looked up) once per
+call and stays in the L1 cache while its blocks are processed. the
+missing keys of a call are fetched and expanded together before any
+block is processed (in windows of at most capacity distinct keys).
+evicted schedules are wiped, so is the table on destruction.
+
+-> notice: the engine is not thread safe (use one engine per thread)
+-> notice: a schedule is used for encryption and decryption
+-> usage:   aes256_key_engine e(10000, [](key_id id, bit8* key){ load_key(id, key); });
+			e.encrypt_many(ids, blocks, n);   // block i (16 bytes) under key ids[i]
+*/
+
+	// TEMPLATE CLASS Aes_key_engine
+template<class Cipher>
+	class Aes_key_engine
+	{   // LRU cache of key schedules
+public:
+	typedef typename Cipher::bit8 bit8;
+	typedef unsigned long long key_id;
+	typedef std::size_t size_type;
+	typedef std::function<void(key_id, bit8*)> key_provider; // write Cipher::key_bytes bytes
+
+	Aes_key_engine(size_type capacity, key_provider provider)
+		: MyProvider(provider)
+		, MyCapacity(capacity)
+		, MySize(0)
+		, MyHead(npos)
+		, MyTail(npos)
+		, MyHits(0)
+		, MyMisses(0)
+		, MyStorage(new unsigned char[capacity*sizeof(Slot) + alignof(Slot)])
+		, MyIds(capacity)
+		, MyPrev(capacity)
+		, MyNext(capacity)
+		{   // construct empty table
+		assert(capacity > 0 && provider);
+		void* p = MyStorage.get();
+		std::size_t space = capacity*sizeof(Slot) + alignof(Slot);
+		MySlots = static_cast<Slot*>(std::align(alignof(Slot), capacity*sizeof(Slot), p, space));
+		MyIndex.reserve(capacity);
+		}
+
+	Aes_key_engine(const Aes_key_engine&) = delete;
+	Aes_key_engine& operator = (const Aes_key_engine&) = delete;
+
+	~Aes_key_engine()
+		{   // destruct (wipe round keys)
+		for(size_type s=0; s<MySize; ++s)
+			{
+			secure_wipe(&MySlots[s].cipher, sizeof(Cipher));
+			MySlots[s].~Slot();
+			}
+		}
+
+	const Cipher& schedule(key_id id)
+		{   // schedule of key id (expand if missing)
+		return MySlots[Lookup(id)].cipher;
+		}
+
+	void prefetch(const key_id* ids, size_type n)
+		{   // expand all missing keys of ids[0..n) at once
+		std::vector<key_id> missing;
+		for(size_type i=0; i<n; ++i)
+			if(MyIndex.find(ids[i]) == MyIndex.end())
+				missing.push_back(ids[i]);
+		std::sort(missing.begin(), missing.end());
+		missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+		if(missing.size() > MyCapacity)
+			missing.resize(MyCapacity); // the rest would evict the first ones again
+		Expand(missing.data(), missing.size());
+		}
+
+	void encrypt_many(const key_id* ids, bit8* blocks, size_type n)
+		{   // encrypt block i (blocks + 16*i) under key ids[i]
+		Run(ids, blocks, n, true);
+		}
+
+	void decrypt_many(const key_id* ids, bit8* blocks, size_type n)
+		{   // decrypt block i (blocks + 16*i) under key ids[i]
+		Run(ids, blocks, n, false);
+		}
+
+	void erase(key_id id)
+		{   // drop the schedule of key id (e.g. after key rotation)
+		auto it = MyIndex.find(id);
+		if(it == MyIndex.end())
+			return;
+		const size_type s = it->second;
+		MyIndex.erase(it);
+		Unlink(s);
+		// move the last slot into the hole to keep slots [0, MySize) in use
+		const size_type last = --MySize;
+		if(s != last)
+			{   // slot s takes over the place of slot last in the usage list
+			MySlots[s].cipher = MySlots[last].cipher;
+			MyIds[s] = MyIds[last];
+			MyIndex[MyIds[s]] = s;
+			MyPrev[s] = MyPrev[last];
+			MyNext[s] = MyNext[last];
+			if(MyPrev[s] != npos) MyNext[MyPrev[s]] = s;
+			else MyHead = s;
+			if(MyNext[s] != npos) MyPrev[MyNext[s]] = s;
+			else MyTail = s;
+			}
+		secure_wipe(&MySlots[last].cipher, sizeof(Cipher)); // wipe round keys
+		}
+
+	size_type size() const
+		{   // number of cached schedules
+		return MySize;
+		}
+
+	size_type capacity() const
+		{   // maximum number of cached schedules
+		return MyCapacity;
+		}
+
+	unsigned long long hits() const
+		{   // number of lookups served from the table
+		return MyHits;
+		}
+
+	unsigned long long misses() const
+		{   // number of key expansions
+		return MyMisses;
+		}
+
+private:
+	struct alignas(64) Slot
+		{   // one schedule per cache line group
+		Cipher cipher;
+		};
+
+	static const size_type npos = static_cast<size_type>(-1);
+
+	void Run(const key_id* ids, bit8* blocks, size_type n, bool encrypt)
+		{   // process blocks grouped by key, expanding the missing keys batchwise
+		assert(n == 0 || (ids && blocks));
+		MyOrder.resize(n);
+		for(size_type i=0; i<n; ++i)
+			MyOrder[i] = i;
+		std::sort(MyOrder.begin(), MyOrder.end(),
+			[ids](size_type a, size_type b){ return ids[a] < ids[b] || (ids[a] == ids[b] && a < b); });
+
+		for(size_type i=0; i<n; )
+			{   // window of at most MyCapacity distinct keys: they fit the table together
+			size_type end = i;
+			MyMissing.clear();
+			for(size_type keys=0; end<n && keys<MyCapacity; ++keys)
+				{
+				const key_id id = ids[MyOrder[end]];
+				auto it = MyIndex.find(id);
+				if(it == MyIndex.end())
+					MyMissing.push_back(id);
+				else
+					{   // hit: most recently used, thus not evicted by the expansion below
+					++MyHits;
+					Unlink(it->second);
+					Push_front(it->second);
+					}
+				while(end < n && ids[MyOrder[end]] == id)
+					++end;
+				}
+			Expand(MyMissing.data(), MyMissing.size());
+
+			while(i < end)
+				{
+				const key_id id = ids[MyOrder[i]];
+				const Cipher& c = MySlots[MyIndex.find(id)->second].cipher;
+				for(; i<end && ids[MyOrder[i]] == id; ++i)
+					{
+					if(encrypt)
+						c.encrypt_block(blocks + 16*MyOrder[i]);
+					else
+						c.decrypt_block(blocks + 16*MyOrder[i]);
+					}
+				}
+			}
+		}
+
+	void Expand(const key_id* missing, size_type n)
+		{   // fetch the raw keys of missing[0..n) (distinct, not cached), then expand them in one go
+		assert(n <= MyCapacity);
+		MyKeys.resize(n*Cipher::key_bytes);
+		try
+			{
+			for(size_type i=0; i<n; ++i)
+				MyProvider(missing[i], &MyKeys[i*Cipher::key_bytes]);
+			}
+		catch(...)
+			{   // don't leave the keys fetched so far behind
+			secure_wipe(MyKeys.data(), MyKeys.size());
+			throw;
+			}
+		for(size_type i=0; i<n; ++i)
+			{
+			const size_type s = Insert(missing[i]);
+			MySlots[s].cipher.initialize(&MyKeys[i*Cipher::key_bytes]);
+			++MyMisses;
+			}
+		secure_wipe(MyKeys.data(), MyKeys.size()); // don't leave raw keys behind
+		}
+
+	size_type Lookup(key_id id)
+		{   // slot of key id (expand if missing)
+		auto it = MyIndex.find(id);
+		if(it != MyIndex.end())
+			{   // hit: mark as most recently used
+			++MyHits;
+			Unlink(it->second);
+			Push_front(it->second);
+			return it->second;
+			}
+
+		++MyMisses;
+		bit8 key[Cipher::key_bytes];
+		try
+			{
+			MyProvider(id, key);
+			}
+		catch(...)
+			{   // the provider may have written a part of the key
+			secure_wipe(key, sizeof(key));
+			throw;
+			}
+		const size_type s = Insert(id);
+		MySlots[s].cipher.initialize(key);
+		secure_wipe(key, sizeof(key)); // don't leave the raw key behind
+		return s;
+		}
+
+	size_type Insert(key_id id)
+		{   // take a free or the least recently used slot for key id
+		size_type s;
+		if(MySize < MyCapacity)
+			{
+			s = MySize++;
+			new (&MySlots[s]) Slot();
+			}
+		else
+			{   // evict
+			s = MyTail;
+			Unlink(s);
+			MyIndex.erase(MyIds[s]);
+			secure_wipe(&MySlots[s].cipher, sizeof(Cipher)); // wipe round keys
+			}
+		MyIds[s] = id;
+		MyIndex[id] = s;
+		Push_front(s);
+		return s;
+		}
+
+	void Unlink(size_type s)
+		{   // remove slot s from the usage list
+		if(MyPrev[s] != npos) MyNext[MyPrev[s]] = MyNext[s];
+		else MyHead = MyNext[s];
+		if(MyNext[s] != npos) MyPrev[MyNext[s]] = MyPrev[s];
+		else MyTail = MyPrev[s];
+		}
+
+	void Push_front(size_type s)
+		{   // make slot s the most recently used one
+		MyPrev[s] = npos;
+		MyNext[s] = MyHead;
+		if(MyHead != npos) MyPrev[MyHead] = s;
+		MyHead = s;
+		if(MyTail == npos) MyTail = s;
+		}
+
+	key_provider MyProvider;
+	size_type MyCapacity;
+	size_type MySize;   // slots [0, MySize) are in use
+	size_type MyHead;   // most recently used slot
+	size_type MyTail;   // least recently used slot
+	unsigned long long MyHits;
+	unsigned long long MyMisses;
+
+	std::unique_ptr<unsigned char[]> MyStorage; // memory of the slots
+	Slot* MySlots;                      // schedules (cache line aligned)
+	std::vector<key_id> MyIds;          // key of each slot
+	std::vector<size_type> MyPrev;      // usage list (separate from the
+	std::vector<size_type> MyNext;      // schedules to keep them dense)
+	std::unordered_map<key_id, size_type> MyIndex; // key -> slot
+	std::vector<size_type> MyOrder;     // scratch: block order of encrypt_many
+	std::vector<key_id> MyMissing;      // scratch: keys to expand in a window of encrypt_many
+	std::vector<bit8> MyKeys;           // scratch: raw keys (zero between calls)
+	};
+
+	typedef Aes_key_engine<aes256_cipher> aes256_key_engine;
+
+};//end: namespace
@@ -0,0 +1,259 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     std::filebuf file;
+ *     file.open("secret.bin", std::ios::out | std::ios::binary);
+ *     crypto::cipher_streambuf buf(&file, key, iv);  // encrypt everything passed to file (read back the same way)
+ *     crypto::cipher_streambuf link(&port, key, tx_iv, rx_iv);  // duplex: one iv per direction
+ *     std::ostream s(&buf);  // pass buffer to an io-stream
+ *     s << "hello world" << std::flush;  // written to the file encrypted
+ *
+ * Description:
+ *     this file contains a streambuffer, which transparently encrypts all output and decrypts
+ *     all input of another (downstream) streambuffer: a file, a serial port, a memory buffer, ...
+ *     the streambuffers are designed to be fully compatible with the standart template library (STL)
+ */
+
+#pragma once
+
+#include <streambuf>
+#include <memory>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <assert.h>
+#include "aes256_ctr.h"
+
+#define CIPHER_STREAMBUF_DEFAULT_BUFSIZE (64*1024) // default size of both internal buffers
+
+namespace crypto{
+
+enum class cipher_side
+	{ // which half of a duplex link a streambuffer is (chooses the keystream of each direction)
+	initiator,  // sends with iv, receives with the derived iv
+	responder   // sends with the derived iv, receives with iv
+	};
+
+/**
+ * THE INTERESTING STUFF
+ *
+ * this section includes the generic streambuffer class
+ */
+
+template<typename T, typename Traits, // character type and character traits (sizeof(T) == 1)
+			typename Mode>             // stream cipher (e.g. Aes_ctr)
+	class basic_cipher_streambuf
+	: public std::basic_streambuf<T, Traits>
+	{
+public:
+	// notice: output and input use separate keystreams, both start at position 0.
+	//         the mode must be a stream cipher (encryption == decryption), e.g. counter mode
+	// notice: both directions must never use the same key and iv: on a duplex downstream
+	//         (e.g. a serial port) xor of both ciphertexts would reveal xor of both plaintexts.
+	//         the peer uses the mirrored pair: its receive iv is our send iv and vice versa.
+	//         with a single iv and a side the receive iv is derived (top bit of the counter
+	//         flipped); one side is the initiator, the other the responder
+	// notice: with a single iv and no side both directions use the same keystream. this is
+	//         meant for one-way downstreams (a file is written, then read back with the same
+	//         key and iv). never use it for a duplex link
+
+	typedef T char_type;
+	typedef Traits traits_type;
+	typedef typename Traits::int_type int_type;
+	typedef std::streampos pos_type;
+	typedef std::streamoff off_type;
+	typedef std::basic_streambuf<T, Traits> streambuf_type;
+	typedef typename Mode::bit32 bit32;
+	typedef typename Mode::bit8 bit8;
+
+	static_assert(sizeof(T) == sizeof(bit8), "character type has to be byte sized");
+
+	// disable copy construction and copy assignment
+	basic_cipher_streambuf(const basic_cipher_streambuf&) = delete;
+	basic_cipher_streambuf& operator = (const basic_cipher_streambuf&) = delete;
+
+	basic_cipher_streambuf(streambuf_type* dest, const bit32* key, const bit8* send_iv,
+			const bit8* receive_iv, std::size_t buf_size = CIPHER_STREAMBUF_DEFAULT_BUFSIZE)
+		: basic_cipher_streambuf(dest, key, send_iv, receive_iv, buf_size, any_ivs_tag())
+		{ // construct from parameters (dest is not owned, the ivs have to differ)
+		assert(std::memcmp(send_iv, receive_iv, 16) != 0);
+		}
+
+	basic_cipher_streambuf(streambuf_type* dest, const bit32* key, const bit8* iv,
+			cipher_side side, std::size_t buf_size = CIPHER_STREAMBUF_DEFAULT_BUFSIZE)
+		: basic_cipher_streambuf(dest, key,
+			side == cipher_side::initiator ? iv : Derived_iv(iv).data(),
+			side == cipher_side::initiator ? Derived_iv(iv).data() : iv, buf_size)
+		{ // construct one side of a duplex link from a single iv
+		}
+
+	basic_cipher_streambuf(streambuf_type* dest, const bit32* key, const bit8* iv,
+			std::size_t buf_size = CIPHER_STREAMBUF_DEFAULT_BUFSIZE)
+		: basic_cipher_streambuf(dest, key, iv, iv, buf_size, any_ivs_tag())
+		{ // construct for a one-way downstream (one keystream for both directions)
+		}
+
+	~basic_cipher_streambuf()
+		{ // destruct (send remaining output)
+		flush_buffer();
+		}
+
+private:
+	struct any_ivs_tag {};
+
+	basic_cipher_streambuf(streambuf_type* dest, const bit32* key, const bit8* send_iv,
+			const bit8* receive_iv, std::size_t buf_size, any_ivs_tag)
+		: dest_(dest)
+		, size_(buf_size)
+		, storage_(new char_type[2*buf_size + alignment])
+		{ // construct from parameters (the ivs may be equal)
+		assert(dest_ != nullptr && size_ > 0);
+		assert(send_iv != nullptr && receive_iv != nullptr);
+		encrypt_.initialize(key, send_iv);
+		decrypt_.initialize(key, receive_iv);
+
+		// align both buffers to a cache line
+		auto p = reinterpret_cast<std::uintptr_t>(storage_.get());
+		outbuf_ = storage_.get() + (alignment - p%alignment)%alignment;
+		inbuf_ = outbuf_ + size_;
+
+		this->setp(outbuf_, outbuf_ + size_);
+		this->setg(inbuf_, inbuf_ + size_, inbuf_ + size_); // input buffer is empty
+		}
+
+protected:
+	int_type overflow(int_type ch) override
+		{ // called if there are no empty slots in the buffer
+		if(!flush_buffer())
+			return traits_type::eof(); // error
+		if(ch != traits_type::eof())
+			{ // store ch in the (now empty) buffer
+			*(this->pptr()) = traits_type::to_char_type(ch);
+			this->pbump(1);
+			}
+		return traits_type::not_eof(ch); // success
+		}
+
+	int sync() override
+		{ // flush buffer and downstream buffer
+		// -1 indicates error
+		return (flush_buffer() && dest_->pubsync() != -1) ? 0/*success*/ : -1/*error*/;
+		}
+
+	std::streamsize xsputn(const char_type* s, std::streamsize n) override
+		{ // write n characters
+		if(n < static_cast<std::streamsize>(size_))
+			return streambuf_type::xsputn(s, n); // small write: use the buffer
+
+		// large write: encrypt straight from the caller's memory
+		if(!flush_buffer())
+			return 0;
+		std::streamsize num_send = 0;
+		while(num_send < n)
+			{
+			std::streamsize num = n - num_send;
+			if(num > static_cast<std::streamsize>(size_))
+				num = static_cast<std::streamsize>(size_);
+			encrypt_.process(reinterpret_cast<const bit8*>(s + num_send),
+				reinterpret_cast<bit8*>(outbuf_), static_cast<std::size_t>(num));
+			if(dest_->sputn(outbuf_, num) != num)
+				return num_send; // downstream failed. keystream is out of sync
+			num_send += num;
+			}
+		return num_send;
+		}
+
+	int_type underflow() override
+		{ // called if the input buffer is empty
+		if(this->gptr() < this->egptr())
+			return traits_type::to_int_type(*(this->gptr()));
+
+		// read what the downstream buffer can deliver without blocking for more
+		std::streamsize avail = dest_->in_avail();
+		if(avail < 0)
+			return traits_type::eof(); // end of sequence
+		std::streamsize num = 0;
+		if(avail == 0)
+			{ // unknown: block for one character, then take the rest
+			num = dest_->sgetn(inbuf_, 1);
+			if(num <= 0)
+				return traits_type::eof();
+			avail = dest_->in_avail();
+			}
+		if(avail > static_cast<std::streamsize>(size_) - num)
+			avail = static_cast<std::streamsize>(size_) - num;
+		if(avail > 0)
+			num += dest_->sgetn(inbuf_ + num, avail);
+		if(num <= 0)
+			return traits_type::eof();
+
+		decrypt_.process(reinterpret_cast<bit8*>(inbuf_), static_cast<std::size_t>(num));
+		this->setg(inbuf_, inbuf_, inbuf_ + num);
+		return traits_type::to_int_type(*(this->gptr()));
+		}
+
+	std::streamsize xsgetn(char_type* s, std::streamsize n) override
+		{ // read n characters
+		// drain the input buffer first
+		std::streamsize num_read = this->egptr() - this->gptr();
+		if(num_read > n)
+			num_read = n;
+		traits_type::copy(s, this->gptr(), static_cast<std::size_t>(num_read));
+		this->gbump(static_cast<int>(num_read));
+
+		if(n - num_read < static_cast<std::streamsize>(size_))
+			return num_read + streambuf_type::xsgetn(s + num_read, n - num_read);
+
+		// large read: read straight into the caller's memory and decrypt in place
+		std::streamsize num = dest_->sgetn(s + num_read, n - num_read);
+		if(num > 0)
+			{
+			decrypt_.process(reinterpret_cast<bit8*>(s + num_read), static_cast<std::size_t>(num));
+			num_read += num;
+			}
+		return num_read;
+		}
+
+	std::streamsize showmanyc() override
+		{ // characters available without blocking
+		return dest_->in_avail();
+		}
+
+private:
+	static std::array<bit8, 16> Derived_iv(const bit8* iv)
+		{ // iv with the top bit flipped: the big endian counters of both directions never meet
+		assert(iv != nullptr);
+		std::array<bit8, 16> d;
+		std::memcpy(d.data(), iv, 16);
+		d[0] ^= 0x80;
+		return d;
+		}
+
+	bool flush_buffer()
+		{ // encrypt the buffered data and pass it to the downstream buffer
+		std::streamsize num = this->pptr() - this->pbase(); // number of elements in the buffer
+		if(num == 0)
+			return true;
+		encrypt_.process(reinterpret_cast<bit8*>(this->pbase()), static_cast<std::size_t>(num));
+		std::streamsize num_send = dest_->sputn(this->pbase(), num);
+		this->setp(outbuf_, outbuf_ + size_); // the buffer is now empty again
+		return (num_send == num); // on failure the data is lost (it is already encrypted)
+		}
+
+	enum { alignment = 64 }; // cache line
+
+	streambuf_type* dest_;   // downstream buffer (receives ciphertext)
+	std::size_t size_;       // size of each buffer
+	std::unique_ptr<char_type[]> storage_; // memory of both buffers
+	char_type* outbuf_;      // output buffer (plaintext until flushed)
+	char_type* inbuf_;       // input buffer (decrypted)
+	Mode encrypt_;           // keystream for the output
+	Mode decrypt_;           // keystream for the input
+	};
+
+
+// default cipher stream-buffer: aes-256 in counter mode
+typedef basic_cipher_streambuf<char, std::char_traits<char>, aes256_ctr>
+	cipher_streambuf;
+
+};//end: namespace
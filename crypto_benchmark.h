@@ -0,0 +1,943 @@
+// crypto_benchmark.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+functions:
+	bool run_known_answer_tests(std::ostream& json)
+	void run_benchmarks(std::ostream& json, const benchmark_options& o = benchmark_options())
+	bool run_crypto_suite(std::ostream& json, const benchmark_options& o = benchmark_options())
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "aes256_cipher.h"
+#include "aes256_ctr.h"
+#include "aes256_xts.h"
+#include "aes_ctr_drbg.h"
+#include "aes_key_engine.h"
+#include "cipher_streambuf.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #include <intrin.h>
+  #define CRYPTO_BENCHMARK_RDTSC() __rdtsc()
+#elif defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define CRYPTO_BENCHMARK_RDTSC() __rdtsc()
+#endif
+
+namespace crypto{
+
+/*
+FUNCTION run_crypto_suite
+
+known answer tests and throughput benchmarks for every cipher backend and
+the modes built on top of them. the results are written as one json object:
+
+{ "known_answer_tests": [ {"backend": ..., "test": ..., "passed": true}, ... ],
+  "benchmarks": [ {"backend": ..., "operation": ..., "bytes": ..., "threads": ...,
+                   "cycles_per_byte": ..., "gb_per_s": ...}, ... ] }
+
+backends: aes128_cipher, aes192_cipher, aes256_cipher and aes256_key_engine
+(known answer tests also: aes128_xts, aes256_xts, aes256_ctr_drbg and cipher_streambuf)
+
+known answer tests (per key length):
+	FIPS-197 appendix C
+	NIST CAVP: GFSbox, KeySbox,
+	           VarTxt, VarKey (1 leading one bit and every whole byte of ones),
+	           ECB Monte-Carlo (AES-256 only, encrypt and decrypt, 100x1000 iterations)
+	NIST SP 800-38A F.1 (ECB) and F.5 (CTR)
+	key engine: the AES-256 ECB vectors interleaved under their keys (2 cached schedules)
+	XTS (IEEE 1619): vector 10 (AES-256, 512 byte sector, also as 1 of 1024 sectors
+	           on 2 threads), vector 15 (AES-128, 17 bytes, ciphertext stealing)
+	CTR_DRBG (AES-256, no df): CAVP instantiate + generate twice, CAVP reseed,
+	           reseed with personalization and additional input (512 bit output)
+	cipher streambuffer: SP 800-38A F.5.5 through small and large writes (16 byte buffers),
+	           read back with the same iv, both directions of a duplex pair
+
+benchmarks (message sizes 16 B, 256 B, ... and max_bytes, default 1 GB):
+	block_encrypt/block_decrypt: one encrypt_block/decrypt_block call per block
+	ctr: counter mode, one thread and all threads
+	xts: 4 KiB sectors (smaller messages: one sector), one thread and all threads
+	key_agile_cached/key_agile_expand: key engine, each block under one of 1024 keys,
+	                                   all cached or expanded per call (up to 16 MB)
+
+-> notice: cycles are counted with the time stamp counter (x86 only, null otherwise).
+           it runs at a constant rate, which may differ from the actual core clock
+-> notice: returns false if any known answer test failed
+-> usage:   int main() { return crypto::run_crypto_suite(std::cout) ? 0 : 1; }
+*/
+
+	// STRUCT benchmark_options
+struct benchmark_options
+	{   // parameters of the throughput benchmark
+	benchmark_options()
+		: min_bytes(16)
+		, max_bytes(std::size_t(1)<<30)
+		, min_seconds(0.25)
+		, threads(0)
+		{   // construct with default values
+		}
+
+	std::size_t min_bytes;  // smallest message size
+	std::size_t max_bytes;  // largest message size (sizes grow by factor 16, the last is max_bytes)
+	double min_seconds;     // minimum measuring time per result
+	unsigned threads;       // threads of the multithreaded runs (0: all cores)
+	};
+
+	// FUNCTION Hex
+inline void Hex(const char* s, Aes_types::bit8* out, std::size_t n)
+	{   // convert hex string to bytes
+	for(std::size_t i=0; i<n; ++i)
+		{
+		Aes_types::bit8 b = 0;
+		for(int j=0; j<2; ++j)
+			{
+			const char c = s[2*i+j];
+			b = Aes_types::bit8(b<<4 | (c <= '9' ? c-'0' : (c|0x20)-'a'+10));
+			}
+		out[i] = b;
+		}
+	}
+
+	// TEMPLATE FUNCTION Ecb_block
+template<class Cipher>
+	bool Ecb_block(const Aes_types::bit8* k, const Aes_types::bit8* p, const Aes_types::bit8* c)
+	{   // encrypt and decrypt one block
+	Aes_types::bit8 b[16];
+	Cipher e;
+	e.initialize(k);
+	std::memcpy(b, p, 16);
+	e.encrypt_block(b);
+	if(std::memcmp(b, c, 16) != 0)
+		return false;
+	e.decrypt_block(b);
+	return (std::memcmp(b, p, 16) == 0);
+	}
+
+	// TEMPLATE FUNCTION Ecb_vector
+template<class Cipher>
+	bool Ecb_vector(const char* key, const char* plain, const char* cipher)
+	{   // encrypt and decrypt one block (hex strings)
+	typedef Aes_types::bit8 B;
+	B k[32], p[16], c[16];
+	Hex(key, k, Cipher::key_bytes);
+	Hex(plain, p, 16);
+	Hex(cipher, c, 16);
+	return Ecb_block<Cipher>(k, p, c);
+	}
+
+	// TEMPLATE FUNCTION Ecb_table
+template<class Cipher>
+	bool Ecb_table(const char* const* table, bool vary_key)
+	{   // GFSbox (plaintext, ciphertext; key 0) or KeySbox (key, ciphertext; plaintext 0)
+	const char* zero = "0000000000000000000000000000000000000000000000000000000000000000";
+	for(; *table; table+=2)
+		if(!(vary_key ? Ecb_vector<Cipher>(table[0], zero, table[1])
+				: Ecb_vector<Cipher>(zero, table[0], table[1])))
+			return false;
+	return true;
+	}
+
+	// TEMPLATE FUNCTION Ecb_bits
+template<class Cipher>
+	bool Ecb_bits(const char* const* table, bool vary_key)
+	{   // VarTxt or VarKey: entry i has 1 (i == 0) or 8*i leading one bits
+	typedef Aes_types::bit8 B;
+	for(std::size_t i=0; table[i]; ++i)
+		{
+		B k[32] = {}, p[16] = {}, c[16];
+		B* ones = vary_key ? k : p;
+		const std::size_t n = i == 0 ? 1 : 8*i;
+		for(std::size_t j=0; j<n; ++j)
+			ones[j/8] |= B(0x80 >> j%8);
+		Hex(table[i], c, 16);
+		if(!Ecb_block<Cipher>(k, p, c))
+			return false;
+		}
+	return true;
+	}
+
+	// TEMPLATE FUNCTION Ecb_monte_carlo
+template<class Cipher>
+	bool Ecb_monte_carlo(bool encrypt, const char* key, const char* text,
+		const char* first, const char* last)
+	{   // CAVP monte carlo test: 100 outer iterations of 1000 chained blocks (AES-256)
+	typedef Aes_types::bit8 B;
+	B k[32], b[16], prev[16], expected[16];
+	Hex(key, k, 32);
+	Hex(text, b, 16);
+	for(int i=0; i<100; ++i)
+		{
+		Cipher c;
+		c.initialize(k);
+		for(int j=0; j<1000; ++j)
+			{
+			std::memcpy(prev, b, 16);
+			if(encrypt)
+				c.encrypt_block(b);
+			else
+				c.decrypt_block(b);
+			}
+		if(i == 0 || i == 99)
+			{   // compare output of the first and the last iteration
+			Hex(i == 0 ? first : last, expected, 16);
+			if(std::memcmp(b, expected, 16) != 0)
+				return false;
+			}
+		for(int j=0; j<16; ++j)
+			{   // key ^= output[998] || output[999]
+			k[j] ^= prev[j];
+			k[16+j] ^= b[j];
+			}
+		}
+	return true;
+	}
+
+	// STRUCT Known_answer_vectors
+struct Known_answer_vectors
+	{   // CAVP and SP 800-38A vectors for one key length (hex strings, tables end with null)
+	const char* bits;            // key length in the test names
+	const char* fips197;         // FIPS-197 appendix C ciphertext
+	const char* const* gfsbox;   // GFSbox (key 0): plaintext, ciphertext, ...
+	const char* const* keysbox;  // KeySbox (plaintext 0): key, ciphertext, ...
+	const char* const* vartxt;   // VarTxt (key 0): ciphertexts of 1, 8, 16, .. leading one bits
+	const char* const* varkey;   // VarKey (plaintext 0): ciphertexts of 1, 8, 16, .. leading one bits
+	const char* sp_key;          // SP 800-38A key
+	const char* sp_ecb_name;
+	const char* sp_ecb_cipher;   // ECB of the first example block
+	const char* sp_ctr_name;
+	const char* sp_ctr_cipher;   // CTR of the first example block
+	};
+
+	// FUNCTION Vectors
+inline const Known_answer_vectors& Vectors(int key_bytes)
+	{   // test vectors of AES-128, AES-192 or AES-256
+	static const char* const gfsbox128[] = { // plaintext, ciphertext
+		"f34481ec3cc627bacd5dc3fb08f273e6", "0336763e966d92595a567cc9ce537f5e",
+		"9798c4640bad75c7c3227db910174e72", "a9a1631bf4996954ebc093957b234589",
+		"96ab5c2ff612d9dfaae8c31f30c42168", "ff4f8391a6a40ca5b25d23bedd44a597",
+		"6a118a874519e64e9963798a503f1d35", "dc43be40be0e53712f7e2bf5ca707209",
+		"cb9fceec81286ca3e989bd979b0cb284", "92beedab1895a94faa69b632e5cc47ce",
+		"b26aeb1874e47ca8358ff22378f09144", "459264f4798f6a78bacb89c15ed3d601",
+		"58c8e00b2631686d54eab84b91f0aca1", "08a4e2efec8a8e3312ca7460b9040bbf",
+		nullptr};
+	static const char* const keysbox128[] = { // key, ciphertext
+		"10a58869d74be5a374cf867cfb473859", "6d251e6944b051e04eaa6fb4dbf78465",
+		"caea65cdbb75e9169ecd22ebe6e54675", "6e29201190152df4ee058139def610bb",
+		"a2e2fa9baf7d20822ca9f0542f764a41", "c3b44b95d9d2f25670eee9a0de099fa3",
+		"b6364ac4e1de1e285eaf144a2415f7a0", "5d9b05578fc944b3cf1ccf0e746cd581",
+		"64cf9c7abc50b888af65f49d521944b2", "f7efc89d5dba578104016ce5ad659c05",
+		"47d6742eefcc0465dc96355e851b64d9", "0306194f666d183624aa230a8b264ae7",
+		"3eb39790678c56bee34bbcdeccf6cdb5", "858075d536d79ccee571f7d7204b1f67",
+		"64110a924f0743d500ccadae72c13427", "35870c6a57e9e92314bcb8087cde72ce",
+		"18d8126516f8a12ab1a36d9f04d68e51", "6c68e9be5ec41e22c825b7c7affb4363",
+		"f530357968578480b398a3c251cd1093", "f5df39990fc688f1b07224cc03e86cea",
+		"da84367f325d42d601b4326964802e8e", "bba071bcb470f8f6586e5d3add18bc66",
+		"e37b1c6aa2846f6fdb413f238b089f23", "43c9f7e62f5d288bb27aa40ef8fe1ea8",
+		"6c002b682483e0cabcc731c253be5674", "3580d19cff44f1014a7c966a69059de5",
+		"143ae8ed6555aba96110ab58893a8ae1", "806da864dd29d48deafbe764f8202aef",
+		"b69418a85332240dc82492353956ae0c", "a303d940ded8f0baff6f75414cac5243",
+		"71b5c08a1993e1362e4d0ce9b22b78d5", "c2dabd117f8a3ecabfbb11d12194d9d0",
+		"e234cdca2606b81f29408d5f6da21206", "fff60a4740086b3b9c56195b98d91a7b",
+		"13237c49074a3da078dc1d828bb78c6f", "8146a08e2357f0caa30ca8c94d1a0544",
+		"3071a2a48fe6cbd04f1a129098e308f8", "4b98e06d356deb07ebb824e5713f7be3",
+		"90f42ec0f68385f2ffc5dfc03a654dce", "7a20a53d460fc9ce0423a7a0764c6cf2",
+		"febd9a24d8b65c1c787d50a4ed3619a9", "f4a70d8af877f9b02b4c40df57d45b17",
+		nullptr};
+	static const char* const vartxt128[] = { // ciphertext
+		"3ad78e726c1ec02b7ebfe92b23d9ec34", "db4f1aa530967d6732ce4715eb0ee24b",
+		"d7e5dbd3324595f8fdc7d7c571da6c2a", "13001ff5d99806efd25da34f56be854b",
+		"c26277437420c5d634f715aea81a9132", "95e3a0ca9079e646331df8b4e70d2cd6",
+		"1c3112bcb0c1dcc749d799743691bf82", "1bfd4b91c701fd6b61b7f997829d663b",
+		"f807c3e7985fe0f5a50e2cdb25c5109e", "d93eae966fac46dca927d6b114fa3f9e",
+		"4d37c850644563c69fd0acd9a049325b", "4c6a1c83e568cd10f27c2d73ded19c28",
+		"123c1f4af313ad8c2ce648b2e71fb6e1", "ed3c0a94d59bece98835da7aa4f07ca2",
+		"545f2b83d9616dccf60fa9830e9cd287", "3bd141ee84a0e6414a26e7a4f281f8a2",
+		"3f5b8cc9ea855a0afa7347d23e8d664e",
+		nullptr};
+	static const char* const varkey128[] = { // ciphertext
+		"0edd33d3c621e546455bd8ba1418bec8", "b1d758256b28fd850ad4944208cf1155",
+		"97d0754fe68f11b9e375d070a608c884", "de11722d893e9f9121c381becc1da59a",
+		"9c28524a16a1e1c1452971caa8d13476", "7df4daf4ad29a3615a9b6ece5c99518a",
+		"75550e6cb5a88e49634c9ab69eda0430", "b5ab3013dd1e61df06cbaf34ca2aee78",
+		"84be19e053635f09f2665e7bae85b42d", "1ea448c2aac954f5d812e9d78494446a",
+		"ec198a18e10e532403b7e20887c8dd80", "ea3695e1351b9d6858bd958cf513ef6c",
+		"f0c5c6ffa5e0bd3a94c88f6b6f7c16b9", "2cb1dc3a9c72972e425ae2ef3eb597cd",
+		"b4750ff263a65e1f9e924ccfd98f3e37", "2dce3acb727cd13ccd76d425ea56e4f6",
+		"a1f6258c877d5fcd8964484538bfc92c",
+		nullptr};
+	static const char* const gfsbox192[] = { // plaintext, ciphertext
+		"1b077a6af4b7f98229de786d7516b639", "275cfc0413d8ccb70513c3859b1d0f72",
+		"9c2d8842e5f48f57648205d39a239af1", "c9b8135ff1b5adc413dfd053b21bd96d",
+		"bff52510095f518ecca60af4205444bb", "4a3650c3371ce2eb35e389a171427440",
+		"51719783d3185a535bd75adc65071ce1", "4f354592ff7c8847d2d0870ca9481b7c",
+		"26aa49dcfe7629a8901a69a9914e6dfd", "d5e08bf9a182e857cf40b3a36ee248cc",
+		"941a4773058224e1ef66d10e0a6ee782", "067cd9d3749207791841562507fa9626",
+		nullptr};
+	static const char* const keysbox192[] = { // key, ciphertext
+		"e9f065d7c13573587f7875357dfbb16c53489f6a4bd0f7cd", "0956259c9cd5cfd0181cca53380cde06",
+		"15d20f6ebc7e649fd95b76b107e6daba967c8a9484797f29", "8e4e18424e591a3d5b6f0876f16f8594",
+		"a8a282ee31c03fae4f8e9b8930d5473c2ed695a347e88b7c", "93f3270cfc877ef17e106ce938979cb0",
+		"cd62376d5ebb414917f0c78f05266433dc9192a1ec943300", "7f6c25ff41858561bb62f36492e93c29",
+		"502a6ab36984af268bf423c7f509205207fc1552af4a91e5", "8e06556dcbb00b809a025047cff2a940",
+		"25a39dbfd8034f71a81f9ceb55026e4037f8f6aa30ab44ce", "3608c344868e94555d23a120f8a5502d",
+		"e08c15411774ec4a908b64eadc6ac4199c7cd453f3aaef53", "77da2021935b840b7f5dcc39132da9e5",
+		"3b375a1ff7e8d44409696e6326ec9dec86138e2ae010b980", "3b7c24f825e3bf9873c9f14d39a0e6f4",
+		"950bb9f22cc35be6fe79f52c320af93dec5bc9c0c2f9cd53", "64ebf95686b353508c90ecd8b6134316",
+		"7001c487cc3e572cfc92f4d0e697d982e8856fdcc957da40", "ff558c5d27210b7929b73fc708eb4cf1",
+		"f029ce61d4e5a405b41ead0a883cc6a737da2cf50a6c92ae", "a2c3b2a818075490a7b4c14380f02702",
+		"61257134a518a0d57d9d244d45f6498cbc32f2bafc522d79", "cfe4d74002696ccf7d87b14a2f9cafc9",
+		"b0ab0a6a818baef2d11fa33eac947284fb7d748cfb75e570", "d2eafd86f63b109b91f5dbb3a3fb7e13",
+		"ee053aa011c8b428cdcc3636313c54d6a03cac01c71579d6", "9b9fdd1c5975655f539998b306a324af",
+		"d2926527e0aa9f37b45e2ec2ade5853ef807576104c7ace3", "dd619e1cf204446112e0af2b9afa8f8c",
+		"982215f4e173dfa0fcffe5d3da41c4812c7bcc8ed3540f93", "d4f0aae13c8fe9339fbf9e69ed0ad74d",
+		"98c6b8e01e379fbd14e61af6af891596583565f2a27d59e9", "19c80ec4a6deb7e5ed1033dda933498f",
+		"b3ad5cea1dddc214ca969ac35f37dae1a9a9d1528f89bb35", "3cf5e1d21a17956d1dffad6a7c41c659",
+		"45899367c3132849763073c435a9288a766c8b9ec2308516", "69fd12e8505f8ded2fdcb197a121b362",
+		"ec250e04c3903f602647b85a401a1ae7ca2f02f67fa4253e", "8aa584e2cc4d17417a97cb9a28ba29c8",
+		"d077a03bd8a38973928ccafe4a9d2f455130bd0af5ae46a9", "abc786fb1edb504580c4d882ef29a0c7",
+		"d184c36cf0dddfec39e654195006022237871a47c33d3198", "2e19fb60a3e1de0166f483c97824a978",
+		"4c6994ffa9dcdc805b60c2c0095334c42d95a8fc0ca5b080", "7656709538dd5fec41e0ce6a0f8e207d",
+		"c88f5b00a4ef9a6840e2acaf33f00a3bdc4e25895303fa72", "a67cf333b314d411d3c0ae6e1cfcd8f5",
+		nullptr};
+	static const char* const vartxt192[] = { // ciphertext
+		"6cd02513e8d4dc986b4afe087a60bd0c", "32bb6a7ec84499e166f936003d55a5bb",
+		"e98f4ba4f073df4baa116d011dc24a28", "a7876ec87f5a09bfea42c77da30fd50e",
+		"1b38d4f7452afefcb7fc721244e4b72e", "c94337c37c4e790ab45780bd9c3674a0",
+		"1ee5ab003dc8722e74905d9a8fe3d350", "534923c169d504d7519c15d30e756c50",
+		"93baaffb35fbe739c17c6ac22eecf18f", "091d1fdc2bd2c346cd5046a8c6209146",
+		"54d632d03aba0bd0f91877ebdd4d09cb", "71dbf37e87a2e34d15b20e8f10e48924",
+		"2e3febfd625bfcd0a2c06eb460da1732", "9ca09c25f273a766db98a480ce8dfedc",
+		"4019250f6eefb2ac5ccbcae044e75c7e", "6b98b17e80d1118e3516bd768b285a84",
+		"b13db4da1f718bc6904797c82bcf2d32",
+		nullptr};
+	static const char* const varkey192[] = { // ciphertext
+		"de885dc87f5a92594082d02cc1e1b42c", "833f71258d53036b02952c76c744f5a1",
+		"b7d67cf1a1e91e8ff3a57a172c7bf412", "446ee416f9ad1c103eb0cc96751c88e1",
+		"b16fa71f846b81a13f361c43a851f290", "6afaa996226198b3e2610413ce1b3f78",
+		"c79a637beb1c0304f14014c037e736dd", "ca6108d1d98071428eeceef1714b96dd",
+		"707b075791878880b44189d3522b8c30", "c0541329ecb6159ab23b7fc5e6a21bca",
+		"172df8b02f04b53adab028b4e01acd87", "344aab37080d7486f7d542a309e53eed",
+		"03aa9058490eda306001a8a9f48d0ca7", "d7cbb3f34b9b450f24b0e8518e54da6d",
+		"d2ccaebd3a4c3e80b063748131ba4a71", "a80fd5020dfe65f5f16293ec92c6fd89",
+		"e8c4e4381feec74054954c05b777a00a", "b8aa90040b4c15a12316b78e0f9586fc",
+		"d436649f600b449ee276530f0cd83c11", "05b389e3322c6da08384345a4137fd08",
+		"c9af27b2c89c9b4cf4a0c4106ac80318", "7b017bb02ec87b2b94c96e40a26fc71a",
+		"cf42fb474293d96eca9db1b37b1ba676", "5674a3bed27bf4bd3622f9f5fe208306",
+		"dd8a493514231cbf56eccee4c40889fb",
+		nullptr};
+	static const char* const gfsbox256[] = { // plaintext, ciphertext
+		"014730f80ac625fe84f026c60bfd547d", "5c9d844ed46f9885085e5d6a4f94c7d7",
+		"0b24af36193ce4665f2825d7b4749c98", "a9ff75bd7cf6613d3731c77c3b6d0c04",
+		"761c1fe41a18acf20d241650611d90f1", "623a52fcea5d443e48d9181ab32c7421",
+		"8a560769d605868ad80d819bdba03771", "38f2c7ae10612415d27ca190d27da8b4",
+		"91fbef2d15a97816060bee1feaa49afe", "1bc704f1bce135ceb810341b216d7abe",
+		nullptr};
+	static const char* const keysbox256[] = { // key, ciphertext
+		"c47b0294dbbbee0fec4757f22ffeee3587ca4730c3d33b691df38bab076bc558", "46f2fb342d6f0ab477476fc501242c5f",
+		"28d46cffa158533194214a91e712fc2b45b518076675affd910edeca5f41ac64", "4bf3b0a69aeb6657794f2901b1440ad4",
+		"c1cc358b449909a19436cfbb3f852ef8bcb5ed12ac7058325f56e6099aab1a1c", "352065272169abf9856843927d0674fd",
+		"984ca75f4ee8d706f46c2d98c0bf4a45f5b00d791c2dfeb191b5ed8e420fd627", "4307456a9e67813b452e15fa8fffe398",
+		"b43d08a447ac8609baadae4ff12918b9f68fc1653f1269222f123981ded7a92f", "4663446607354989477a5c6f0f007ef4",
+		"1d85a181b54cde51f0e098095b2962fdc93b51fe9b88602b3f54130bf76a5bd9", "531c2c38344578b84d50b3c917bbb6e1",
+		"dc0eba1f2232a7879ded34ed8428eeb8769b056bbaf8ad77cb65c3541430b4cf", "fc6aec906323480005c58e7e1ab004ad",
+		"f8be9ba615c5a952cabbca24f68f8593039624d524c816acda2c9183bd917cb9", "a3944b95ca0b52043584ef02151926a8",
+		"797f8b3d176dac5b7e34a2d539c4ef367a16f8635f6264737591c5c07bf57a3e", "a74289fe73a4c123ca189ea1e1b49ad5",
+		"6838d40caf927749c13f0329d331f448e202c73ef52c5f73a37ca635d4c47707", "b91d4ea4488644b56cf0812fa7fcf5fc",
+		"ccd1bc3c659cd3c59bc437484e3c5c724441da8d6e90ce556cd57d0752663bbc", "304f81ab61a80c2e743b94d5002a126b",
+		"13428b5e4c005e0636dd338405d173ab135dec2a25c22c5df0722d69dcc43887", "649a71545378c783e368c9ade7114f6c",
+		"07eb03a08d291d1b07408bf3512ab40c91097ac77461aad4bb859647f74f00ee", "47cb030da2ab051dfc6c4bf6910d12bb",
+		"90143ae20cd78c5d8ebdd6cb9dc1762427a96c78c639bccc41a61424564eafe1", "798c7c005dee432b2c8ea5dfa381ecc3",
+		"b7a5794d52737475d53d5a377200849be0260a67a2b22ced8bbef12882270d07", "637c31dc2591a07636f646b72daabbe7",
+		"fca02f3d5011cfc5c1e23165d413a049d4526a991827424d896fe3435e0bf68e", "179a49c712154bbffbe6e7a84a18e220",
+		nullptr};
+	static const char* const vartxt256[] = { // ciphertext
+		"ddc6bf790c15760d8d9aeb6f9a75fd4e", "49af6b372135acef10132e548f217b17",
+		"300ade92f88f48fa2df730ec16ef44cd", "ac86bc606b6640c309e782f232bf367f",
+		"6a4981f2915e3e68af6c22385dd06756", "f96b0c4a8bc6c86130289f60b43b8fba",
+		"ead731af4d3a2fe3b34bed047942a49f", "c0838d1a2b16a7c7f0dfcc433c399c33",
+		"9b58dbfd77fe5aca9cfc190cd1b82d19", "76b5614a042707c98e2132e2e805fe63",
+		"12e71214ae8e04f0bb63d7425c6f14d5", "145b60d6d0193c23f4221848a892d61a",
+		"21d9ba49f276b45f11af8fc71a088e3d", "90ddbcb950843592dd47bbef00fdc876",
+		"5f397bf03084820cc8810d52e5b666e9", "29ee526770f2a11dcfa989d1ce88830f",
+		"acdace8078a32b1a182bfa4987ca1347",
+		nullptr};
+	static const char* const varkey256[] = { // ciphertext
+		"e35a6dcb19b201a01ebcfa8aa22b5759", "ec52a212f80a09df6317021bc2a9819e",
+		"937ad84880db50613423d6d527a2823d", "2c75e2d36eebd65411f14fd0eb1d2a06",
+		"ad9fc613a703251b54c64a0e76431711", "e0dcc2d27fc9865633f85223cf0d611f",
+		"225f068c28476605735ad671bb8f39f3", "4c022ac62b3cb78d739cc67b3e20bb7e",
+		"94efe7a0e2e031e2536da01df799c927", "4b3b9f1e099c2a09dc091e90e4f18f0a",
+		"f33fa36720231afe4c759ade6bd62eb6", "0791823a3c666bb6162825e78606a7fe",
+		"0aeede5b91f721700e9e62edbf60b781", "33f7502390b8a4a221cfecd0666624ba",
+		"cd5ece55b8da3bf622c4100df5de46f9", "190843d29b25a3897c692ce1dd81ee52",
+		"6825a347ac479d4f9d95c5cb8d3fd7e9", "ef1b384ac4d93eda00c92add0995ea5f",
+		"d240d648ce21a3020282c3f1b528a0b6", "33905080f7acf1cdae0a91fc3e85aee4",
+		"93201481665cbafc1fcc220bc545fb3d", "be288319029363c2622feba4b05dfdfe",
+		"ca359c70803a3b2a3d542e8781dea975", "0ddfe51ced7e3f4ae927daa3fe452cee",
+		"77565c8d73cfd4130b4aa14d8911710f", "35e9eddbc375e792c19992c19165012b",
+		"69cd0606e15af729d6bca143016d9842", "26b549c2ec756f82ecc48008e529956b",
+		"70bed8dbf615868a1f9d9b05d3e7a267", "3194367a4898c502c13bb7478640a72d",
+		"563531135e0c4d70a38f8bdb190ba04e", "60eb5af8416b257149372194e8b88749",
+		"4bf85f1b5d54adbc307b0a048389adcb",
+		nullptr};
+
+	static const Known_answer_vectors v[3] = {
+		{"128", "69c4e0d86a7b0430d8cdb78070b4c55a", gfsbox128, keysbox128, vartxt128, varkey128,
+			"2b7e151628aed2a6abf7158809cf4f3c",
+			"SP800-38A F.1.1 ECB", "3ad77bb40d7a3660a89ecaf32466ef97",
+			"SP800-38A F.5.1 CTR", "874d6191b620e3261bef6864990db6ce"},
+		{"192", "dda97ca4864cdfe06eaf70a0ec0d7191", gfsbox192, keysbox192, vartxt192, varkey192,
+			"8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+			"SP800-38A F.1.3 ECB", "bd334f1d6e45f25ff712a214571fa5cc",
+			"SP800-38A F.5.3 CTR", "1abc932417521ca24f2b0459fe7e6e0b"},
+		{"256", "8ea2b7ca516745bfeafc49904b496089", gfsbox256, keysbox256, vartxt256, varkey256,
+			"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+			"SP800-38A F.1.5 ECB", "f3eed1bdb5d2a03c064b5a7e3db181f8",
+			"SP800-38A F.5.5 CTR", "601ec313775789a5b7a7f504bbf3d228"}};
+	assert(key_bytes == 16 || key_bytes == 24 || key_bytes == 32);
+	return v[key_bytes/8 - 2];
+	}
+
+	// TEMPLATE FUNCTION Fips197_vector
+template<class Cipher>
+	bool Fips197_vector(const char* cipher)
+	{   // FIPS-197 appendix C with the key length of Cipher
+	Aes_types::bit8 c[16];
+	Hex(cipher, c, 16);
+	return Aes_known_answer<Cipher>(c);
+	}
+
+	// TEMPLATE FUNCTION Ctr_vector
+template<class Cipher>
+	bool Ctr_vector(const char* key, const char* cipher)
+	{   // SP 800-38A F.5 (first block; key as words)
+	typedef Aes_types::bit8 B;
+	B k[32], iv[16], b[16], c[16];
+	Hex(key, k, Cipher::key_bytes);
+	Hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", iv, 16);
+	Hex("6bc1bee22e409f96e93d7e117393172a", b, 16);
+	Hex(cipher, c, 16);
+	Aes_ctr<Cipher> m;
+	Aes_types::bit32 w[8];
+	for(int i=0; i<Cipher::key_words; ++i)
+		w[i] = (Aes_types::bit32(k[4*i])<<24) | (Aes_types::bit32(k[4*i+1])<<16)
+			 | (Aes_types::bit32(k[4*i+2])<<8) | Aes_types::bit32(k[4*i+3]);
+	m.initialize(w, iv);
+	m.process(b, 16);
+	return (std::memcmp(b, c, 16) == 0);
+	}
+
+	// FUNCTION Report
+inline bool Report(std::ostream& json, const char* backend, const std::string& test,
+	bool passed, bool& first)
+	{   // one result of the known answer tests
+	json << (first ? "\n    " : ",\n    ") << "{\"backend\": \"" << backend
+		 << "\", \"test\": \"" << test << "\", \"passed\": " << (passed ? "true" : "false") << "}";
+	first = false;
+	return passed;
+	}
+
+	// TEMPLATE FUNCTION Known_answer_tests
+template<class Cipher>
+	bool Known_answer_tests(std::ostream& json, const char* backend, bool& first)
+	{   // run all tests of the key length of Cipher for one backend
+	const Known_answer_vectors& v = Vectors(Cipher::key_bytes);
+	const std::string bits = v.bits;
+
+	bool passed = true;
+	passed &= Report(json, backend, "FIPS-197 C (AES-" + bits + ")",
+		Fips197_vector<Cipher>(v.fips197), first);
+	passed &= Report(json, backend, "CAVP ECBGFSbox" + bits, Ecb_table<Cipher>(v.gfsbox, false), first);
+	passed &= Report(json, backend, "CAVP ECBKeySbox" + bits, Ecb_table<Cipher>(v.keysbox, true), first);
+	passed &= Report(json, backend, "CAVP ECBVarTxt" + bits, Ecb_bits<Cipher>(v.vartxt, false), first);
+	passed &= Report(json, backend, "CAVP ECBVarKey" + bits, Ecb_bits<Cipher>(v.varkey, true), first);
+	if(Cipher::key_bytes == 32)
+		{   // monte carlo test (AES-256 only)
+		passed &= Report(json, backend, "CAVP ECBMCT256 encrypt", Ecb_monte_carlo<Cipher>(true,
+			"f9e8389f5b80712e3886cc1fa2d28a3b8c9cd88a2d4a54c6aa86ce0fef944be0",
+			"b379777f9050e2a818f2940cbbd9aba4",
+			"6893ebaf0a1fccc704326529fdfb60db", "c5d2cb3d5b7ff0e23e308967ee074825"), first);
+		passed &= Report(json, backend, "CAVP ECBMCT256 decrypt", Ecb_monte_carlo<Cipher>(false,
+			"f9e8389f5b80712e3886cc1fa2d28a3b8c9cd88a2d4a54c6aa86ce0fef944be0",
+			"b379777f9050e2a818f2940cbbd9aba4",
+			"6495dcc4e60f0dfd2e7994d1698f070e", "0fdb24f22b4a55eaa1633bf04a281b80"), first);
+		}
+	passed &= Report(json, backend, v.sp_ecb_name,
+		Ecb_vector<Cipher>(v.sp_key, "6bc1bee22e409f96e93d7e117393172a", v.sp_ecb_cipher), first);
+	passed &= Report(json, backend, v.sp_ctr_name, Ctr_vector<Cipher>(v.sp_key, v.sp_ctr_cipher), first);
+	return passed;
+	}
+
+	// FUNCTION Key_engine_tests
+inline bool Key_engine_tests(std::ostream& json, bool& first)
+	{   // the AES-256 ECB vectors, interleaved under their own keys (with eviction)
+	typedef Aes_types::bit8 B;
+	const Known_answer_vectors& v = Vectors(32);
+	const char* zero = "0000000000000000000000000000000000000000000000000000000000000000";
+	const char* high = "8000000000000000000000000000000000000000000000000000000000000000";
+	const char* keys[4] = {zero, v.keysbox[0], high, v.sp_key};
+	const char* plain[4] = {v.gfsbox[0], zero, zero, "6bc1bee22e409f96e93d7e117393172a"};
+	const char* cipher[4] = {v.gfsbox[1], v.keysbox[1], v.varkey[0], v.sp_ecb_cipher};
+	const aes256_key_engine::key_id ids[12] = {3, 0, 2, 1, 0, 3, 3, 1, 2, 0, 2, 1};
+
+	B blocks[16*12], expected[16*12], original[16*12];
+	for(int i=0; i<12; ++i)
+		{
+		Hex(plain[ids[i]], blocks + 16*i, 16);
+		Hex(cipher[ids[i]], expected + 16*i, 16);
+		}
+	std::memcpy(original, blocks, sizeof(blocks));
+
+	aes256_key_engine e(2, [&](aes256_key_engine::key_id id, B* k){ Hex(keys[id], k, 32); });
+	e.encrypt_many(ids, blocks, 12);
+	bool passed = Report(json, "aes256_key_engine", "CAVP ECB256 key agile encrypt",
+		std::memcmp(blocks, expected, sizeof(blocks)) == 0, first);
+	e.decrypt_many(ids, blocks, 12);
+	passed &= Report(json, "aes256_key_engine", "CAVP ECB256 key agile decrypt",
+		std::memcmp(blocks, original, sizeof(blocks)) == 0, first);
+	return passed;
+	}
+
+	// TEMPLATE FUNCTION Xts_initialize
+template<class Cipher>
+	void Xts_initialize(Aes_xts<Cipher>& x, const char* key1, const char* key2)
+	{   // initialize from hex keys (data key, tweak key)
+	Aes_types::bit8 k[64];
+	Aes_types::bit32 w[16];
+	Hex(key1, k, Cipher::key_bytes);
+	Hex(key2, k + Cipher::key_bytes, Cipher::key_bytes);
+	for(int i=0; i<2*Cipher::key_words; ++i)
+		w[i] = (Aes_types::bit32(k[4*i])<<24) | (Aes_types::bit32(k[4*i+1])<<16)
+			 | (Aes_types::bit32(k[4*i+2])<<8) | Aes_types::bit32(k[4*i+3]);
+	x.initialize(w, w + Cipher::key_words);
+	}
+
+	// TEMPLATE FUNCTION Xts_vector
+template<class Cipher>
+	bool Xts_vector(const char* key1, const char* key2, unsigned long long sector,
+		std::size_t size, const char* cipher)
+	{   // encrypt and decrypt one sector (plaintext 00 01 02 .., as in IEEE 1619)
+	typedef Aes_types::bit8 B;
+	std::vector<B> b(size), c(size);
+	for(std::size_t i=0; i<size; ++i)
+		b[i] = B(i);
+	Hex(cipher, c.data(), size);
+	Aes_xts<Cipher> x;
+	Xts_initialize(x, key1, key2);
+	x.encrypt_sector(b.data(), size, sector);
+	if(b != c)
+		return false;
+	x.decrypt_sector(b.data(), size, sector);
+	for(std::size_t i=0; i<size; ++i)
+		if(b[i] != B(i))
+			return false;
+	return true;
+	}
+
+	// TEMPLATE FUNCTION Xts_threads_vector
+template<class Cipher>
+	bool Xts_threads_vector(const char* key1, const char* key2, unsigned long long sector,
+		std::size_t size, const char* cipher)
+	{   // sectors 0..1023 on several threads: sector has to give cipher, the others
+		// the result of encrypt_sector
+	typedef Aes_types::bit8 B;
+	const std::size_t count = 1024;
+	std::vector<B> b(count*size), c(size);
+	for(std::size_t i=0; i<b.size(); ++i)
+		b[i] = B(i%size);
+	Hex(cipher, c.data(), size);
+	const std::vector<B> plain = b;
+	Aes_xts<Cipher> x;
+	Xts_initialize(x, key1, key2);
+	x.encrypt_sectors(b.data(), size, 0, count, 4); // at least 2 threads (256 KiB each)
+	if(!std::equal(c.begin(), c.end(), b.begin() + sector*size))
+		return false;
+	std::vector<B> one(plain.begin(), plain.begin() + size);
+	for(std::size_t i=0; i<count; ++i)
+		{   // compare with the single sector function
+		std::copy(plain.begin() + i*size, plain.begin() + (i+1)*size, one.begin());
+		x.encrypt_sector(one.data(), size, i);
+		if(!std::equal(one.begin(), one.end(), b.begin() + i*size))
+			return false;
+		}
+	x.decrypt_sectors(b.data(), size, 0, count, 4);
+	return (b == plain);
+	}
+
+	// FUNCTION Xts_tests
+inline bool Xts_tests(std::ostream& json, bool& first)
+	{   // IEEE 1619 XTS-AES vectors 10 and 15
+	const char* key1 = "2718281828459045235360287471352662497757247093699959574966967627";
+	const char* key2 = "3141592653589793238462643383279502884197169399375105820974944592";
+	const char* vector10 =
+		"1c3b3a102f770386e4836c99e370cf9bea00803f5e482357a4ae12d414a3e63b"
+		"5d31e276f8fe4a8d66b317f9ac683f44680a86ac35adfc3345befecb4bb188fd"
+		"5776926c49a3095eb108fd1098baec70aaa66999a72a82f27d848b21d4a741b0"
+		"c5cd4d5fff9dac89aeba122961d03a757123e9870f8acf1000020887891429ca"
+		"2a3e7a7d7df7b10355165c8b9a6d0a7de8b062c4500dc4cd120c0f7418dae3d0"
+		"b5781c34803fa75421c790dfe1de1834f280d7667b327f6c8cd7557e12ac3a0f"
+		"93ec05c52e0493ef31a12d3d9260f79a289d6a379bc70c50841473d1a8cc81ec"
+		"583e9645e07b8d9670655ba5bbcfecc6dc3966380ad8fecb17b6ba02469a020a"
+		"84e18e8f84252070c13e9f1f289be54fbc481457778f616015e1327a02b140f1"
+		"505eb309326d68378f8374595c849d84f4c333ec4423885143cb47bd71c5edae"
+		"9be69a2ffeceb1bec9de244fbe15992b11b77c040f12bd8f6a975a44a0f90c29"
+		"a9abc3d4d893927284c58754cce294529f8614dcd2aba991925fedc4ae74ffac"
+		"6e333b93eb4aff0479da9a410e4450e0dd7ae4c6e2910900575da401fc07059f"
+		"645e8b7e9bfdef33943054ff84011493c27b3429eaedb4ed5376441a77ed4385"
+		"1ad77f16f541dfd269d50d6a5f14fb0aab1cbb4c1550be97f7ab4066193c4caa"
+		"773dad38014bd2092fa755c824bb5e54c4f36ffda9fcea70b9c6e693e148c151";
+	bool passed = Report(json, "aes256_xts", "IEEE 1619 XTS-AES-256 vector 10",
+		Xts_vector<aes256_cipher>(key1, key2, 0xff, 512, vector10), first);
+	passed &= Report(json, "aes256_xts", "IEEE 1619 XTS-AES-256 vector 10 (encrypt_sectors, 2 threads)",
+		Xts_threads_vector<aes256_cipher>(key1, key2, 0xff, 512, vector10), first);
+	passed &= Report(json, "aes128_xts", "IEEE 1619 XTS-AES-128 vector 15 (ciphertext stealing)",
+		Xts_vector<aes128_cipher>("fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0", "bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0",
+			0x123456789aULL, 17, "6c1625db4671522d3d7599601de7ca09ed"), first);
+	return passed;
+	}
+
+	// FUNCTION Ctr_drbg_vector
+inline bool Ctr_drbg_vector(const char* entropy, const char* personalization,
+	const char* entropy_reseed, const char* additional_reseed,
+	const char* additional1, const char* additional2, const char* returned)
+	{   // instantiate, reseed (if entropy_reseed), generate twice, compare the second output
+	typedef aes256_ctr_drbg::bit8 B;
+	const std::size_t seed = aes256_ctr_drbg::seed_bytes;
+	B e[seed], p[seed], r[seed], ar[seed], a1[seed], a2[seed], out[64], expected[64];
+	const std::size_t np = std::strlen(personalization)/2;
+	const std::size_t nar = std::strlen(additional_reseed)/2;
+	const std::size_t n1 = std::strlen(additional1)/2;
+	const std::size_t n2 = std::strlen(additional2)/2;
+	Hex(entropy, e, seed);
+	Hex(personalization, p, np);
+	Hex(additional_reseed, ar, nar);
+	Hex(additional1, a1, n1);
+	Hex(additional2, a2, n2);
+	Hex(returned, expected, 64);
+
+	aes256_ctr_drbg d(e, p, np);
+	if(*entropy_reseed)
+		{
+		Hex(entropy_reseed, r, seed);
+		d.reseed(r, ar, nar);
+		}
+	d.generate(out, 64, a1, n1);
+	d.generate(out, 64, a2, n2);
+	return (std::memcmp(out, expected, 64) == 0);
+	}
+
+	// FUNCTION Ctr_drbg_tests
+inline bool Ctr_drbg_tests(std::ostream& json, bool& first)
+	{   // SP 800-90A CTR_DRBG, AES-256 without derivation function
+	bool passed = Report(json, "aes256_ctr_drbg", "CAVP CTR_DRBG AES-256 no df", Ctr_drbg_vector(
+		"df5d73faa468649edda33b5cca79b0b05600419ccb7a879d"
+		"dfec9db32ee494e5531b51de16a30f769262474c73bec010",
+		"", "", "", "", "",
+		"d1c07cd95af8a7f11012c84ce48bb8cb87189e99d40fccb1771c619bdf82ab22"
+		"80b1dc2f2581f39164f7ac0c510494b3a43c41b7db17514c87b107ae793e01c5"), first);
+	passed &= Report(json, "aes256_ctr_drbg", "CAVP CTR_DRBG AES-256 no df reseed", Ctr_drbg_vector(
+		"e4bc23c5089a19d86f4119cb3fa08c0a4991e0a1def17e10"
+		"1e4c14d9c323460a7c2fb58e0b086c6c57b55f56cae25bad",
+		"",
+		"fd85a836bba85019881e8c6bad23c9061adc75477659acae"
+		"a8e4a01dfe07a1832dad1c136f59d70f8653a5dc118663d6",
+		"", "", "",
+		"b2cb8905c05e5950ca31895096be29ea3d5a3b82b269495554eb80fe07de43e1"
+		"93b9e7c3ece73b80e062b1c1f68202fbb1c52a040ea2478864295282234aaada"), first);
+	passed &= Report(json, "aes256_ctr_drbg", "CTR_DRBG AES-256 no df reseed, additional input", Ctr_drbg_vector(
+		"000102030405060708090a0b0c0d0e0f1011121314151617"
+		"18191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f",
+		"404142434445464748494a4b4c4d4e4f5051525354555657"
+		"58595a5b5c5d5e5f606162636465666768696a6b6c6d6e6f",
+		"808182838485868788898a8b8c8d8e8f9091929394959697"
+		"98999a9b9c9d9e9fa0a1a2a3a4a5a6a7a8a9aaabacadaeaf",
+		"c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7"
+		"d8d9dadbdcdddedfe0e1e2e3e4e5e6e7e8e9eaebecedeeef",
+		"202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f",
+		"606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f",
+		"39e511b6afd534722cbb9d3e725410539821bb8384bea247a57b73d6f48656a1"
+		"ec396aa51d6a01fc5fc3d5edcf389cd92136c4e8c6860afd26a462c233924f18"), first);
+	return passed;
+	}
+
+	// FUNCTION Cipher_streambuf_tests
+inline bool Cipher_streambuf_tests(std::ostream& json, bool& first)
+	{   // SP 800-38A F.5.5 (CTR-AES256) through cipher_streambuf
+	typedef cipher_streambuf::bit8 B;
+	B k[32], iv[16];
+	cipher_streambuf::bit32 key[8];
+	Hex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4", k, 32);
+	Hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", iv, 16);
+	for(int i=0; i<8; ++i)
+		key[i] = (cipher_streambuf::bit32(k[4*i])<<24) | (cipher_streambuf::bit32(k[4*i+1])<<16)
+			   | (cipher_streambuf::bit32(k[4*i+2])<<8) | cipher_streambuf::bit32(k[4*i+3]);
+	char plain[64], cipher[64];
+	Hex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+		"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+		reinterpret_cast<B*>(plain), 64);
+	Hex("601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5"
+		"2b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6",
+		reinterpret_cast<B*>(cipher), 64);
+
+	std::stringbuf file;
+		{   // a small write (buffered) and a large one (bypasses the 16 byte buffer)
+		cipher_streambuf w(&file, key, iv, 16);
+		w.sputn(plain, 5);
+		w.sputn(plain + 5, 59);
+		}
+	bool passed = Report(json, "cipher_streambuf", "SP800-38A F.5.5 CTR write",
+		file.str() == std::string(cipher, 64), first);
+
+	char back[64] = {};
+	cipher_streambuf r(&file, key, iv, 16);
+	const std::streamsize n = r.sgetn(back, 7);
+	passed &= Report(json, "cipher_streambuf", "SP800-38A F.5.5 CTR read back",
+		n == 7 && r.sgetn(back + 7, 57) == 57 && std::memcmp(back, plain, 64) == 0, first);
+
+	std::stringbuf link; // carries both directions, one after the other
+	cipher_streambuf initiator(&link, key, iv, cipher_side::initiator, 16);
+	cipher_streambuf responder(&link, key, iv, cipher_side::responder, 16);
+	std::memset(back, 0, sizeof(back));
+	passed &= Report(json, "cipher_streambuf", "SP800-38A F.5.5 CTR initiator to responder",
+		initiator.sputn(plain, 64) == 64 && initiator.pubsync() == 0
+		&& link.str() == std::string(cipher, 64)
+		&& responder.sgetn(back, 64) == 64 && std::memcmp(back, plain, 64) == 0, first);
+	std::memset(back, 0, sizeof(back));
+	passed &= Report(json, "cipher_streambuf", "responder to initiator (derived iv)",
+		responder.sputn(plain, 64) == 64 && responder.pubsync() == 0
+		&& link.str().compare(64, 64, cipher, 64) != 0
+		&& initiator.sgetn(back, 64) == 64 && std::memcmp(back, plain, 64) == 0, first);
+	return passed;
+	}
+
+	// FUNCTION run_known_answer_tests
+inline bool run_known_answer_tests(std::ostream& json)
+	{   // known answer tests of all backends (json array)
+	bool first = true;
+	json << "[";
+	bool passed = Known_answer_tests<aes128_cipher>(json, "aes128_cipher", first);
+	passed &= Known_answer_tests<aes192_cipher>(json, "aes192_cipher", first);
+	passed &= Known_answer_tests<aes256_cipher>(json, "aes256_cipher", first);
+	passed &= Key_engine_tests(json, first);
+	passed &= Xts_tests(json, first);
+	passed &= Ctr_drbg_tests(json, first);
+	passed &= Cipher_streambuf_tests(json, first);
+	json << "\n  ]";
+	return passed;
+	}
+
+	// CLASS Benchmark_timer
+class Benchmark_timer
+	{   // measures wall clock time and time stamp counter cycles
+public:
+	Benchmark_timer()
+		: MyStart(std::chrono::steady_clock::now())
+  #ifdef CRYPTO_BENCHMARK_RDTSC
+		, MyCycles(CRYPTO_BENCHMARK_RDTSC())
+  #endif
+		{   // start measuring
+		}
+
+	double seconds() const
+		{   // elapsed wall clock time
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - MyStart).count();
+		}
+
+	double cycles() const
+		{   // elapsed cycles (negative if not available)
+  #ifdef CRYPTO_BENCHMARK_RDTSC
+		return double(CRYPTO_BENCHMARK_RDTSC() - MyCycles);
+  #else
+		return -1.0;
+  #endif
+		}
+
+private:
+	std::chrono::steady_clock::time_point MyStart;
+  #ifdef CRYPTO_BENCHMARK_RDTSC
+	unsigned long long MyCycles;
+  #endif
+	};
+
+	// TEMPLATE FUNCTION Measure
+template<class Fn>
+	void Measure(std::ostream& json, bool& first, const char* backend, const char* operation,
+		std::size_t bytes, unsigned threads, double min_seconds, Fn fn)
+	{   // run fn() until min_seconds have passed and report one result
+	fn(); // warm up (caches, page faults)
+	unsigned long long runs = 0;
+	Benchmark_timer t;
+	double s;
+	do  {
+		fn();
+		++runs;
+		} while((s = t.seconds()) < min_seconds);
+	const double c = t.cycles();
+	const double total = double(bytes)*double(runs);
+
+	json << (first ? "\n    " : ",\n    ") << "{\"backend\": \"" << backend
+		 << "\", \"operation\": \"" << operation << "\", \"bytes\": " << bytes
+		 << ", \"threads\": " << threads << ", \"cycles_per_byte\": ";
+	if(c < 0)
+		json << "null";
+	else
+		json << c/total;
+	json << ", \"gb_per_s\": " << total/s/1e9 << "}";
+	first = false;
+	}
+
+	// FUNCTION Next_size
+inline std::size_t Next_size(std::size_t n, std::size_t max_bytes)
+	{   // next message size: factor 16, the last one is max_bytes (0: done)
+	if(n >= max_bytes)
+		return 0;
+	return n > max_bytes/16 ? max_bytes : n*16;
+	}
+
+	// TEMPLATE FUNCTION Benchmarks
+template<class Cipher>
+	void Benchmarks(std::ostream& json, const char* backend, const benchmark_options& o, bool& first)
+	{   // throughput of one backend
+	typedef Aes_types::bit8 B;
+	typedef typename Aes_ctr<Cipher>::pos_type pos_type;
+	B key[64];
+	B iv[16] = {};
+	Aes_types::bit32 words[16];
+	for(int i=0; i<64; ++i)
+		key[i] = B(i*37+1);
+	for(int i=0; i<16; ++i)
+		words[i] = Aes_types::bit32(i*0x01010101u + 0x10203);
+
+	Cipher c;
+	c.initialize(key);
+	Aes_ctr<Cipher> ctr;
+	ctr.initialize(words, iv);
+	Aes_xts<Cipher> xts;
+	xts.initialize(words, words+8);
+	const unsigned all = o.threads != 0 ? o.threads
+		: std::max(1u, std::thread::hardware_concurrency());
+
+	for(std::size_t n = o.min_bytes; n <= o.max_bytes && n >= 16; n = Next_size(n, o.max_bytes))
+		{
+		std::vector<B> buf(n, B(0x5a));
+		B* p = buf.data();
+
+		Measure(json, first, backend, "block_encrypt", n, 1, o.min_seconds, [&]()
+			{
+			for(std::size_t i=0; i+16<=n; i+=16)
+				c.encrypt_block(p+i);
+			});
+		Measure(json, first, backend, "block_decrypt", n, 1, o.min_seconds, [&]()
+			{
+			for(std::size_t i=0; i+16<=n; i+=16)
+				c.decrypt_block(p+i);
+			});
+		Measure(json, first, backend, "ctr", n, 1, o.min_seconds, [&]()
+			{
+			ctr.seek(0);
+			ctr.process(p, n);
+			});
+
+		const std::size_t sector = n < 4096 ? n : 4096;
+		Measure(json, first, backend, "xts", n/sector*sector, 1, o.min_seconds, [&]()
+			{
+			xts.encrypt_sectors(p, sector, 0, n/sector, 1);
+			});
+
+		if(all > 1 && n >= 1<<20)
+			{   // multithreaded (only for large messages)
+			Measure(json, first, backend, "ctr", n, all, o.min_seconds, [&]()
+				{
+				std::vector<std::thread> workers;
+				const std::size_t part = (n/all + 15)/16*16;
+				for(std::size_t off=0; off<n; off+=part)
+					workers.push_back(std::thread([&, off]()
+						{
+						Aes_ctr<Cipher> m = ctr;
+						m.seek(pos_type(off));
+						m.process(p+off, std::min(part, n-off));
+						}));
+				for(auto& w : workers)
+					w.join();
+				});
+			Measure(json, first, backend, "xts", n/sector*sector, all, o.min_seconds, [&]()
+				{
+				xts.encrypt_sectors(p, sector, 0, n/sector, all);
+				});
+			}
+		}
+	}
+
+	// FUNCTION Key_engine_benchmarks
+inline void Key_engine_benchmarks(std::ostream& json, const benchmark_options& o, bool& first)
+	{   // key agile encryption: every block under one of 1024 keys
+	typedef Aes_types::bit8 B;
+	const std::size_t keys = 1024;
+	const std::size_t max_bytes = std::min<std::size_t>(o.max_bytes, std::size_t(1)<<24);
+	auto provider = [](aes256_key_engine::key_id id, B* k)
+		{
+		for(int i=0; i<32; ++i)
+			k[i] = B(id*131 + i);
+		};
+	aes256_key_engine cached(keys, provider);   // all keys fit: lookups only
+	aes256_key_engine thrashing(64, provider);  // every key is expanded again
+
+	for(std::size_t n = o.min_bytes; n <= max_bytes && n >= 16; n = Next_size(n, max_bytes))
+		{
+		std::vector<B> buf(n, B(0x5a));
+		std::vector<aes256_key_engine::key_id> ids(n/16);
+		for(std::size_t i=0; i<ids.size(); ++i)
+			ids[i] = (i*2654435761u) % keys;
+
+		Measure(json, first, "aes256_key_engine", "key_agile_cached", n, 1, o.min_seconds, [&]()
+			{
+			cached.encrypt_many(ids.data(), buf.data(), ids.size());
+			});
+		Measure(json, first, "aes256_key_engine", "key_agile_expand", n, 1, o.min_seconds, [&]()
+			{
+			thrashing.encrypt_many(ids.data(), buf.data(), ids.size());
+			});
+		}
+	}
+
+	// FUNCTION run_benchmarks
+inline void run_benchmarks(std::ostream& json, const benchmark_options& o = benchmark_options())
+	{   // benchmarks of all backends (json array)
+	bool first = true;
+	json << "[";
+	Benchmarks<aes128_cipher>(json, "aes128_cipher", o, first);
+	Benchmarks<aes192_cipher>(json, "aes192_cipher", o, first);
+	Benchmarks<aes256_cipher>(json, "aes256_cipher", o, first);
+	Key_engine_benchmarks(json, o, first);
+	json << "\n  ]";
+	}
+
+	// FUNCTION run_crypto_suite
+inline bool run_crypto_suite(std::ostream& json, const benchmark_options& o = benchmark_options())
+	{   // known answer tests and benchmarks (json object)
+	json << "{\n  \"known_answer_tests\": ";
+	const bool passed = run_known_answer_tests(json);
+	json << ",\n  \"benchmarks\": ";
+	if(passed)
+		run_benchmarks(json, o); // don't measure a broken implementation
+	else
+		json << "[]";
+	json << "\n}\n";
+	return passed;
+	}
+
+};//end: namespace
@@ -0,0 +1,518 @@
+// directory_benchmark.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+functions:
+	void run_directory_benchmarks(std::ostream& json,
+		const directory_benchmark_options& o = directory_benchmark_options())
+*/
+
+#pragma once
+
+#ifndef __linux__
+  #error "directory_benchmark requires linux (tmpfs, /proc)"
+#endif
+
+#ifndef DIRECTORY_ITERATOR_STATISTICS
+  #ifdef DIRECTORY_ITERATOR_BUFSIZE
+	#error "include directory_benchmark.h before directory_iterator.h (or define DIRECTORY_ITERATOR_STATISTICS)"
+  #endif
+  #define DIRECTORY_ITERATOR_STATISTICS
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "directory_iterator.h"
+#include "directory_index.h"
+#include "parallel_walk.h"
+
+namespace filesys{
+
+inline std::atomic<unsigned long long>& Benchmark_allocations()
+	{   // calls of operator new (DIRECTORY_BENCHMARK_COUNT_ALLOCATIONS)
+	static std::atomic<unsigned long long> n(0);
+	return (n);
+	}
+
+};//end: namespace
+
+#ifdef DIRECTORY_BENCHMARK_COUNT_ALLOCATIONS
+  #if defined(__GNUC__)
+	#define DIRECTORY_BENCHMARK_NOINLINE __attribute__((noinline)) // free() inlined into callers of new: -Wmismatched-new-delete
+  #else
+	#define DIRECTORY_BENCHMARK_NOINLINE
+  #endif
+
+	// replaced global allocation functions (define the macro in one translation unit only)
+DIRECTORY_BENCHMARK_NOINLINE void* operator new(std::size_t n)
+	{   // count and allocate
+	filesys::Benchmark_allocations().fetch_add(1, std::memory_order_relaxed);
+	if(void* p = std::malloc(n != 0 ? n : 1))
+		return (p);
+	throw std::bad_alloc();
+	}
+
+DIRECTORY_BENCHMARK_NOINLINE void operator delete(void* p) noexcept
+	{   // free
+	std::free(p);
+	}
+
+DIRECTORY_BENCHMARK_NOINLINE void operator delete(void* p, std::size_t) noexcept
+	{   // free (sized)
+	std::free(p);
+	}
+#endif
+
+namespace filesys{
+
+/*
+FUNCTION run_directory_benchmarks
+
+generates synthetic trees on tmpfs and measures the iteration of single directories, recursive
+walks and filtered walks. the results are written as one json object:
+
+{ "path": ..., "directory_benchmarks": [ {"tree": ..., "workload": ..., "backend": ..., "entries": ...,
+    "seconds": ..., "entries_per_s": ..., "syscalls_per_entry": ..., "allocations_per_entry": ...,
+    "peak_rss_kb": ...}, ... ] }
+
+trees:
+	flat_N: one directory with N files (default 10^3 ... 10^5, up to 10^7 via the options: the tmpfs
+	        needs enough inodes, see nr_inodes)
+	long_names: one directory, names of name_length characters
+	mixed: one directory with files, directories, symlinks and fifos
+	deep: a narrow chain of deep_depth directories with deep_files files each
+	wide: wide_dirs directories below the root with wide_files files each
+
+workloads (entries and seconds per run):
+	iterate: names of one directory (backends: getdents64, readdir, directory_index)
+	iterate_stat: names, types and sizes (getdents64 + statx, readdir + fstatat),
+	              both stat every entry except "." and ".."
+	filtered: one directory with directory_filter "*.log" (entries: all entries examined)
+	walk: whole tree (serial directory_iterator, readdir, parallel_walk, directory_index)
+	filtered_walk: parallel_walk with the filter in walk_options
+
+-> notice: syscalls are counted by the iterator (DIRECTORY_ITERATOR_STATISTICS, defined by this
+           header): open/close, getdents64 and stat calls. the libc backends report null
+-> notice: allocations are only counted, if DIRECTORY_BENCHMARK_COUNT_ALLOCATIONS is defined in the
+           translation unit, which includes this header (it replaces operator new), null otherwise
+-> notice: peak_rss_kb is VmHWM of the process, reset before every result (/proc/self/clear_refs).
+           it contains the memory of the process itself and of a directory_index, which was built before
+-> notice: the trees are created below path (default: /dev/shm, a tmpfs) and removed afterwards
+-> usage:   #define DIRECTORY_BENCHMARK_COUNT_ALLOCATIONS
+			#include "directory_benchmark.h"
+			int main() { filesys::run_directory_benchmarks(std::cout); }
+*/
+
+	// STRUCT directory_benchmark_options
+struct directory_benchmark_options
+	{   // parameters of the benchmark
+	directory_benchmark_options()
+		: path("/dev/shm/")
+		, flat_sizes({1000, 10000, 100000})
+		, long_names(10000)
+		, name_length(240)
+		, mixed_entries(10000)
+		, deep_depth(256)
+		, deep_files(4)
+		, wide_dirs(1000)
+		, wide_files(100)
+		, min_seconds(0.25)
+		, threads(0)
+		{   // construct with default values
+		}
+
+	std::string path;                    // directory of the trees (with trailing slash)
+	std::vector<std::size_t> flat_sizes; // entries of the flat directories
+	std::size_t long_names;              // entries of long_names
+	std::size_t name_length;             // length of these names (at most 255)
+	std::size_t mixed_entries;           // entries of mixed
+	std::size_t deep_depth;              // levels of deep
+	std::size_t deep_files;              // files per level of deep
+	std::size_t wide_dirs;               // directories of wide
+	std::size_t wide_files;              // files per directory of wide
+	double min_seconds;                  // minimum measuring time per result
+	unsigned threads;                    // threads of parallel_walk (0: all cores)
+	};
+
+	// FUNCTION Bench_name
+inline std::string Bench_name(std::size_t i, std::size_t length = 0)
+	{   // name of the i-th file: f00000042.log, .txt, .dat or .gz (padded to length)
+	static const char* const ext[] = {".log", ".txt", ".dat", ".gz"};
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "f%08lu", static_cast<unsigned long>(i));
+	std::string name(buf);
+	if(name.size() + 4 < length)
+		name.append(length - name.size() - 4, 'x');
+	return (name + ext[i % 4]);
+	}
+
+	// FUNCTION Bench_file
+inline void Bench_file(const std::string& path)
+	{   // create empty file
+	const int fd = ::open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0)
+		throw std::runtime_error("directory_benchmark: unable to create " + path);
+	::close(fd);
+	}
+
+	// FUNCTION Bench_dir
+inline void Bench_dir(const std::string& path)
+	{   // create directory
+	if(::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("directory_benchmark: unable to create " + path);
+	}
+
+	// FUNCTION Bench_remove
+inline void Bench_remove(const std::string& path)
+	{   // remove a tree (children first, symlinks are not followed)
+	::nftw(path.c_str(), [](const char* p, const struct stat*, int, struct FTW*){
+		::remove(p); // keep going
+		return 0;
+		}, 64, FTW_DEPTH | FTW_PHYS);
+	}
+
+	// FUNCTION Bench_reset_peak
+inline void Bench_reset_peak()
+	{   // reset VmHWM to the current resident set
+	const int fd = ::open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+	if(fd < 0)
+		return;
+	const ssize_t ignored = ::write(fd, "5", 1);
+	(void)ignored;
+	::close(fd);
+	}
+
+	// FUNCTION Bench_peak_kb
+inline long Bench_peak_kb()
+	{   // peak resident set of the process (VmHWM, kB)
+	FILE* f = std::fopen("/proc/self/status", "r");
+	if(f == nullptr)
+		return (-1);
+	char line[256];
+	long kb = -1;
+	while(std::fgets(line, sizeof(line), f) != nullptr)
+		if(std::strncmp(line, "VmHWM:", 6) == 0)
+			kb = std::strtol(line + 6, nullptr, 10);
+	std::fclose(f);
+	return (kb);
+	}
+
+	// TEMPLATE FUNCTION Bench_measure
+template<class Fn>
+	void Bench_measure(std::ostream& json, bool& first, const std::string& tree, const char* workload,
+		const char* backend, bool syscalls_counted, double min_seconds, Fn fn)
+	{   // run fn() (returns the entries of one run) until min_seconds have passed and report one result
+	fn(); // warm up (dentry cache, buffers)
+	Bench_reset_peak();
+	const directory_statistics& stats = directory_statistics::get();
+	const unsigned long long syscalls = stats.syscalls();
+	const unsigned long long allocations = Benchmark_allocations().load();
+	unsigned long long runs = 0;
+	unsigned long long entries = 0;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double s;
+	do  {
+		entries += fn();
+		++runs;
+		} while((s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()) < min_seconds);
+	const double calls = double(stats.syscalls() - syscalls);
+	const double allocs = double(Benchmark_allocations().load() - allocations);
+	const double n = entries > 0 ? double(entries) : 1.0;
+
+	json << (first ? "\n    " : ",\n    ") << "{\"tree\": \"" << tree << "\", \"workload\": \"" << workload
+		<< "\", \"backend\": \"" << backend << "\", \"entries\": " << entries/runs
+		<< ", \"seconds\": " << s/double(runs) << ", \"entries_per_s\": " << double(entries)/s
+		<< ", \"syscalls_per_entry\": ";
+	if(syscalls_counted)
+		json << calls/n;
+	else
+		json << "null";
+	json << ", \"allocations_per_entry\": ";
+  #ifdef DIRECTORY_BENCHMARK_COUNT_ALLOCATIONS
+	json << allocs/n;
+  #else
+	(void)allocs;
+	json << "null";
+  #endif
+	json << ", \"peak_rss_kb\": " << Bench_peak_kb() << "}";
+	first = false;
+	}
+
+	// FUNCTION Bench_readdir
+inline unsigned long long Bench_readdir(const std::string& dir, bool stat, bool recursive)
+	{   // libc baseline: readdir (+ fstatat), depth first
+	unsigned long long n = 0;
+	std::vector<std::string> stack(1, dir);
+	while(!stack.empty())
+		{
+		const std::string d = std::move(stack.back());
+		stack.pop_back();
+		DIR* h = ::opendir(d.c_str());
+		if(h == nullptr)
+			continue;
+		while(const dirent* e = ::readdir(h))
+			{
+			if(e->d_name[0] == '.' && (e->d_name[1] == 0 || (e->d_name[1] == '.' && e->d_name[2] == 0)))
+				{   // "." and ".." count like the iterator yields them (single directory)
+				if(!recursive)
+					++n;
+				continue;
+				}
+			++n;
+			if(stat)
+				{
+				struct stat st;
+				::fstatat(::dirfd(h), e->d_name, &st, AT_SYMLINK_NOFOLLOW);
+				}
+			if(recursive && e->d_type == DT_DIR)
+				stack.push_back(d + e->d_name + '/');
+			}
+		::closedir(h);
+		}
+	return (n);
+	}
+
+	// FUNCTION Bench_walk
+inline unsigned long long Bench_walk(const std::string& root)
+	{   // serial walk with directory_iterator, depth first
+	unsigned long long n = 0;
+	std::vector<std::string> stack(1, root);
+	while(!stack.empty())
+		{
+		const std::string d = std::move(stack.back());
+		stack.pop_back();
+		for(directory_iterator it(d); it != directory_iterator(); ++it)
+			{
+			const char* name = it->c_str();
+			if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+				continue;
+			++n;
+			if(it->is_directory())
+				stack.push_back(d + name + '/');
+			}
+		}
+	return (n);
+	}
+
+	// FUNCTION Bench_index_walk
+inline unsigned long long Bench_index_walk(directory_index& index)
+	{   // walk of the index, depth first
+	unsigned long long n = 0;
+	std::vector<std::string> stack(1, std::string());
+	while(!stack.empty())
+		{
+		const std::string d = std::move(stack.back());
+		stack.pop_back();
+		for(index_iterator it = index.list(d); it != index_iterator(); ++it)
+			{
+			++n;
+			if(it->is_directory())
+				stack.push_back(d + it->c_str() + '/');
+			}
+		}
+	return (n);
+	}
+
+	// FUNCTION Bench_directory
+inline void Bench_directory(std::ostream& json, bool& first, const std::string& tree, const std::string& dir,
+	const directory_benchmark_options& o)
+	{   // single directory workloads
+	directory_filter filter;
+	filter.add_glob("*.log");
+	unsigned long long total = 0;
+	for(directory_iterator it(dir); it != directory_iterator(); ++it)
+		++total;
+
+	Bench_measure(json, first, tree, "iterate", "getdents64", true, o.min_seconds, [&]()
+		{
+		unsigned long long n = 0;
+		for(directory_iterator it(dir); it != directory_iterator(); ++it)
+			++n;
+		return (n);
+		});
+	Bench_measure(json, first, tree, "iterate", "readdir", false, o.min_seconds, [&]()
+		{
+		return (Bench_readdir(dir, false, false));
+		});
+		{   // index built before, its memory is part of peak_rss_kb
+		directory_index index(dir);
+		Bench_measure(json, first, tree, "iterate", "directory_index", true, o.min_seconds, [&]()
+			{
+			unsigned long long n = 0;
+			for(index_iterator it = index.list(""); it != index_iterator(); ++it)
+				++n;
+			return (n);
+			});
+		}
+	Bench_measure(json, first, tree, "iterate_stat", "getdents64", true, o.min_seconds, [&]()
+		{
+		unsigned long long n = 0;
+		for(directory_iterator it(dir); it != directory_iterator(); ++it, ++n)
+			{   // every entry but "." and "..", like the readdir baseline
+			const char* name = it->c_str();
+			if(!(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))))
+				(void)it->file_size();
+			}
+		return (n);
+		});
+	Bench_measure(json, first, tree, "iterate_stat", "readdir", false, o.min_seconds, [&]()
+		{
+		return (Bench_readdir(dir, true, false));
+		});
+	Bench_measure(json, first, tree, "filtered", "getdents64", true, o.min_seconds, [&]()
+		{
+		for(directory_iterator it(dir, filter); it != directory_iterator(); ++it)
+			;
+		return (total);
+		});
+	}
+
+	// FUNCTION Bench_tree
+inline void Bench_tree(std::ostream& json, bool& first, const std::string& tree, const std::string& root,
+	const directory_benchmark_options& o)
+	{   // recursive workloads
+	walk_options options;
+	options.threads = o.threads;
+	const unsigned long long total = Bench_walk(root);
+
+	Bench_measure(json, first, tree, "walk", "directory_iterator", true, o.min_seconds, [&]()
+		{
+		return (Bench_walk(root));
+		});
+	Bench_measure(json, first, tree, "walk", "readdir", false, o.min_seconds, [&]()
+		{
+		return (Bench_readdir(root, false, true));
+		});
+	Bench_measure(json, first, tree, "walk", "parallel_walk", true, o.min_seconds, [&]()
+		{
+		std::atomic<unsigned long long> n(0);
+		parallel_walk(root, [&](const walk_batch& b){ n += b.entries.size(); }, options);
+		return (n.load());
+		});
+		{   // index built before, its memory is part of peak_rss_kb
+		directory_index index(root);
+		Bench_measure(json, first, tree, "walk", "directory_index", true, o.min_seconds, [&]()
+			{
+			return (Bench_index_walk(index));
+			});
+		}
+	directory_filter filter;
+	filter.add_extension("log");
+	options.filter = &filter;
+	Bench_measure(json, first, tree, "filtered_walk", "parallel_walk", true, o.min_seconds, [&]()
+		{
+		parallel_walk(root, [](const walk_batch&){}, options);
+		return (total);
+		});
+	}
+
+	// FUNCTION run_directory_benchmarks
+inline void run_directory_benchmarks(std::ostream& json,
+	const directory_benchmark_options& o = directory_benchmark_options())
+	{   // generate the trees, run all workloads (json object)
+	std::string base = o.path;
+	if(base.empty() || base.back() != '/')
+		base.push_back('/');
+	base += "directory_benchmark." + std::to_string(::getpid()) + '/';
+	Bench_remove(base);
+	Bench_dir(base);
+
+	bool first = true;
+	json << "{\"path\": \"" << base << "\", \"directory_benchmarks\": [";
+	try {
+		for(std::size_t size : o.flat_sizes)
+			{   // flat directories
+			const std::string tree = "flat_" + std::to_string(size);
+			const std::string dir = base + tree + '/';
+			Bench_dir(dir);
+			for(std::size_t i=0; i<size; ++i)
+				Bench_file(dir + Bench_name(i));
+			Bench_directory(json, first, tree, dir, o);
+			Bench_remove(dir);
+			}
+
+			{   // long names
+			const std::string dir = base + "long_names/";
+			Bench_dir(dir);
+			for(std::size_t i=0; i<o.long_names; ++i)
+				Bench_file(dir + Bench_name(i, o.name_length));
+			Bench_directory(json, first, "long_names", dir, o);
+			Bench_remove(dir);
+			}
+
+			{   // mixed types: files, directories, symlinks, fifos
+			const std::string dir = base + "mixed/";
+			Bench_dir(dir);
+			for(std::size_t i=0; i<o.mixed_entries; ++i)
+				{
+				const std::string p = dir + Bench_name(i);
+				switch(i % 8)
+					{
+					case 0: Bench_dir(p); break;
+					case 1: if(::symlink("../long_names", p.c_str()) != 0) Bench_file(p); break;
+					case 2: if(::mkfifo(p.c_str(), 0644) != 0) Bench_file(p); break;
+					default: Bench_file(p); break;
+					}
+				}
+			Bench_directory(json, first, "mixed", dir, o);
+			Bench_remove(dir);
+			}
+
+			{   // deep, narrow tree
+			std::string dir = base + "deep/";
+			Bench_dir(dir);
+			for(std::size_t level=0; level<o.deep_depth; ++level)
+				{
+				for(std::size_t i=0; i<o.deep_files; ++i)
+					Bench_file(dir + Bench_name(i));
+				dir += "d/";
+				Bench_dir(dir);
+				}
+			Bench_tree(json, first, "deep", base + "deep/", o);
+			Bench_remove(base + "deep/");
+			}
+
+			{   // wide, shallow tree
+			const std::string root = base + "wide/";
+			Bench_dir(root);
+			for(std::size_t d=0; d<o.wide_dirs; ++d)
+				{
+				const std::string dir = root + "d" + std::to_string(d) + '/';
+				Bench_dir(dir);
+				for(std::size_t i=0; i<o.wide_files; ++i)
+					Bench_file(dir + Bench_name(i));
+				}
+			Bench_tree(json, first, "wide", root, o);
+			Bench_remove(root);
+			}
+		}
+	catch(...)
+		{   // remove the trees, report the error
+		Bench_remove(base);
+		throw;
+		}
+	Bench_remove(base);
+	json << "\n  ]}" << std::endl;
+	}
+
+};//end: namespace
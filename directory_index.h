@@ -0,0 +1,835 @@
+// directory_index.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	index_iterator
+	directory_index
+*/
+
+#pragma once
+
+#ifndef __linux__
+  #error "directory_index requires linux (inotify)"
+#endif
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "directory_iterator.h"
+#include "mapped_file.h"
+
+#define DIRECTORY_INDEX_EVENT_BUFSIZE (64*1024) // bytes of inotify events fetched per read
+#define DIRECTORY_INDEX_MAGIC "FSIDX\x01\r\n"   // first 8 bytes of a snapshot file
+
+namespace filesys{
+
+	// TEMPLATE STRUCT Basic_index_record
+template<class T>
+	struct Basic_index_record
+	{   // one entry of an indexed directory
+	T name;
+	file_type type;
+	unsigned long mode;       // st_mode
+	unsigned long long size;
+	long long time;           // last write time: nanoseconds since 1970
+	};
+
+/*
+TEMPLATE CLASS index_iterator
+
+lists one directory of a directory_index, same interface as directory_iterator
+-> notice: the iterator holds a snapshot of the directory (immutable, shared with the index). updates
+           of the index do not change it, the snapshot is released with the last iterator
+-> notice: entries refer to the names of the snapshot (no copy), all metadata is known (no statx).
+           the entries "." and ".." are not part of the index
+-> usage:   for(auto it=index.list("src/"); it != index_iterator(); ++it)
+				std::cout << it->c_str() << " " << it->file_size() << std::endl;
+*/
+
+	// TEMPLATE CLASS Basic_index_iterator
+template<class T>
+	class Basic_index_iterator
+	{
+public:
+	typedef std::input_iterator_tag iterator_category;
+	typedef Basic_directory_entry<T> value_type;
+	typedef std::ptrdiff_t		 difference_type;
+	typedef value_type*			 pointer;
+	typedef value_type&			 reference;
+	typedef const value_type* 	 const_pointer;
+	typedef const value_type&    const_reference;
+	typedef typename T::size_type	 size_type;
+	typedef Basic_directory_filter<T> filter_type;
+	typedef Basic_index_record<T> record_type;
+	typedef std::shared_ptr<const std::vector<record_type>> shared_list;
+
+	Basic_index_iterator()
+		: MyList()
+		, MyPos(0)
+		, MyCurrent()
+		, MyFilter(nullptr)
+		{   // end-iterator
+		}
+
+	Basic_index_iterator(const Basic_index_iterator& o)
+		: MyList(o.MyList)
+		, MyPos(o.MyPos)
+		, MyCurrent()
+		, MyFilter(o.MyFilter)
+		{   // construct by copying (shares the snapshot)
+		MyCurrent.Share(o.MyCurrent);
+		}
+
+	Basic_index_iterator(Basic_index_iterator&& o)
+		: MyList(std::move(o.MyList))
+		, MyPos(o.MyPos)
+		, MyCurrent(std::move(o.MyCurrent))
+		, MyFilter(o.MyFilter)
+		{   // construct by moving
+		o.Clear();
+		}
+
+	Basic_index_iterator(const shared_list& list, const filter_type* filter = nullptr)
+		: MyList(list)
+		, MyPos(0)
+		, MyCurrent()
+		, MyFilter(filter)
+		{   // construct from snapshot of a directory
+		Seek();
+		}
+
+	Basic_index_iterator& operator = (const Basic_index_iterator& o)
+		{   // assign by copying
+		Basic_index_iterator tmp(o);
+		swap(tmp);
+		return (*this);
+		}
+
+	Basic_index_iterator& operator = (Basic_index_iterator&& o)
+		{   // assign by moving
+		if(this != &o)
+			{
+			Clear();
+			swap(o);
+			}
+		return (*this);
+		}
+
+	Basic_index_iterator& operator ++ ()
+		{   // pre-increment
+		++MyPos;
+		Seek();
+		return (*this);
+		}
+
+	Basic_index_iterator operator ++(int)
+		{   // increment
+		Basic_index_iterator tmp = *this;
+		++*this;
+		return tmp;
+		}
+
+	Basic_index_iterator& operator += (/*int*/ size_type num)
+		{   // step Forward
+		std::advance(*this, num);
+		return (*this);
+		}
+
+	Basic_index_iterator operator + (int num) const
+		{   // step Forward
+		Basic_index_iterator tmp = *this;
+		return (tmp += num);
+		}
+
+	const value_type& operator * () const
+		{   // reference to the current entry
+		return (MyCurrent);
+		}
+
+	const value_type* operator ->() const
+		{   // pointer to the current entry
+		return (&MyCurrent);
+		}
+
+	value_type get() const
+		{   // copy the current entry (owns its name)
+		return (MyCurrent);
+		}
+
+	void swap(Basic_index_iterator& o)
+		{   // exchange internals
+		std::swap(MyList, o.MyList);
+		std::swap(MyPos, o.MyPos);
+		std::swap(MyCurrent, o.MyCurrent);
+		std::swap(MyFilter, o.MyFilter);
+		}
+
+	bool equals(const Basic_index_iterator& o) const
+		{   // test for equality (end-iterators have no snapshot)
+		return (MyList == o.MyList && (!MyList || MyPos == o.MyPos));
+		}
+
+private:
+	template<class> friend class Basic_directory_index;
+
+	Basic_index_iterator(const shared_list& list, std::size_t pos)
+		: MyList(list)
+		, MyPos(pos)
+		, MyCurrent()
+		, MyFilter(nullptr)
+		{   // construct at entry pos (lookup)
+		Seek();
+		}
+
+	void Seek()
+		{   // current entry: the first matching one at or after MyPos
+		for(; MyList && MyPos < MyList->size(); ++MyPos)
+			{   // skip the entries, which do not match the filter
+			const record_type& r = (*MyList)[MyPos];
+			MyCurrent.Assign_known(r.name.c_str(), r.name.size(), r.type, r.size,
+				typename value_type::time_type(std::chrono::duration_cast<typename value_type::time_type::duration>(
+					std::chrono::nanoseconds(r.time))), r.mode);
+			if(!MyFilter || MyFilter->match(MyCurrent))
+				return;
+			}
+		Clear();
+		}
+
+	void Clear()
+		{   // make end-iterator
+		MyList = shared_list();
+		MyPos = 0;
+		MyCurrent.clear();
+		}
+
+	shared_list MyList;   // snapshot of the directory
+	std::size_t MyPos;    // current record
+	value_type MyCurrent; // current entry
+	const filter_type* MyFilter; // not owned (nullptr: all entries)
+	};
+
+
+template<class T>
+	bool operator == (const Basic_index_iterator<T>& l, const Basic_index_iterator<T>& r)
+	{   // test for equality
+	return (l.equals(r));
+	}
+
+template<class T>
+	bool operator != (const Basic_index_iterator<T>& l, const Basic_index_iterator<T>& r)
+	{   // test for inequality
+	return !(l == r);
+	}
+
+template<class T>
+	void swap(Basic_index_iterator<T>& l, Basic_index_iterator<T>& r)
+	{   // exchange internals
+	l.swap(r);
+	}
+
+/*
+TEMPLATE CLASS directory_index
+
+PLATFORM: Linux
+
+in-memory index of a directory tree, kept current by inotify
+-> notice: the constructor lists the whole tree once (one watch per directory). afterwards listings and
+           lookups are served from memory. pending inotify events are applied by update(), which
+           list() and lookup() call first: one non-blocking read, if nothing changed
+-> notice: every directory is stored as a sorted, immutable list of records. an update copies the lists
+           of the changed directories once per batch of events (copy on write), iterators keep their snapshot
+-> notice: paths passed to list() and lookup() are relative to the root ("" or "/" is the root) or absolute,
+           starting with the root. directories end with a slash
+-> notice: save() writes a snapshot file. constructing from a snapshot maps the file and only stats the
+           directories: directories whose mtime changed are listed again. changes of file contents
+           while no index was running do not change the mtime of the directory and are not seen
+-> notice: on an event queue overflow the tree is listed again. directories whose watch could not be
+           added (fs.inotify.max_user_watches) are indexed, but not kept current (see watch_errors())
+-> notice: symlinks are indexed, but not followed. all members are thread safe
+-> usage:   directory_index index("/data/");
+			for(auto it=index.list("logs/"); it != index_iterator(); ++it)
+				total += it->file_size();
+			directory_entry e;
+			if(index.lookup("logs/today.log", e)) ...
+*/
+
+	// TEMPLATE CLASS Basic_directory_index
+template<class T>
+	class Basic_directory_index
+	{
+public:
+	typedef T path_type;
+	typedef typename T::value_type char_type;
+	typedef Basic_directory_entry<T> entry_type;
+	typedef Basic_directory_filter<T> filter_type;
+	typedef Basic_index_iterator<T> iterator;
+	typedef Basic_index_record<T> record_type;
+	typedef std::vector<record_type> list_type;
+	typedef std::shared_ptr<const list_type> shared_list;
+
+	explicit Basic_directory_index(const path_type& root, bool watch = true)
+		: MyRoot(Root(root))
+		, MyNotify(watch ? ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1)
+		{   // construct from root (list the whole tree)
+		Scan(path_type());
+		}
+
+	Basic_directory_index(const path_type& root, const path_type& snapshot, bool watch = true)
+		: MyRoot(Root(root))
+		, MyNotify(watch ? ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1)
+		{   // construct from root and snapshot file (list the tree, if the snapshot is missing or damaged)
+		if(!Load(snapshot))
+			{
+			Reset();
+			Scan(path_type());
+			}
+		}
+
+	Basic_directory_index(const path_type& root, const char_type* snapshot, bool watch = true)
+		: Basic_directory_index(root, path_type(snapshot), watch)
+		{   // construct from root and snapshot file (a literal would convert to bool)
+		}
+
+	~Basic_directory_index()
+		{   // destruct
+		if(MyNotify >= 0)
+			::close(MyNotify);
+		}
+
+	// disable copy construction and copy assignment
+	Basic_directory_index(const Basic_directory_index&) = delete;
+	Basic_directory_index& operator = (const Basic_directory_index&) = delete;
+
+	iterator list(const path_type& dir, const filter_type* filter = nullptr)
+		{   // entries of directory dir (end-iterator: not indexed)
+		std::lock_guard<std::mutex> l(MyMutex);
+		Update();
+		typename dir_map::const_iterator it = MyDirs.find(Key(dir, true));
+		return (it == MyDirs.end() ? iterator() : iterator(it->second.MyList, filter));
+		}
+
+	iterator list(const path_type& dir, const filter_type& filter)
+		{   // entries of directory dir, which match filter
+		return (list(dir, &filter));
+		}
+
+	bool lookup(const path_type& path, entry_type& e)
+		{   // entry of file or directory path (false: not indexed)
+		std::lock_guard<std::mutex> l(MyMutex);
+		Update();
+		path_type key = Key(path, false);
+		if(!key.empty() && key.back() == char_type('/'))
+			key.pop_back();
+		const typename path_type::size_type slash = key.rfind(char_type('/'));
+		const path_type dir = (slash == path_type::npos ? path_type() : key.substr(0, slash + 1));
+		const path_type name = (slash == path_type::npos ? key : key.substr(slash + 1));
+		typename dir_map::const_iterator it = MyDirs.find(dir);
+		if(name.empty() || it == MyDirs.end())
+			return false;
+		const list_type& records = *it->second.MyList;
+		typename list_type::const_iterator pos = Find(records, name);
+		if(pos == records.end() || pos->name != name)
+			return false;
+		e = *iterator(it->second.MyList, static_cast<std::size_t>(pos - records.begin())); // the copy owns its name
+		return true;
+		}
+
+	std::size_t update()
+		{   // apply the pending events, return their number
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (Update());
+		}
+
+	void rebuild()
+		{   // forget everything and list the tree again
+		std::lock_guard<std::mutex> l(MyMutex);
+		Rebuild();
+		}
+
+	bool save(const path_type& snapshot) const
+		{   // write the index to file snapshot (replaced atomically)
+		std::lock_guard<std::mutex> l(MyMutex);
+		const path_type tmp = snapshot + ".tmp";
+		FILE* f = std::fopen(tmp.c_str(), "wb");
+		if(f == nullptr)
+			return false;
+		std::vector<char> buf(64*1024);
+		std::setvbuf(f, buf.data(), _IOFBF, buf.size());
+		bool ok = std::fwrite(DIRECTORY_INDEX_MAGIC, 1, 8, f) == 8;
+		ok = ok && Put<std::uint64_t>(f, MyDirs.size());
+		for(typename dir_map::const_iterator it=MyDirs.begin(); ok && it != MyDirs.end(); ++it)
+			{   // key, mtime and records of every directory
+			ok = Put_string(f, it->first) && Put<std::int64_t>(f, it->second.MyTime)
+				&& Put<std::uint64_t>(f, it->second.MyList->size());
+			for(const record_type& r : *it->second.MyList)
+				ok = ok && Put_string(f, r.name) && Put<std::uint8_t>(f, static_cast<std::uint8_t>(r.type))
+					&& Put<std::uint32_t>(f, static_cast<std::uint32_t>(r.mode)) && Put<std::uint64_t>(f, r.size)
+					&& Put<std::int64_t>(f, r.time);
+			}
+		ok = (std::fclose(f) == 0) && ok;
+		if(ok && std::rename(tmp.c_str(), snapshot.c_str()) == 0)
+			return true;
+		std::remove(tmp.c_str());
+		return false;
+		}
+
+	const path_type& root() const
+		{   // root of the index (with trailing slash)
+		return (MyRoot);
+		}
+
+	std::size_t directories() const
+		{   // number of indexed directories
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (MyDirs.size());
+		}
+
+	std::size_t entries() const
+		{   // number of indexed entries
+		std::lock_guard<std::mutex> l(MyMutex);
+		std::size_t n = 0;
+		for(typename dir_map::const_iterator it=MyDirs.begin(); it != MyDirs.end(); ++it)
+			n += it->second.MyList->size();
+		return (n);
+		}
+
+	bool watching() const
+		{   // test if the index is kept current (inotify available)
+		return (MyNotify >= 0);
+		}
+
+	unsigned long long events() const
+		{   // number of inotify events applied
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (MyEvents);
+		}
+
+	unsigned long long rescans() const
+		{   // number of directories listed (again) after the construction
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (MyRescans);
+		}
+
+	unsigned long long watch_errors() const
+		{   // number of directories, which could not be watched
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (MyWatch_errors);
+		}
+
+private:
+	struct Dir_node
+		{   // indexed directory
+		shared_list MyList; // sorted by name
+		long long MyTime;   // mtime of the directory (ns)
+		int MyWatch;        // inotify watch descriptor (-1: none)
+		};
+
+	typedef std::map<path_type, Dir_node> dir_map; // ordered: a subtree is a range of keys
+
+	enum {
+		Watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB
+			| IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK,
+		Tree_change = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO // a subdirectory was replaced
+		};
+
+	static path_type Root(path_type root)
+		{   // root with trailing slash
+		if(root.empty() || root.back() != char_type('/'))
+			root.push_back(char_type('/'));
+		return (root);
+		}
+
+	path_type Key(const path_type& path, bool dir) const
+		{   // relative path (dir: with trailing slash, root: empty)
+		path_type key = path;
+		if(key.compare(0, MyRoot.size(), MyRoot) == 0)
+			key.erase(0, MyRoot.size());
+		else if(key + char_type('/') == MyRoot)
+			key.clear();
+		if(key.size() == 1 && key[0] == char_type('/'))
+			key.clear();
+		if(dir && !key.empty() && key.back() != char_type('/'))
+			key.push_back(char_type('/'));
+		return (key);
+		}
+
+	static typename list_type::const_iterator Find(const list_type& l, const path_type& name)
+		{   // first record not less than name
+		return (std::lower_bound(l.begin(), l.end(), name,
+			[](const record_type& r, const path_type& n){ return r.name < n; }));
+		}
+
+	static long long Nanoseconds(const struct timespec& t)
+		{   // nanoseconds since 1970
+		return (static_cast<long long>(t.tv_sec) * 1000000000LL + t.tv_nsec);
+		}
+
+	bool Dir_time(const path_type& key, long long& t) const
+		{   // mtime of indexed directory key (false: no directory anymore)
+		struct stat st;
+		DIRECTORY_ITERATOR_COUNT(stats);
+		if(::lstat((MyRoot + key).c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+			return false;
+		t = Nanoseconds(st.st_mtim);
+		return true;
+		}
+
+	bool Stat(const path_type& key, const path_type& name, record_type& r) const
+		{   // record of entry key + name (false: does not exist)
+		struct stat st;
+		DIRECTORY_ITERATOR_COUNT(stats);
+		if(::lstat((MyRoot + key + name).c_str(), &st) != 0)
+			return false;
+		r.name = name;
+		r.mode = st.st_mode;
+		r.size = static_cast<unsigned long long>(st.st_size);
+		r.time = Nanoseconds(st.st_mtim);
+		if(S_ISREG(st.st_mode)) r.type = file_type::regular;
+		else if(S_ISDIR(st.st_mode)) r.type = file_type::directory;
+		else if(S_ISLNK(st.st_mode)) r.type = file_type::symlink;
+		else if(S_ISBLK(st.st_mode)) r.type = file_type::block;
+		else if(S_ISCHR(st.st_mode)) r.type = file_type::character;
+		else if(S_ISFIFO(st.st_mode)) r.type = file_type::fifo;
+		else if(S_ISSOCK(st.st_mode)) r.type = file_type::socket;
+		else r.type = file_type::unknown;
+		return true;
+		}
+
+	int Watch(const path_type& key)
+		{   // watch directory key (-1: not watched)
+		if(MyNotify < 0)
+			return (-1);
+		const int wd = ::inotify_add_watch(MyNotify, (MyRoot + key).c_str(), Watch_mask);
+		if(wd < 0)
+			++MyWatch_errors;
+		else
+			MyWatches[wd] = key;
+		return (wd);
+		}
+
+	void Scan(const path_type& top)
+		{   // list directory top and all new subdirectories
+		std::vector<path_type> stack(1, top);
+		while(!stack.empty())
+			{
+			const path_type key = std::move(stack.back());
+			stack.pop_back();
+			Scan_dir(key, stack);
+			}
+		}
+
+	void Scan_dir(const path_type& key, std::vector<path_type>& stack)
+		{   // list directory key, push its subdirectories, which are not indexed yet
+		typename dir_map::iterator it = MyDirs.find(key);
+		const bool watched = (it != MyDirs.end() && it->second.MyWatch >= 0);
+		const int wd = watched ? it->second.MyWatch : Watch(key); // watch first, then list: no change is lost
+		long long t;
+		if(!Dir_time(key, t))
+			{   // removed in the meantime (the event of the parent follows)
+			if(!watched && wd >= 0)
+				{
+				::inotify_rm_watch(MyNotify, wd);
+				MyWatches.erase(wd);
+				}
+			Remove_tree(key);
+			return;
+			}
+
+		std::shared_ptr<list_type> list = std::make_shared<list_type>();
+		for(Basic_directory_iterator<T> e(MyRoot + key); e != Basic_directory_iterator<T>(); ++e)
+			{
+			const char_type* n = e->c_str();
+			if(n[0] == char_type('.') && (n[1] == 0 || (n[1] == char_type('.') && n[2] == 0)))
+				continue; // skip "." and ".."
+			record_type r;
+			r.name.assign(n, e->length());
+			r.type = e->type();
+			r.mode = e->attributes();
+			r.size = e->file_size();
+			r.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				e->last_write_time().time_since_epoch()).count();
+			if(r.type != file_type::none)
+				list->push_back(std::move(r));
+			}
+		std::sort(list->begin(), list->end(),
+			[](const record_type& a, const record_type& b){ return a.name < b.name; });
+
+		if(it != MyDirs.end())
+			{   // listed again: drop the subtrees, which disappeared
+			for(const record_type& r : *it->second.MyList)
+				if(r.type == file_type::directory)
+					{
+					typename list_type::const_iterator p = Find(*list, r.name);
+					if(p == list->end() || p->name != r.name || p->type != file_type::directory)
+						Remove_tree(key + r.name + char_type('/'));
+					}
+			}
+		for(const record_type& r : *list)
+			if(r.type == file_type::directory && MyDirs.find(key + r.name + char_type('/')) == MyDirs.end())
+				stack.push_back(key + r.name + char_type('/'));
+
+		Dir_node& node = MyDirs[key];
+		node.MyList = std::move(list);
+		node.MyTime = t;
+		node.MyWatch = wd;
+		}
+
+	void Remove_tree(const path_type& prefix)
+		{   // forget directory prefix and all directories below it
+		typename dir_map::iterator it = MyDirs.lower_bound(prefix);
+		while(it != MyDirs.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+			{
+			if(it->second.MyWatch >= 0)
+				{   // fails, if the directory is gone (the kernel removed the watch)
+				::inotify_rm_watch(MyNotify, it->second.MyWatch);
+				MyWatches.erase(it->second.MyWatch);
+				}
+			it = MyDirs.erase(it);
+			}
+		}
+
+	void Reset()
+		{   // forget everything (watches included)
+		Remove_tree(path_type());
+		MyWatches.clear();
+		}
+
+	void Rebuild()
+		{   // list the tree again
+		Reset();
+		Scan(path_type());
+		MyRescans += MyDirs.size();
+		}
+
+	std::size_t Update()
+		{   // read and apply the pending events (MyMutex locked)
+		if(MyNotify < 0)
+			return (0);
+		std::map<path_type, std::map<path_type, std::uint32_t>> changes; // directory -> name -> mask
+		std::size_t count = 0;
+		alignas(inotify_event) char buf[DIRECTORY_INDEX_EVENT_BUFSIZE];
+		for(;;)
+			{   // drain the queue
+			const ssize_t n = ::read(MyNotify, buf, sizeof(buf));
+			DIRECTORY_ITERATOR_COUNT(reads);
+			if(n < 0 && errno == EINTR)
+				continue;
+			if(n <= 0)
+				break; // EAGAIN: nothing pending
+			for(ssize_t i=0; i<n; )
+				{
+				inotify_event ev;
+				std::memcpy(&ev, buf + i, sizeof(ev));
+				const char* name = buf + i + sizeof(inotify_event);
+				i += static_cast<ssize_t>(sizeof(inotify_event) + ev.len);
+				++count;
+				if(ev.mask & IN_Q_OVERFLOW)
+					{   // events were lost
+					changes.clear();
+					Rebuild();
+					continue;
+					}
+				typename std::map<int, path_type>::const_iterator w = MyWatches.find(ev.wd);
+				if(w == MyWatches.end() || (ev.mask & IN_IGNORED))
+					continue; // removed watch
+				if(ev.len == 0)
+					{   // event of the directory itself: the parent reports it, except for the root
+					if(w->second.empty() && (ev.mask & (IN_DELETE_SELF | IN_MOVE_SELF)))
+						{
+						changes.clear();
+						Reset();
+						}
+					continue;
+					}
+				changes[w->second][path_type(name)] |= ev.mask;
+				}
+			}
+
+		std::vector<path_type> stack;
+		for(typename std::map<path_type, std::map<path_type, std::uint32_t>>::const_iterator c=changes.begin();
+				c != changes.end(); ++c)
+			{   // parents come first: a removed subtree is skipped
+			typename dir_map::iterator it = MyDirs.find(c->first);
+			if(it == MyDirs.end())
+				continue;
+			std::shared_ptr<list_type> list = std::make_shared<list_type>(*it->second.MyList); // copy on write
+			for(typename std::map<path_type, std::uint32_t>::const_iterator n=c->second.begin(); n != c->second.end(); ++n)
+				Apply(c->first, n->first, n->second, *list, stack);
+			it->second.MyList = std::move(list);
+			Dir_time(c->first, it->second.MyTime);
+			}
+		while(!stack.empty())
+			{   // list the new subdirectories
+			const path_type key = std::move(stack.back());
+			stack.pop_back();
+			++MyRescans;
+			Scan_dir(key, stack);
+			}
+		MyEvents += count;
+		return (count);
+		}
+
+	void Apply(const path_type& key, const path_type& name, std::uint32_t mask, list_type& list,
+			std::vector<path_type>& stack)
+		{   // bring the record of entry name in directory key up to date
+		record_type r;
+		const bool exists = Stat(key, name, r);
+		typename list_type::iterator pos = list.begin() + (Find(list, name) - list.begin());
+		const bool present = (pos != list.end() && pos->name == name);
+		const path_type sub = key + name + char_type('/');
+		if(present && pos->type == file_type::directory
+				&& (!exists || r.type != file_type::directory || (mask & Tree_change)))
+			Remove_tree(sub); // removed, replaced or moved: list it again
+		if(!exists)
+			{
+			if(present)
+				list.erase(pos);
+			return;
+			}
+		if(present)
+			*pos = std::move(r);
+		else
+			pos = list.insert(pos, std::move(r));
+		if(pos->type == file_type::directory && MyDirs.find(sub) == MyDirs.end())
+			stack.push_back(sub);
+		}
+
+	template<class U>
+		static bool Put(FILE* f, U v)
+		{   // write v (native byte order)
+		return (std::fwrite(&v, sizeof(v), 1, f) == 1);
+		}
+
+	static bool Put_string(FILE* f, const path_type& s)
+		{   // write length and characters of s
+		return (Put<std::uint32_t>(f, static_cast<std::uint32_t>(s.size()))
+			&& std::fwrite(s.data(), sizeof(char_type), s.size(), f) == s.size());
+		}
+
+	struct Reader
+		{   // bounds checked reader of a snapshot
+		const unsigned char* MyPos;
+		const unsigned char* MyEnd;
+
+		template<class U>
+			bool Get(U& v)
+			{   // read v (native byte order)
+			if(static_cast<std::size_t>(MyEnd - MyPos) < sizeof(v))
+				return false;
+			std::memcpy(&v, MyPos, sizeof(v));
+			MyPos += sizeof(v);
+			return true;
+			}
+
+		bool Get_string(path_type& s)
+			{   // read length and characters
+			std::uint32_t n;
+			if(!Get(n) || static_cast<std::size_t>(MyEnd - MyPos) < n*sizeof(char_type))
+				return false;
+			s.assign(reinterpret_cast<const char_type*>(MyPos), n);
+			MyPos += n*sizeof(char_type);
+			return true;
+			}
+		};
+
+	bool Load(const path_type& snapshot)
+		{   // read the snapshot, list the directories, which changed since
+		mapped_file m(snapshot.c_str());
+		if(!m.is_open() || m.size() < 8 || std::memcmp(m.data(), DIRECTORY_INDEX_MAGIC, 8) != 0)
+			return false;
+		Reader in = {m.data() + 8, m.data() + m.size()};
+		std::uint64_t dirs;
+		if(!in.Get(dirs))
+			return false;
+		for(std::uint64_t d=0; d<dirs; ++d)
+			{
+			path_type key;
+			std::int64_t t;
+			std::uint64_t n;
+			if(!in.Get_string(key) || !in.Get(t) || !in.Get(n) || n > m.size())
+				return false;
+			std::shared_ptr<list_type> list = std::make_shared<list_type>();
+			list->reserve(static_cast<std::size_t>(n));
+			for(std::uint64_t i=0; i<n; ++i)
+				{
+				record_type r;
+				std::uint8_t type;
+				std::uint32_t mode;
+				std::uint64_t size;
+				std::int64_t time;
+				if(!in.Get_string(r.name) || !in.Get(type) || !in.Get(mode) || !in.Get(size) || !in.Get(time)
+						|| type > static_cast<std::uint8_t>(file_type::socket))
+					return false;
+				r.type = static_cast<file_type>(type);
+				r.mode = mode;
+				r.size = size;
+				r.time = time;
+				list->push_back(std::move(r));
+				}
+			Dir_node& node = MyDirs[key];
+			node.MyList = std::move(list);
+			node.MyTime = t;
+			node.MyWatch = -1;
+			}
+		if(MyDirs.find(path_type()) == MyDirs.end())
+			return false;
+
+		std::vector<path_type> keys;
+		keys.reserve(MyDirs.size());
+		for(typename dir_map::const_iterator it=MyDirs.begin(); it != MyDirs.end(); ++it)
+			keys.push_back(it->first);
+		std::vector<path_type> stack;
+		for(const path_type& key : keys)
+			{   // parents come first: a removed subtree is skipped
+			typename dir_map::iterator it = MyDirs.find(key);
+			if(it == MyDirs.end())
+				continue;
+			it->second.MyWatch = Watch(key); // watch first, then compare
+			long long t;
+			if(Dir_time(key, t) && t == it->second.MyTime)
+				continue;
+			++MyRescans;
+			Scan_dir(key, stack);
+			}
+		while(!stack.empty())
+			{   // list the new subdirectories
+			const path_type key = std::move(stack.back());
+			stack.pop_back();
+			++MyRescans;
+			Scan_dir(key, stack);
+			}
+		return (MyDirs.find(path_type()) != MyDirs.end());
+		}
+
+	path_type MyRoot;   // with trailing slash
+	int MyNotify;       // inotify instance (-1: not watching)
+	mutable std::mutex MyMutex; // guards the members below
+	dir_map MyDirs;     // relative path (with trailing slash) -> directory
+	std::map<int, path_type> MyWatches; // watch descriptor -> relative path
+	unsigned long long MyEvents = 0;
+	unsigned long long MyRescans = 0;
+	unsigned long long MyWatch_errors = 0;
+	};
+
+	typedef Basic_index_iterator<std::basic_string<char>> index_iterator;
+	typedef Basic_directory_index<std::basic_string<char>> directory_index;
+
+};//end: namespace
@@ -3,9 +3,13 @@
 /*
 HEADER FILE INFORMATION:
 
+language: C++11 required
 source: no source file needed
 
 class:
+	name_arena
+	directory_entry
+	directory_filter
 	directory_iterator
 */
 
@@ -13,20 +17,996 @@ class:
 
 #include <string>
 #include <memory>
-#include <Windows.h>
+#include <iterator>
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+  #include <string_view>
+#endif
+
+#ifdef _WIN32
+  #include <Windows.h>
+#elif defined(__linux__)
+  #include <cstddef>
+  #include <cerrno>
+  #include <cstring>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <dirent.h>
+  #include <sys/stat.h>
+  #include <sys/syscall.h>
+#else
+  #error "directory_iterator supports Windows and Linux"
+#endif
+
+#define DIRECTORY_ITERATOR_BUFSIZE (64*1024) // bytes of directory entries fetched per system call (linux)
+
+#ifdef DIRECTORY_ITERATOR_STATISTICS
+  #include <atomic>
+  #define DIRECTORY_ITERATOR_COUNT(call) \
+	(filesys::directory_statistics::get().call.fetch_add(1, std::memory_order_relaxed))
+#else
+  #define DIRECTORY_ITERATOR_COUNT(call) ((void)0)
+#endif
 
 namespace filesys{
 
+#ifdef DIRECTORY_ITERATOR_STATISTICS
+/*
+STRUCT directory_statistics
+
+system calls of the iterators (only with DIRECTORY_ITERATOR_STATISTICS, e.g. for directory_benchmark.h)
+-> notice: the macro has to be defined for every translation unit, which includes directory_iterator.h
+*/
+
+	// STRUCT directory_statistics
+struct directory_statistics
+	{   // process wide counters (linux)
+	std::atomic<unsigned long long> opens{0};  // open, close
+	std::atomic<unsigned long long> reads{0};  // getdents64 (directory_index: read of inotify events)
+	std::atomic<unsigned long long> stats{0};  // statx, fstatat, stat, lstat
+
+	static directory_statistics& get()
+		{   // the counters
+		static directory_statistics s;
+		return (s);
+		}
+
+	unsigned long long syscalls() const
+		{   // sum of all counters
+		return (opens.load() + reads.load() + stats.load());
+		}
+	};
+#endif
+
+enum class file_type
+	{   // type of a directory entry
+	none,       // the entry does not exist (anymore)
+	unknown,    // type could not be determined
+	regular,
+	directory,
+	symlink,
+	block,
+	character,
+	fifo,
+	socket
+	};
+
+#ifdef _WIN32
+	// STRUCT Directory_handle
+struct Directory_handle
+	{   // find handle and the find data of the current entry
+	explicit Directory_handle(const wchar_t* pattern)
+		: MyData()
+		, MyHandle(FindFirstFile(pattern, &MyData))
+		{
+		}
+
+	~Directory_handle()
+		{
+		if(MyHandle != INVALID_HANDLE_VALUE)
+			FindClose(MyHandle);
+		}
+
+	Directory_handle(const Directory_handle&) = delete;
+	Directory_handle& operator = (const Directory_handle&) = delete;
+
+	bool Next()
+		{   // find data of the next entry (false: end of directory or error)
+		if(FindNextFile(MyHandle, &MyData) != FALSE)
+			return true;
+		if(GetLastError() != ERROR_NO_MORE_FILES)
+			MyError = static_cast<int>(GetLastError());
+		return false;
+		}
+
+	WIN32_FIND_DATA MyData;
+	HANDLE MyHandle;
+	int MyError = 0; // the listing failed (GetLastError)
+	};
+#else // linux
+	// STRUCT Directory_handle
+struct Directory_handle
+	{   // open directory and the entries of the last getdents64 call
+	explicit Directory_handle(int fd)
+		: MyFd(fd)
+		, MyBuf(DIRECTORY_ITERATOR_BUFSIZE)
+		, MyPos(0)
+		, MyEnd(0)
+		{
+		}
+
+	~Directory_handle()
+		{
+		::close(MyFd);
+		DIRECTORY_ITERATOR_COUNT(opens);
+		}
+
+	Directory_handle(const Directory_handle&) = delete;
+	Directory_handle& operator = (const Directory_handle&) = delete;
+
+	const char* Next(unsigned char* type)
+		{   // name and d_type of the next entry (nullptr: end of directory or error)
+		if(MyPos == MyEnd)
+			{   // buffer consumed: fetch the next batch of entries
+			long n;
+			do  {
+				n = ::syscall(SYS_getdents64, MyFd, MyBuf.data(), MyBuf.size());
+				DIRECTORY_ITERATOR_COUNT(reads);
+				} while(n < 0 && errno == EINTR);
+			if(n < 0)
+				MyError = errno;
+			if(n <= 0)
+				return nullptr;
+			MyPos = 0;
+			MyEnd = static_cast<std::size_t>(n);
+			}
+		// struct linux_dirent64: d_ino (8), d_off (8), d_reclen (2), d_type (1), d_name
+		const char* entry = MyBuf.data() + MyPos;
+		unsigned short reclen;
+		std::memcpy(&reclen, entry + 16, sizeof(reclen));
+		MyPos += reclen;
+		*type = static_cast<unsigned char>(entry[18]);
+		return entry + 19;
+		}
+
+	int MyFd;
+	std::vector<char> MyBuf;
+	std::size_t MyPos; // next entry in MyBuf
+	std::size_t MyEnd; // end of the valid entries
+	int MyError = 0;   // the listing failed (errno of getdents64)
+	};
+#endif
+
+/*
+TEMPLATE CLASS name_arena
+
+storage for the names of many directory entries (see directory_entry::copy_to)
+-> notice: names are stored in blocks, which are kept by clear(). after the first use a
+           walk stores names without allocating
+-> notice: clear() invalidates all entries, whose names were stored in the arena
+*/
+
+	// TEMPLATE CLASS Basic_name_arena
+template<class T>
+	class Basic_name_arena
+	{
+public:
+	typedef T char_type;
+	typedef std::size_t size_type;
+
+	explicit Basic_name_arena(size_type block_size = 16*1024)
+		: MyBlock_size(block_size)
+		, MyBlock(0)
+		, MyUsed(0)
+		{   // construct empty arena
+		}
+
+	Basic_name_arena(const Basic_name_arena&) = delete;
+	Basic_name_arena& operator = (const Basic_name_arena&) = delete;
+
+	const char_type* store(const char_type* s, size_type n)
+		{   // copy s[0, n) and a terminating zero, return the copy
+		if(MyBlocks.empty() || MyUsed + n + 1 > MyBlocks[MyBlock].size())
+			{   // next block
+			if(!MyBlocks.empty())
+				++MyBlock;
+			while(MyBlock < MyBlocks.size() && MyBlocks[MyBlock].size() < n + 1)
+				++MyBlock; // skip blocks, which are too small
+			if(MyBlock >= MyBlocks.size())
+				{
+				MyBlocks.push_back(std::vector<char_type>(n + 1 > MyBlock_size ? n + 1 : MyBlock_size));
+				MyBlock = MyBlocks.size() - 1;
+				}
+			MyUsed = 0;
+			}
+		char_type* p = MyBlocks[MyBlock].data() + MyUsed;
+		std::char_traits<char_type>::copy(p, s, n);
+		p[n] = char_type();
+		MyUsed += n + 1;
+		return (p);
+		}
+
+	void clear()
+		{   // forget all names (keep the memory)
+		MyBlock = 0;
+		MyUsed = 0;
+		}
+
+private:
+	std::vector<std::vector<char_type>> MyBlocks;
+	size_type MyBlock_size;
+	size_type MyBlock; // current block
+	size_type MyUsed;  // used elements of the current block
+	};
+
+/*
+TEMPLATE CLASS directory_entry
+
+name and metadata of a directory entry
+-> notice: windows: all metadata comes with the find data (no extra system call)
+-> notice: linux: the type comes with getdents64 (d_type). size, time and mode are fetched on first
+           use with one statx call relative to the open directory (no path lookup), symlinks are not followed
+-> notice: the entry of an iterator refers to the name in the buffer of the directory (no copy).
+           c_str(), length() and name_view() use it directly, name() copies it into a string once.
+           copies of an entry own their name, copy_to(arena) stores it in an arena
+-> notice: an entry keeps its directory open until it is destroyed (lazy metadata)
+-> notice: an entry can be used like the name string of former versions: size() is the length of
+           the name, == and != compare the name, + concatenates it (dir + *it). the size of the
+           file is file_size(). other string members are reached with name()
+-> usage:   for(auto it=directory_iterator("/home/"); it != directory_iterator(); ++it)
+				if(it->is_regular_file()) total += it->file_size();
+*/
+
+template<class T>
+	class Basic_directory_iterator;
+template<class T>
+	class Basic_index_iterator;
+
+	// TEMPLATE CLASS Basic_directory_entry
+template<class T>
+	class Basic_directory_entry
+	{
+public:
+	typedef T string_type;
+	typedef typename string_type::value_type char_type;
+	typedef typename string_type::size_type size_type;
+	typedef std::chrono::system_clock::time_point time_type;
+
+	Basic_directory_entry()
+		: MyName()
+		, MyView(MyName.c_str())
+		, MyLength(0)
+		, MyType(file_type::none)
+		, MySize(0)
+		, MyTime()
+		, MyAttributes(0)
+		, MyStat(false)
+		{   // construct empty entry
+		}
+
+	Basic_directory_entry(const Basic_directory_entry& o)
+		: MyName(o.MyView, o.MyLength)
+		, MyView(MyName.c_str())
+		, MyLength(o.MyLength)
+		, MyType(o.MyType)
+		, MySize(o.MySize)
+		, MyTime(o.MyTime)
+		, MyAttributes(o.MyAttributes)
+		, MyStat(o.MyStat)
+		, MyDir(o.MyDir)
+		{   // construct by copying (the copy owns its name)
+		}
+
+	Basic_directory_entry(Basic_directory_entry&& o)
+		: MyName()
+		, MyView(MyName.c_str())
+		, MyLength(0)
+		, MyType(file_type::none)
+		, MySize(0)
+		, MyTime()
+		, MyAttributes(0)
+		, MyStat(false)
+		{   // construct by moving
+		*this = std::move(o);
+		}
+
+	Basic_directory_entry& operator = (const Basic_directory_entry& o)
+		{   // assign by copying (the copy owns its name)
+		if(this != &o)
+			{
+			Basic_directory_entry tmp(o);
+			*this = std::move(tmp);
+			}
+		return (*this);
+		}
+
+	Basic_directory_entry& operator = (Basic_directory_entry&& o)
+		{   // assign by moving
+		if(this != &o)
+			{
+			const bool owned = o.Owned();
+			MyName = std::move(o.MyName);
+			MyView = owned ? MyName.c_str() : o.MyView;
+			MyLength = o.MyLength;
+			MyType = o.MyType;
+			MySize = o.MySize;
+			MyTime = o.MyTime;
+			MyAttributes = o.MyAttributes;
+			MyStat = o.MyStat;
+			MyDir = std::move(o.MyDir);
+			o.clear();
+			}
+		return (*this);
+		}
+
+	const string_type& name() const
+		{   // file name (without directory)
+		if(!Owned())
+			{   // first call: copy the name
+			MyName.assign(MyView, MyLength); // reuses the capacity of MyName
+			MyView = MyName.c_str();
+			}
+		return (MyName);
+		}
+
+	const char_type* c_str() const
+		{   // file name as c-string (no copy)
+		return (MyView);
+		}
+
+	size_type length() const
+		{   // length of the file name
+		return (MyLength);
+		}
+
+	size_type size() const
+		{   // length of the file name (as string::size)
+		return (MyLength);
+		}
+
+  #if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+	std::basic_string_view<char_type> name_view() const
+		{   // file name (no copy)
+		return (std::basic_string_view<char_type>(MyView, MyLength));
+		}
+  #endif
+
+	operator const string_type& () const
+		{   // file name
+		return (name());
+		}
+
+	bool empty() const
+		{   // test for the entry of an end-iterator
+		return (MyLength == 0);
+		}
+
+	Basic_directory_entry copy_to(Basic_name_arena<char_type>& arena) const
+		{   // copy, whose name is stored in arena (valid until arena.clear())
+		Basic_directory_entry e;
+		e.MyView = arena.store(MyView, MyLength);
+		e.MyLength = MyLength;
+		e.MyType = MyType;
+		e.MySize = MySize;
+		e.MyTime = MyTime;
+		e.MyAttributes = MyAttributes;
+		e.MyStat = MyStat;
+		e.MyDir = MyDir;
+		return (e);
+		}
+
+	file_type type() const
+		{   // type of the entry (symlinks are not followed)
+		if(MyType == file_type::unknown)
+			Fetch();
+		return (MyType);
+		}
+
+	bool is_directory() const
+		{   // test for a directory
+		return (type() == file_type::directory);
+		}
+
+	bool is_regular_file() const
+		{   // test for a regular file
+		return (type() == file_type::regular);
+		}
+
+	bool is_symlink() const
+		{   // test for a symbolic link
+		return (type() == file_type::symlink);
+		}
+
+	unsigned long long file_size() const
+		{   // size of the file in bytes
+		Fetch();
+		return (MySize);
+		}
+
+	time_type last_write_time() const
+		{   // time of the last modification
+		Fetch();
+		return (MyTime);
+		}
+
+	unsigned long attributes() const
+		{   // windows: file attributes (FILE_ATTRIBUTE_...), linux: st_mode
+		Fetch();
+		return (MyAttributes);
+		}
+
+	friend bool operator == (const Basic_directory_entry& l, const Basic_directory_entry& r)
+		{   // test for equal names
+		return (l.Equal(r.MyView, r.MyLength));
+		}
+
+	friend bool operator == (const Basic_directory_entry& l, const string_type& r)
+		{   // test for equal names
+		return (l.Equal(r.c_str(), r.size()));
+		}
+
+	friend bool operator == (const string_type& l, const Basic_directory_entry& r)
+		{   // test for equal names
+		return (r.Equal(l.c_str(), l.size()));
+		}
+
+	friend bool operator == (const Basic_directory_entry& l, const char_type* r)
+		{   // test for equal names
+		return (l.Equal(r, string_type::traits_type::length(r)));
+		}
+
+	friend bool operator == (const char_type* l, const Basic_directory_entry& r)
+		{   // test for equal names
+		return (r.Equal(l, string_type::traits_type::length(l)));
+		}
+
+	friend bool operator != (const Basic_directory_entry& l, const Basic_directory_entry& r)
+		{   // test for different names
+		return (!(l == r));
+		}
+
+	friend bool operator != (const Basic_directory_entry& l, const string_type& r)
+		{   // test for different names
+		return (!(l == r));
+		}
+
+	friend bool operator != (const string_type& l, const Basic_directory_entry& r)
+		{   // test for different names
+		return (!(l == r));
+		}
+
+	friend bool operator != (const Basic_directory_entry& l, const char_type* r)
+		{   // test for different names
+		return (!(l == r));
+		}
+
+	friend bool operator != (const char_type* l, const Basic_directory_entry& r)
+		{   // test for different names
+		return (!(l == r));
+		}
+
+	friend string_type operator + (const string_type& l, const Basic_directory_entry& r)
+		{   // l followed by the name (e.g. directory + entry)
+		string_type s;
+		s.reserve(l.size() + r.MyLength);
+		s.append(l).append(r.MyView, r.MyLength);
+		return (s);
+		}
+
+	friend string_type operator + (const Basic_directory_entry& l, const string_type& r)
+		{   // the name followed by r
+		string_type s;
+		s.reserve(l.MyLength + r.size());
+		s.append(l.MyView, l.MyLength).append(r);
+		return (s);
+		}
+
+	friend string_type operator + (const Basic_directory_entry& l, const Basic_directory_entry& r)
+		{   // both names
+		string_type s;
+		s.reserve(l.MyLength + r.MyLength);
+		s.append(l.MyView, l.MyLength).append(r.MyView, r.MyLength);
+		return (s);
+		}
+
+	void clear()
+		{   // make empty entry
+		MyName.clear();
+		MyView = MyName.c_str();
+		MyLength = 0;
+		MyType = file_type::none;
+		MySize = 0;
+		MyTime = time_type();
+		MyAttributes = 0;
+		MyStat = false;
+		MyDir.reset();
+		}
+
+private:
+	template<class> friend class Basic_directory_iterator;
+	template<class> friend class Basic_index_iterator;
+
+	bool Owned() const
+		{   // test if the name is stored in MyName
+		return (MyView == MyName.c_str());
+		}
+
+	bool Equal(const char_type* p, size_type n) const
+		{   // compare the name with p[0..n) (no copy)
+		return (MyLength == n && string_type::traits_type::compare(MyView, p, n) == 0);
+		}
+
+	void Share(const Basic_directory_entry& o)
+		{   // copy of an iterator: refer to the same buffer
+		if(o.Owned())
+			*this = o;
+		else
+			{
+			*this = Basic_directory_entry();
+			MyView = o.MyView;
+			MyLength = o.MyLength;
+			MyType = o.MyType;
+			MySize = o.MySize;
+			MyTime = o.MyTime;
+			MyAttributes = o.MyAttributes;
+			MyStat = o.MyStat;
+			MyDir = o.MyDir;
+			}
+		}
+
+	void Own()
+		{   // copy the name out of the buffer of the directory
+		name();
+		}
+
+	void Assign_handle(const std::shared_ptr<Directory_handle>& dir)
+		{   // keep the directory alive (no reference counting while the handle stays the same)
+		if(MyDir != dir)
+			MyDir = dir;
+		}
+
+	void Assign_known(const char_type* name, size_type length, file_type type,
+			unsigned long long size, time_type time, unsigned long attributes)
+		{   // name and metadata of a directory_index (no directory, no statx)
+		MyView = name;
+		MyLength = length;
+		MyType = type;
+		MySize = size;
+		MyTime = time;
+		MyAttributes = attributes;
+		MyStat = true;
+		MyDir.reset();
+		}
+
+#ifdef _WIN32
+	void Assign(const std::shared_ptr<Directory_handle>& dir)
+		{   // take everything from the find data
+		const WIN32_FIND_DATA& data = dir->MyData;
+		MyView = data.cFileName;
+		MyLength = std::char_traits<char_type>::length(data.cFileName);
+		MyAttributes = data.dwFileAttributes;
+		if((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && data.dwReserved0 == IO_REPARSE_TAG_SYMLINK)
+			MyType = file_type::symlink;
+		else if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			MyType = file_type::directory;
+		else
+			MyType = file_type::regular;
+		MySize = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		const unsigned long long t = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32)
+			| data.ftLastWriteTime.dwLowDateTime; // 100 ns since 1601
+		MyTime = time_type(std::chrono::duration_cast<time_type::duration>(
+			std::chrono::nanoseconds((static_cast<long long>(t) - 116444736000000000LL) * 100)));
+		MyStat = true;
+		Assign_handle(dir);
+		}
+#else // linux
+	void Assign(const char* name, unsigned char d_type, const std::shared_ptr<Directory_handle>& dir)
+		{   // name and d_type of getdents64, the rest is fetched on demand
+		MyView = name;
+		MyLength = std::char_traits<char>::length(name);
+		switch(d_type)
+			{
+			case DT_REG: MyType = file_type::regular; break;
+			case DT_DIR: MyType = file_type::directory; break;
+			case DT_LNK: MyType = file_type::symlink; break;
+			case DT_BLK: MyType = file_type::block; break;
+			case DT_CHR: MyType = file_type::character; break;
+			case DT_FIFO: MyType = file_type::fifo; break;
+			case DT_SOCK: MyType = file_type::socket; break;
+			default: MyType = file_type::unknown; break; // e.g. some network filesystems
+			}
+		MySize = 0;
+		MyTime = time_type();
+		MyAttributes = 0;
+		MyStat = false;
+		Assign_handle(dir);
+		}
+#endif
+
+	void Fetch() const
+		{   // load the metadata (once)
+		if(MyStat || MyLength == 0)
+			return;
+		MyStat = true;
+  #ifndef _WIN32
+		DIRECTORY_ITERATOR_COUNT(stats);
+	#ifdef STATX_BASIC_STATS
+		struct statx st;
+		if(::statx(MyDir->MyFd, MyView, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+				STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &st) != 0)
+			{   // removed in the meantime
+			MyType = file_type::none;
+			return;
+			}
+		const unsigned long mode = st.stx_mode;
+		MySize = st.stx_size;
+		MyTime = Time(st.stx_mtime.tv_sec, st.stx_mtime.tv_nsec);
+	#else
+		struct stat st;
+		if(::fstatat(MyDir->MyFd, MyView, &st, AT_SYMLINK_NOFOLLOW) != 0)
+			{   // removed in the meantime
+			MyType = file_type::none;
+			return;
+			}
+		const unsigned long mode = st.st_mode;
+		MySize = static_cast<unsigned long long>(st.st_size);
+		MyTime = Time(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	#endif
+		MyAttributes = mode;
+		if(MyType == file_type::unknown)
+			{   // d_type was not available
+			if(S_ISREG(mode)) MyType = file_type::regular;
+			else if(S_ISDIR(mode)) MyType = file_type::directory;
+			else if(S_ISLNK(mode)) MyType = file_type::symlink;
+			else if(S_ISBLK(mode)) MyType = file_type::block;
+			else if(S_ISCHR(mode)) MyType = file_type::character;
+			else if(S_ISFIFO(mode)) MyType = file_type::fifo;
+			else if(S_ISSOCK(mode)) MyType = file_type::socket;
+			}
+  #endif
+		}
+
+  #ifndef _WIN32
+	static time_type Time(long long sec, long long nsec)
+		{   // time point of a unix timestamp
+		return time_type(std::chrono::duration_cast<time_type::duration>(
+			std::chrono::seconds(sec) + std::chrono::nanoseconds(nsec)));
+		}
+  #endif
+
+	mutable string_type MyName;       // copied name (see name())
+	mutable const char_type* MyView;  // name: in the buffer of the directory, an arena or MyName
+	size_type MyLength;
+	mutable file_type MyType;
+	mutable unsigned long long MySize;
+	mutable time_type MyTime;
+	mutable unsigned long MyAttributes;
+	mutable bool MyStat; // metadata loaded
+	std::shared_ptr<Directory_handle> MyDir; // keeps the buffer alive (linux: statx relative to the directory)
+	};
+
+	typedef Basic_directory_entry<std::basic_string<wchar_t>> wdirectory_entry;
+	typedef Basic_directory_entry<std::basic_string<char>> directory_entry;
+	typedef Basic_name_arena<wchar_t> wname_arena;
+	typedef Basic_name_arena<char> name_arena;
+
+/*
+TEMPLATE CLASS directory_filter
+
+selects directory entries: compiled once, evaluated by the iterator before the entry is handed out
+-> notice: an entry matches if its name matches one of the glob patterns or has one of the
+           extensions (if any are given), and its type, size and time are within the ranges
+-> notice: name criteria are checked first, size and time need metadata (linux: one statx per
+           entry, which passed the name and type criteria)
+-> notice: globs: '*' any sequence, '?' one character, [abc], [a-z], [!a-z]. with ignore_case
+           ASCII letters are compared case insensitive (default: windows)
+-> usage:   directory_filter f;
+			f.add_glob("*.log").add_extension("gz").set_size(1024, 1 << 20);
+			for(auto it=directory_iterator("/var/log/", f); it != directory_iterator(); ++it) ...
+*/
+
+	// TEMPLATE CLASS Basic_directory_filter
+template<class T>
+	class Basic_directory_filter
+	{
+public:
+	typedef T string_type;
+	typedef typename string_type::value_type char_type;
+	typedef typename string_type::size_type size_type;
+	typedef Basic_directory_entry<T> entry_type;
+	typedef typename entry_type::time_type time_type;
+
+  #ifdef _WIN32
+	explicit Basic_directory_filter(bool ignore_case = true)
+  #else
+	explicit Basic_directory_filter(bool ignore_case = false)
+  #endif
+		: MyIgnore_case(ignore_case)
+		, MyExtensions(0)
+		, MyTypes(0)
+		, MyMin_size(0)
+		, MyMax_size(~0ULL)
+		, MyMin_time(time_type::min())
+		, MyMax_time(time_type::max())
+		, MyStat(false)
+		{   // construct filter, which accepts everything
+		}
+
+	Basic_directory_filter& add_glob(const string_type& pattern)
+		{   // accept names which match pattern
+		MyGlobs.push_back(Compile(pattern));
+		return (*this);
+		}
+
+	Basic_directory_filter& add_extension(string_type ext)
+		{   // accept names with extension ext ("log" or ".log")
+		if(!ext.empty() && ext[0] == char_type('.'))
+			ext.erase(0, 1);
+		if(ext.empty())
+			return (*this);
+		for(auto& c : ext)
+			c = Fold(c);
+		if(2*(MyExtensions + 1) > MyTable.size())
+			Rehash(MyTable.empty() ? 16 : 2*MyTable.size());
+		if(Insert(MyTable, std::move(ext)))
+			++MyExtensions;
+		return (*this);
+		}
+
+	Basic_directory_filter& add_type(file_type type)
+		{   // accept entries of type (default: all types)
+		MyTypes |= 1u << static_cast<unsigned>(type);
+		return (*this);
+		}
+
+	Basic_directory_filter& set_size(unsigned long long min_size, unsigned long long max_size = ~0ULL)
+		{   // accept sizes in [min_size, max_size]
+		MyMin_size = min_size;
+		MyMax_size = max_size;
+		MyStat = true;
+		return (*this);
+		}
+
+	Basic_directory_filter& set_time(time_type min_time, time_type max_time = time_type::max())
+		{   // accept last write times in [min_time, max_time]
+		MyMin_time = min_time;
+		MyMax_time = max_time;
+		MyStat = true;
+		return (*this);
+		}
+
+	bool match(const entry_type& e) const
+		{   // test entry e
+		if((!MyGlobs.empty() || MyExtensions > 0) && !Match_name(e.c_str(), e.length()))
+			return false;
+		if(MyTypes != 0 && !(MyTypes & (1u << static_cast<unsigned>(e.type()))))
+			return false;
+		if(!MyStat)
+			return true;
+		const unsigned long long size = e.file_size();
+		const time_type time = e.last_write_time();
+		return (MyMin_size <= size && size <= MyMax_size && MyMin_time <= time && time <= MyMax_time);
+		}
+
+private:
+	enum Op_kind { Literal, Any, Star, Class };
+
+	struct Op
+		{   // element of a compiled glob
+		Op_kind kind;
+		char_type ch;          // Literal: folded character
+		bool negate;           // Class: [!...]
+		std::vector<std::pair<char_type, char_type>> ranges; // Class: folded ranges
+		};
+
+	typedef std::vector<Op> Glob;
+
+	Glob Compile(const string_type& pattern) const
+		{   // translate pattern into ops
+		Glob g;
+		for(size_type i=0; i<pattern.size(); ++i)
+			{
+			Op op = {Literal, Fold(pattern[i]), false, {}};
+			if(pattern[i] == char_type('*'))
+				{
+				if(!g.empty() && g.back().kind == Star)
+					continue; // "**" == "*"
+				op.kind = Star;
+				}
+			else if(pattern[i] == char_type('?'))
+				op.kind = Any;
+			else if(pattern[i] == char_type('['))
+				{   // class: find the closing bracket
+				size_type j = i + 1;
+				if(j < pattern.size() && (pattern[j] == char_type('!') || pattern[j] == char_type('^')))
+					++j;
+				if(j < pattern.size() && pattern[j] == char_type(']'))
+					++j; // "[]...]": ']' is a member
+				while(j < pattern.size() && pattern[j] != char_type(']'))
+					++j;
+				if(j < pattern.size())
+					{   // valid class [i, j]
+					op.kind = Class;
+					size_type k = i + 1;
+					if(pattern[k] == char_type('!') || pattern[k] == char_type('^'))
+						{
+						op.negate = true;
+						++k;
+						}
+					while(k < j)
+						{
+						char_type lo = pattern[k];
+						char_type hi = lo;
+						if(k + 2 < j && pattern[k+1] == char_type('-'))
+							{
+							hi = pattern[k+2];
+							k += 3;
+							}
+						else
+							++k;
+						op.ranges.push_back(std::make_pair(Fold(lo), Fold(hi)));
+						if(MyIgnore_case)
+							op.ranges.push_back(std::make_pair(lo, hi)); // e.g. [A-Z]
+						}
+					i = j;
+					}
+				// else: a literal '['
+				}
+			g.push_back(std::move(op));
+			}
+		return (g);
+		}
+
+	bool Match_name(const char_type* name, size_type n) const
+		{   // name matches a glob or has an extension of the table
+		for(auto& g : MyGlobs)
+			if(Match_glob(g, name, n))
+				return true;
+		if(MyExtensions == 0)
+			return false;
+		size_type dot = n;
+		while(dot > 0 && name[dot-1] != char_type('.'))
+			--dot;
+		if(dot == 0 || dot == n)
+			return false; // no extension
+		return Find(name + dot, n - dot);
+		}
+
+	bool Match_glob(const Glob& g, const char_type* name, size_type n) const
+		{   // iterative matching with one backtracking point (the last star)
+		size_type p = 0, i = 0;
+		size_type star = g.size(), mark = 0;
+		while(i < n)
+			{
+			if(p < g.size() && g[p].kind != Star && Match_op(g[p], Fold(name[i])))
+				{
+				++p;
+				++i;
+				}
+			else if(p < g.size() && g[p].kind == Star)
+				{
+				star = p++;
+				mark = i;
+				}
+			else if(star < g.size())
+				{   // let the star take one more character
+				p = star + 1;
+				i = ++mark;
+				}
+			else
+				return false;
+			}
+		while(p < g.size() && g[p].kind == Star)
+			++p;
+		return (p == g.size());
+		}
+
+	static bool Match_op(const Op& op, char_type c)
+		{   // test one character
+		if(op.kind == Literal)
+			return (op.ch == c);
+		if(op.kind == Any)
+			return true;
+		bool in = false;
+		for(auto& r : op.ranges)
+			if(r.first <= c && c <= r.second)
+				{
+				in = true;
+				break;
+				}
+		return (in != op.negate);
+		}
+
+	char_type Fold(char_type c) const
+		{   // ASCII lower case (ignore_case)
+		if(MyIgnore_case && char_type('A') <= c && c <= char_type('Z'))
+			return static_cast<char_type>(c - char_type('A') + char_type('a'));
+		return (c);
+		}
+
+	std::size_t Hash(const char_type* s, size_type n) const
+		{   // FNV-1a of the folded characters
+		std::size_t h = 2166136261u;
+		for(size_type i=0; i<n; ++i)
+			h = (h ^ static_cast<std::size_t>(Fold(s[i]))) * 16777619u;
+		return (h);
+		}
+
+	bool Find(const char_type* s, size_type n) const
+		{   // test if extension s[0, n) is in the table (no allocation)
+		const std::size_t mask = MyTable.size() - 1;
+		for(std::size_t i = Hash(s, n) & mask; !MyTable[i].empty(); i = (i + 1) & mask)
+			{
+			const string_type& ext = MyTable[i];
+			if(ext.size() != n)
+				continue;
+			size_type k = 0;
+			while(k < n && ext[k] == Fold(s[k]))
+				++k;
+			if(k == n)
+				return true;
+			}
+		return false;
+		}
+
+	bool Insert(std::vector<string_type>& table, string_type&& ext) const
+		{   // add ext (folded) to an open addressing table (false: already there)
+		const std::size_t mask = table.size() - 1;
+		std::size_t i = Hash(ext.data(), ext.size()) & mask;
+		for(; !table[i].empty(); i = (i + 1) & mask)
+			if(table[i] == ext)
+				return false;
+		table[i] = std::move(ext);
+		return true;
+		}
+
+	void Rehash(std::size_t size)
+		{   // grow the table (size: power of two)
+		std::vector<string_type> table(size);
+		for(auto& ext : MyTable)
+			if(!ext.empty())
+				Insert(table, std::move(ext));
+		MyTable.swap(table);
+		}
+
+	bool MyIgnore_case;
+	std::vector<Glob> MyGlobs;
+	std::vector<string_type> MyTable; // extensions (open addressing, empty: free slot)
+	std::size_t MyExtensions;         // number of extensions in MyTable
+	unsigned MyTypes;                 // bit mask of accepted types (0: all)
+	unsigned long long MyMin_size;
+	unsigned long long MyMax_size;
+	time_type MyMin_time;
+	time_type MyMax_time;
+	bool MyStat; // size or time are checked
+	};
+
+	typedef Basic_directory_filter<std::basic_string<wchar_t>> wdirectory_filter;
+	typedef Basic_directory_filter<std::basic_string<char>> directory_filter;
+
 /*
 TEMPLATE CLASS directory_iterator
 
-PLATFORM: Windows (filesystem: wchar_t)
+PLATFORM: Windows (filesystem: wchar_t), Linux (filesystem: char)
 
 iterate through all files in a directory
 -> notice: the current version of the directory_iterator does not support backward iteration
+-> notice: linux reads the entries in bulk (getdents64 into a 64 KiB buffer, shared by copies of the iterator)
+-> notice: the iterator yields a directory_entry (name, type, size, time; see above). the hot loop
+           does not allocate: the entry refers to the buffer of the directory
+-> notice: copies of an iterator share the directory (input iterator): advancing one invalidates the
+           entries of the others. iterators are equal if both are end-iterators or share the directory
+-> notice: with a directory_filter only matching entries are handed out (the filter is not copied,
+           it has to outlive the iterator)
+-> notice: a directory which cannot be opened gives an end-iterator at once, a failing read ends the
+           listing early. error() of the end-iterator tells both apart from the end of the directory
 -> usage:   for(auto it=directory_iterator(L"C:/"); it != directory_iterator(); ++it)
 				std::wcout << it->c_str() << std::endl;
--> TODO: functions: 'equals()' and 'swap()'; optimize the comparison operator
+			for(auto it=directory_iterator("/home/"); it != directory_iterator(); ++it)
+				std::cout << it->c_str() << " " << it->file_size() << std::endl;
 */
 
 	// TEMPLATE CLASS Basic_directory_iterator
@@ -35,13 +1015,14 @@ template<class T>
 	{
 public:
 	typedef std::input_iterator_tag iterator_category;
-	typedef T value_type;
+	typedef Basic_directory_entry<T> value_type;
 	typedef std::ptrdiff_t		 difference_type;
 	typedef value_type*			 pointer;
 	typedef value_type&			 reference;
 	typedef const value_type* 	 const_pointer;
 	typedef const value_type&    const_reference;
-	typedef typename value_type::size_type	 size_type;
+	typedef typename T::size_type	 size_type;
+	typedef Basic_directory_filter<T> filter_type;
 
 	//static Basic_directory_iterator end()
 	//	{   // get end-iterator
@@ -50,36 +1031,92 @@ public:
 
 	~Basic_directory_iterator()
 		{   // destruct
-		Clear();
 		}
 
 	Basic_directory_iterator()
-		: MyFind_data()
-		, MyHfile()
+		: MyHfile()
 		, MyCurrent()
+		, MyFilter(nullptr)
+		, MyError(0)
 		{   // end-iterator
 		}
 
 	Basic_directory_iterator(const Basic_directory_iterator& o)
-		: MyFind_data(o.MyFind_data)
-		, MyHfile(o.MyHfile)
-		, MyCurrent(o.MyCurrent)
-		{
+		: MyHfile(o.MyHfile)
+		, MyCurrent()
+		, MyFilter(o.MyFilter)
+		, MyError(o.MyError)
+		{   // construct by copying (shares the directory)
+		MyCurrent.Share(o.MyCurrent);
 		}
 
 	Basic_directory_iterator(Basic_directory_iterator&& o)
-		: MyFind_data(o.MyFind_data)
-		, MyHfile(o.MyHfile)
-		, MyCurrent(o.MyCurrent)
-		{
-		o.clear();
+		: MyHfile(std::move(o.MyHfile))
+		, MyCurrent(std::move(o.MyCurrent))
+		, MyFilter(o.MyFilter)
+		, MyError(o.MyError)
+		{   // construct by moving
+		o.Clear();
 		}
 
-	Basic_directory_iterator(const value_type& p)
-		: MyFind_data()
-		, MyHfile( FindFirstFile( (p+L"*").c_str() , &MyFind_data ), &FindClose )
-		, MyCurrent(value_type(MyHfile.get() != INVALID_HANDLE_VALUE? MyFind_data.cFileName: TEXT("") ))
+#ifdef _WIN32
+	Basic_directory_iterator(const T& p, const filter_type* filter = nullptr)
+		: MyHfile(std::make_shared<Directory_handle>((p+L"*").c_str()))
+		, MyCurrent()
+		, MyFilter(filter)
+		, MyError(0)
 		{   // construct from specified value
+		if(MyHfile->MyHandle == INVALID_HANDLE_VALUE)
+			{
+			MyError = static_cast<int>(GetLastError());
+			Clear();
+			}
+		else
+			{
+			MyCurrent.Assign(MyHfile);
+			if(MyFilter && !MyFilter->match(MyCurrent))
+				Forward();
+			}
+		}
+#else // linux
+	Basic_directory_iterator(const T& p, const filter_type* filter = nullptr)
+		: MyHfile()
+		, MyCurrent()
+		, MyFilter(filter)
+		, MyError(0)
+		{   // construct from specified value
+		const int fd = ::open(p.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		DIRECTORY_ITERATOR_COUNT(opens);
+		if(fd < 0)
+			{
+			MyError = errno;
+			return; // end-iterator
+			}
+		MyHfile = std::make_shared<Directory_handle>(fd);
+		Forward();
+		}
+#endif
+
+	Basic_directory_iterator(const T& p, const filter_type& filter)
+		: Basic_directory_iterator(p, &filter)
+		{   // construct from specified value, hand out the entries which match filter
+		}
+
+	Basic_directory_iterator& operator = (const Basic_directory_iterator& o)
+		{   // assign by copying
+		Basic_directory_iterator tmp(o);
+		swap(tmp);
+		return (*this);
+		}
+
+	Basic_directory_iterator& operator = (Basic_directory_iterator&& o)
+		{   // assign by moving
+		if(this != &o)
+			{
+			Clear();
+			swap(o);
+			}
+		return (*this);
 		}
 
 	Basic_directory_iterator& operator ++ ()
@@ -91,6 +1128,7 @@ public:
 	Basic_directory_iterator operator ++(int)
 		{   // increment
 		Basic_directory_iterator tmp = *this;
+		tmp.MyCurrent.Own(); // *it++ stays valid
 		Forward();
 		return tmp;
 		}
@@ -113,53 +1151,74 @@ public:
 	#endif
 
 	const value_type& operator * () const
-		{   // reference to the current filepath
+		{   // reference to the current entry
 		return (MyCurrent);
 		}
 
 	const value_type* operator ->() const
-		{   // pointer to the current filepath
+		{   // pointer to the current entry
 		return (&MyCurrent);
 		}
 
 	value_type get() const
-		{   // copy the current filepath
+		{   // copy the current entry (owns its name)
 		return (MyCurrent);
 		}
 
+	int error() const
+		{   // 0, or why the listing ended (open or read failed; windows: GetLastError, linux: errno)
+		return (MyError);
+		}
+
 	void swap(Basic_directory_iterator& o)
 		{   // exchange internals
-		std::swap(MyFind_data, o.MyFind_data);
 		std::swap(MyHfile, o.MyHfile);
 		std::swap(MyCurrent, o.MyCurrent);
+		std::swap(MyFilter, o.MyFilter);
+		std::swap(MyError, o.MyError);
 		}
 
 	bool equals(const Basic_directory_iterator& o) const
-		{   // test for equality
-		return (MyCurrent == o.MyCurrent); // unsafe (two different iterators pointing to one file)
+		{   // test for equality (end-iterators have no directory, copies share it)
+		return (MyHfile == o.MyHfile);
 		}
 
 private:
 	void Forward()
 		{   // step Forward to the next file
-		if(FindNextFile(MyHfile.get(), &MyFind_data))
-			MyCurrent.assign(value_type(MyFind_data.cFileName));
-		else
-			MyCurrent.clear();
+		for(;;)
+			{   // skip the entries, which do not match the filter
+  #ifdef _WIN32
+			if(!MyHfile || !MyHfile->Next())
+				break;
+			MyCurrent.Assign(MyHfile);
+  #else
+			unsigned char type = DT_UNKNOWN;
+			const char* name = MyHfile ? MyHfile->Next(&type) : nullptr;
+			if(name == nullptr)
+				break;
+			MyCurrent.Assign(name, type, MyHfile);
+  #endif
+			if(!MyFilter || MyFilter->match(MyCurrent))
+				return;
+			}
+		if(MyHfile)
+			MyError = MyHfile->MyError;
+		Clear();
 		}
 
 	void Clear()
 		{   // make end-iterator
-		MyFind_data = WIN32_FIND_DATA();
 		MyHfile = shared_handle();
 		MyCurrent.clear();
 		}
 
-	typedef std::shared_ptr< std::remove_pointer< HANDLE >::type > shared_handle;
+	typedef std::shared_ptr<Directory_handle> shared_handle;
 
-	WIN32_FIND_DATA MyFind_data;
 	shared_handle MyHfile;
-	value_type MyCurrent; // MyCurrent filepath
+	value_type MyCurrent; // current entry
+	const filter_type* MyFilter; // not owned (nullptr: all entries)
+	int MyError; // the listing failed (end-iterator)
 	};
 
 
@@ -182,7 +1241,12 @@ template<class T>
 	}
 
 
+#ifdef _WIN32
 	typedef Basic_directory_iterator<std::basic_string<wchar_t>>
 		directory_iterator;
+#else
+	typedef Basic_directory_iterator<std::basic_string<char>>
+		directory_iterator;
+#endif
 
 };//end: namespace
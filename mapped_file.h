@@ -0,0 +1,197 @@
+// mapped_file.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	mapped_file
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+namespace filesys{
+
+/*
+CLASS mapped_file
+
+PLATFORM: Windows (filesystem: wchar_t), POSIX (filesystem: char)
+
+map a whole file into the address space of the process
+-> notice: the size of the file is fixed while it is mapped
+-> notice: if the file cannot be opened or mapped, is_open() returns false
+-> usage:   mapped_file f("data.bin", true);
+			if(f.is_open()) f.data()[0] = 0;
+*/
+
+	// CLASS mapped_file
+class mapped_file
+	{
+public:
+  #ifdef _WIN32
+	typedef wchar_t char_type;
+  #else
+	typedef char char_type;
+  #endif
+	typedef unsigned char value_type;
+	typedef std::size_t size_type;
+
+	mapped_file()
+		: MyData(nullptr)
+		, MySize(0)
+		{   // construct unmapped file
+		}
+
+	explicit mapped_file(const char_type* path, bool writable = false)
+		: MyData(nullptr)
+		, MySize(0)
+		{   // construct from path (map the whole file)
+		Open(path, writable);
+		}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator = (const mapped_file&) = delete;
+
+	mapped_file(mapped_file&& o)
+		: MyData(o.MyData)
+		, MySize(o.MySize)
+		{   // construct by moving
+		o.MyData = nullptr;
+		o.MySize = 0;
+		}
+
+	mapped_file& operator = (mapped_file&& o)
+		{   // assign by moving
+		if(this != &o)
+			{
+			Close();
+			std::swap(MyData, o.MyData);
+			std::swap(MySize, o.MySize);
+			}
+		return (*this);
+		}
+
+	~mapped_file()
+		{   // destruct
+		Close();
+		}
+
+	bool is_open() const
+		{   // test if the file is mapped
+		return (MyData != nullptr);
+		}
+
+	value_type* data()
+		{   // pointer to the first byte of the file
+		return (MyData);
+		}
+
+	const value_type* data() const
+		{   // pointer to the first byte of the file
+		return (MyData);
+		}
+
+	size_type size() const
+		{   // size of the file in bytes
+		return (MySize);
+		}
+
+	bool flush(size_type offset, size_type num)
+		{   // write modified pages in [offset, offset+num) back to the file
+		if(!is_open() || offset > MySize)
+			return false;
+		if(num > MySize - offset)
+			num = MySize - offset;
+  #ifdef _WIN32
+		return (FlushViewOfFile(MyData + offset, num) != FALSE);
+  #else
+		const size_type page = static_cast<size_type>(sysconf(_SC_PAGESIZE));
+		const size_type first = offset - offset % page; // msync requires page alignment
+		return (msync(MyData + first, num + (offset - first), MS_SYNC) == 0);
+  #endif
+		}
+
+	bool flush()
+		{   // write all modified pages back to the file
+		return flush(0, MySize);
+		}
+
+private:
+	void Open(const char_type* path, bool writable)
+		{   // map the file
+  #ifdef _WIN32
+		HANDLE file = CreateFileW(path,
+			writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER size;
+		if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			{
+			HANDLE mapping = CreateFileMappingW(file, NULL,
+				writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+			if(mapping != NULL)
+				{
+				void* p = MapViewOfFile(mapping,
+					writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+				if(p != NULL)
+					{
+					MyData = static_cast<value_type*>(p);
+					MySize = static_cast<size_type>(size.QuadPart);
+					}
+				CloseHandle(mapping); // the view keeps the mapping alive
+				}
+			}
+		CloseHandle(file);
+  #else
+		int fd = ::open(path, writable ? O_RDWR : O_RDONLY);
+		if(fd < 0)
+			return;
+		struct stat st;
+		if(fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+			void* p = mmap(nullptr, static_cast<size_type>(st.st_size),
+				writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+			if(p != MAP_FAILED)
+				{
+				MyData = static_cast<value_type*>(p);
+				MySize = static_cast<size_type>(st.st_size);
+				}
+			}
+		::close(fd); // the mapping keeps the file alive
+  #endif
+		}
+
+	void Close()
+		{   // unmap the file
+		if(MyData != nullptr)
+			{
+  #ifdef _WIN32
+			UnmapViewOfFile(MyData);
+  #else
+			munmap(MyData, MySize);
+  #endif
+			}
+		MyData = nullptr;
+		MySize = 0;
+		}
+
+	value_type* MyData;
+	size_type MySize;
+	};
+
+};//end: namespace
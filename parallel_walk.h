@@ -0,0 +1,395 @@
+// parallel_walk.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+structs:
+	walk_options
+	walk_batch
+	walk_result
+
+functions:
+	template<class Visitor>
+	walk_result parallel_walk(const path_type& root, Visitor visitor,
+		const walk_options& options = walk_options())
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <chrono>
+
+#include "directory_iterator.h"
+
+#ifndef _WIN32
+  #include <set>
+  #include <utility>
+  #include <sys/stat.h>
+#endif
+
+#define PARALLEL_WALK_BATCH_SIZE 256 // default number of entries per call of the visitor
+
+namespace filesys{
+
+/*
+STRUCT walk_options
+
+parameters of parallel_walk
+-> notice: prune is called for every subdirectory (true: do not descend), from several threads at once
+-> notice: filter only selects the entries of the batches, the walk descends into all subdirectories
+-> notice: followed symlinks are only entered once (linux: device and inode), windows relies on max_depth
+*/
+
+	// TEMPLATE STRUCT Basic_walk_options
+template<class T>
+	struct Basic_walk_options
+	{   // parameters of parallel_walk
+	typedef T path_type;
+	typedef Basic_directory_entry<T> entry_type;
+
+	unsigned threads = 0;            // worker threads (0: std::thread::hardware_concurrency)
+	int max_depth = -1;              // deepest level which is listed (root: 0, -1: unlimited)
+	bool follow_symlinks = false;    // descend into symlinks to directories (each directory is listed once)
+	std::size_t batch_size = PARALLEL_WALK_BATCH_SIZE; // entries per call of the visitor
+	std::function<bool(const path_type& path, const entry_type& entry)> prune; // skip subtree (optional)
+	const Basic_directory_filter<T>* filter = nullptr; // entries passed to the visitor (optional, not owned)
+	};
+
+/*
+STRUCT walk_batch
+
+entries of one directory, passed to the visitor
+-> notice: the visitor is called by several threads at once, the batch is only valid during the call
+           (the names are stored in an arena of the thread, copy an entry to keep it)
+-> notice: directory ends with a slash, the path of an entry is directory + entry.name()
+*/
+
+	// TEMPLATE STRUCT Basic_walk_batch
+template<class T>
+	struct Basic_walk_batch
+	{   // entries of one directory
+	typedef T path_type;
+	typedef Basic_directory_entry<T> entry_type;
+
+	const path_type& directory;        // path of the directory (with trailing slash)
+	int depth;                         // level of the directory (root: 0)
+	unsigned thread;                   // index of the worker thread
+	const std::vector<entry_type>& entries;
+	};
+
+	// STRUCT walk_result
+struct walk_result
+	{   // statistics of a walk
+	unsigned long long directories = 0; // directories listed
+	unsigned long long entries = 0;     // entries passed to the visitor
+	unsigned long long errors = 0;      // directories which could not be opened
+	unsigned long long steals = 0;      // directories taken from the queue of another thread
+	};
+
+/*
+TEMPLATE FUNCTION parallel_walk
+
+list a directory tree with a pool of threads. every thread owns a queue of directories: it takes
+its own work from the back (depth first, good locality), idle threads steal from the front of
+other queues (large subtrees). the entries of each directory are passed to the visitor in batches
+-> notice: the entries "." and ".." are skipped
+-> notice: an exception of the visitor stops the walk, it is rethrown by parallel_walk
+-> usage:   std::atomic<unsigned long long> bytes(0);
+			parallel_walk("/data/", [&](const walk_batch& b){
+				for(auto& e : b.entries)
+					if(e.is_regular_file()) bytes += e.file_size();
+				});
+*/
+
+	// TEMPLATE CLASS Parallel_walker
+template<class T, class Visitor>
+	class Parallel_walker
+	{
+public:
+	typedef T path_type;
+	typedef typename path_type::value_type char_type;
+	typedef Basic_directory_entry<T> entry_type;
+	typedef Basic_directory_iterator<T> iterator_type;
+	typedef Basic_walk_options<T> options_type;
+	typedef Basic_walk_batch<T> batch_type;
+
+	Parallel_walker(Visitor& visitor, const options_type& options)
+		: MyVisitor(visitor)
+		, MyOptions(options)
+		, MyWorkers(Num_threads(options.threads))
+		{
+		}
+
+	walk_result Run(path_type root)
+		{   // walk the tree below root
+		if(root.empty() || (root.back() != char_type('/') && root.back() != char_type('\\')))
+			root.push_back(char_type('/'));
+		Push(0, Task{root, 0});
+
+		std::vector<std::thread> threads;
+		for(unsigned i=1; i<MyWorkers.size(); ++i)
+			threads.push_back(std::thread(&Parallel_walker::Work, this, i));
+		Work(0); // the calling thread works, too
+		for(auto& t : threads)
+			t.join();
+
+		if(MyError)
+			std::rethrow_exception(MyError);
+		walk_result r;
+		for(auto& w : MyWorkers)
+			{
+			r.directories += w.MyResult.directories;
+			r.entries += w.MyResult.entries;
+			r.errors += w.MyResult.errors;
+			r.steals += w.MyResult.steals;
+			}
+		return r;
+		}
+
+private:
+	struct Task
+		{   // directory to list
+		path_type path;
+		int depth;
+		};
+
+	struct Worker
+		{   // queue and statistics of one thread
+		std::mutex MyMutex; // guards MyQueue
+		std::deque<Task> MyQueue;
+		walk_result MyResult;
+		Basic_name_arena<char_type> MyArena; // names of the current batch
+		};
+
+	static unsigned Num_threads(unsigned n)
+		{   // number of workers
+		if(n == 0)
+			n = std::thread::hardware_concurrency();
+		return (n > 0 ? n : 1);
+		}
+
+	void Push(unsigned self, Task&& t)
+		{   // queue a directory at the back of the own queue
+		MyPending.fetch_add(1);
+			{
+			std::lock_guard<std::mutex> l(MyWorkers[self].MyMutex);
+			MyWorkers[self].MyQueue.push_back(std::move(t));
+			}
+		if(MyIdle.load() > 0)
+			{   // wake a sleeping thread
+			std::lock_guard<std::mutex> l(MyIdle_mutex);
+			MyIdle_cv.notify_one();
+			}
+		}
+
+	bool Pop(unsigned self, Task& t)
+		{   // take own work (back) or steal (front of another queue)
+			{
+			Worker& w = MyWorkers[self];
+			std::lock_guard<std::mutex> l(w.MyMutex);
+			if(!w.MyQueue.empty())
+				{
+				t = std::move(w.MyQueue.back());
+				w.MyQueue.pop_back();
+				return true;
+				}
+			}
+		const std::size_t n = MyWorkers.size();
+		for(std::size_t k=1; k<n; ++k)
+			{   // victims in round robin order, starting at the neighbour
+			Worker& v = MyWorkers[(self + k) % n];
+			std::lock_guard<std::mutex> l(v.MyMutex);
+			if(!v.MyQueue.empty())
+				{
+				t = std::move(v.MyQueue.front());
+				v.MyQueue.pop_front();
+				++MyWorkers[self].MyResult.steals;
+				return true;
+				}
+			}
+		return false;
+		}
+
+	void Work(unsigned self)
+		{   // worker thread: list directories until the tree is done
+		std::vector<entry_type> batch;
+		batch.reserve(MyOptions.batch_size);
+		Task t;
+		while(!MyStop.load())
+			{
+			if(Pop(self, t))
+				{
+				try {
+					List(self, t, batch);
+				}catch(...){
+					std::lock_guard<std::mutex> l(MyIdle_mutex);
+					if(!MyError)
+						MyError = std::current_exception();
+					MyStop.store(true);
+				}
+				if(MyPending.fetch_sub(1) == 1)
+					{   // that was the last directory
+					std::lock_guard<std::mutex> l(MyIdle_mutex);
+					MyIdle_cv.notify_all();
+					}
+				continue;
+				}
+			if(MyPending.load() == 0)
+				break;
+			std::unique_lock<std::mutex> l(MyIdle_mutex);
+			MyIdle.fetch_add(1);
+			MyIdle_cv.wait_for(l, std::chrono::milliseconds(1)); // timeout: no lost wake ups
+			MyIdle.fetch_sub(1);
+			}
+		std::lock_guard<std::mutex> l(MyIdle_mutex);
+		MyIdle_cv.notify_all(); // stop: let the others see it
+		}
+
+	void List(unsigned self, const Task& t, std::vector<entry_type>& batch)
+		{   // pass the entries of directory t to the visitor, queue the subdirectories
+		walk_result& r = MyWorkers[self].MyResult;
+  #ifndef _WIN32
+		if(MyOptions.follow_symlinks && !Claim(t.path))
+			return; // listed before (reached through a symlink and directly, or a loop)
+  #endif
+		iterator_type it(t.path);
+		if(it == iterator_type())
+			{   // not even "." and "..": the directory could not be opened
+			++r.errors;
+			return;
+			}
+		++r.directories;
+		const bool descend = MyOptions.max_depth < 0 || t.depth < MyOptions.max_depth;
+		batch.clear();
+		for(; it != iterator_type() && !MyStop.load(); ++it)
+			{
+			const entry_type& e = *it;
+			if(Is_dot(e))
+				continue;
+			if(descend && Enter(t.path, e))
+				Push(self, Task{Join(t.path, e) + char_type('/'), t.depth + 1});
+			if(MyOptions.filter && !MyOptions.filter->match(e))
+				continue;
+			batch.push_back(e.copy_to(MyWorkers[self].MyArena)); // no allocation
+			if(batch.size() >= MyOptions.batch_size)
+				Deliver(self, t, batch);
+			}
+		if(!batch.empty())
+			Deliver(self, t, batch);
+		}
+
+	void Deliver(unsigned self, const Task& t, std::vector<entry_type>& batch)
+		{   // call the visitor
+		const batch_type b = {t.path, t.depth, self, batch};
+		MyVisitor(b);
+		MyWorkers[self].MyResult.entries += batch.size();
+		batch.clear();
+		MyWorkers[self].MyArena.clear();
+		}
+
+	bool Enter(const path_type& dir, const entry_type& e)
+		{   // test if the walk descends into e
+		const file_type type = e.type();
+		if(type != file_type::directory && !(type == file_type::symlink && MyOptions.follow_symlinks))
+			return false;
+		if(MyOptions.prune && MyOptions.prune(Join(dir, e), e))
+			return false;
+		if(type == file_type::symlink)
+			return Target_is_new_directory(Join(dir, e));
+		return true;
+		}
+
+	bool Target_is_new_directory(const path_type& path)
+		{   // followed symlink: the target has to be a directory, which was not listed before
+  #ifdef _WIN32
+		const DWORD a = GetFileAttributesW(path.c_str());
+		return (a != INVALID_FILE_ATTRIBUTES && (a & FILE_ATTRIBUTE_DIRECTORY));
+  #else
+		struct stat st;
+		DIRECTORY_ITERATOR_COUNT(stats);
+		if(::stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+			return false;
+		std::lock_guard<std::mutex> l(MyIdle_mutex);
+		return MyVisited.count(std::make_pair(st.st_dev, st.st_ino)) == 0;
+  #endif
+		}
+
+  #ifndef _WIN32
+	bool Claim(const path_type& path)
+		{   // record the directory path as listed (false: it was listed before)
+		struct stat st;
+		DIRECTORY_ITERATOR_COUNT(stats);
+		if(::stat(path.c_str(), &st) != 0)
+			return true; // the iterator reports the error
+		std::lock_guard<std::mutex> l(MyIdle_mutex);
+		return MyVisited.insert(std::make_pair(st.st_dev, st.st_ino)).second;
+		}
+  #endif
+
+	static path_type Join(const path_type& dir, const entry_type& e)
+		{   // path of entry e in directory dir
+		path_type path;
+		path.reserve(dir.size() + e.length() + 1);
+		path.append(dir).append(e.c_str(), e.length());
+		return (path);
+		}
+
+	static bool Is_dot(const entry_type& e)
+		{   // "." or ".."
+		const char_type* name = e.c_str();
+		return (name[0] == char_type('.')
+			&& (e.length() == 1 || (e.length() == 2 && name[1] == char_type('.'))));
+		}
+
+	Visitor& MyVisitor;
+	const options_type& MyOptions;
+	std::vector<Worker> MyWorkers;
+	std::atomic<unsigned long long> MyPending{0}; // directories queued or being listed
+	std::atomic<unsigned> MyIdle{0};              // threads waiting for work
+	std::atomic<bool> MyStop{false};
+	std::mutex MyIdle_mutex; // guards MyIdle_cv, MyError and MyVisited
+	std::condition_variable MyIdle_cv;
+	std::exception_ptr MyError;
+  #ifndef _WIN32
+	std::set<std::pair<dev_t, ino_t>> MyVisited; // directories listed (follow_symlinks only)
+  #endif
+	};
+
+	// TEMPLATE FUNCTION basic_parallel_walk
+template<class T, class Visitor>
+	walk_result basic_parallel_walk(const T& root, Visitor visitor,
+		const Basic_walk_options<T>& options = Basic_walk_options<T>())
+	{   // walk the tree below root
+	Parallel_walker<T, Visitor> walker(visitor, options);
+	return walker.Run(root);
+	}
+
+#ifdef _WIN32
+	typedef Basic_walk_options<std::basic_string<wchar_t>> walk_options;
+	typedef Basic_walk_batch<std::basic_string<wchar_t>> walk_batch;
+#else
+	typedef Basic_walk_options<std::basic_string<char>> walk_options;
+	typedef Basic_walk_batch<std::basic_string<char>> walk_batch;
+#endif
+
+	// TEMPLATE FUNCTION parallel_walk
+template<class Visitor>
+	walk_result parallel_walk(const walk_options::path_type& root, Visitor visitor,
+		const walk_options& options = walk_options())
+	{   // walk the tree below root
+	return basic_parallel_walk(root, visitor, options);
+	}
+
+};//end: namespace
@@ -0,0 +1,295 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     serialport_task talk(async_serialport& port)
+ *         {
+ *         byte cmd[] = {'I', 'D', '\n'};
+ *         co_await port.async_write(cmd);
+ *         if(!co_await port.async_flush(std::chrono::milliseconds(100)))
+ *             co_return;  // timeout
+ *         auto line = co_await port.async_read_until('\n', std::chrono::milliseconds(500));
+ *         if(line) ...  // *line: the answer including '\n'
+ *         }
+ *
+ *     serialport_manager m(2);
+ *     async_serialport port(m, buf);  // buf: unchecked_serialport_streambuf
+ *     talk(port);  // runs on the worker threads of m
+ *
+ * Description:
+ *     this file contains awaitable reads and writes (C++20 coroutines) on top of the event loop of
+ *     serialport_manager.h. a conversation with a device is written as one coroutine, thousands of
+ *     them share the few worker threads of the manager. every read and flush has a deadline
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <optional>
+#include <span>
+#include <coroutine>
+#include <exception>
+#include <algorithm>
+#include <assert.h>
+#include <mutex>
+#include <chrono>
+
+#include "serialport_manager.h"
+
+
+struct serialport_task
+	{ // coroutine type of a conversation: starts at once, runs detached
+	struct promise_type
+		{
+		serialport_task get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; } // frame is freed at the end
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+		};
+	};
+
+
+class async_serialport
+	{
+public:
+	// notice: one read and one flush may be pending at a time
+	// notice: the coroutine is resumed by a worker thread of the manager (or right away, if the
+	//         operation completes without waiting)
+	// notice: a read which times out returns std::nullopt, received bytes stay in the buffer
+
+	typedef serialport_manager::port_id port_id;
+	typedef std::chrono::milliseconds duration;
+	typedef std::optional<std::vector<byte>> read_result; // nullopt: timeout or port closed
+
+	// disable copy construction and copy assignment
+	async_serialport(const async_serialport&) = delete;
+	async_serialport& operator = (const async_serialport&) = delete;
+
+	async_serialport(serialport_manager& manager, int fd)
+		: manager_(manager)
+		, state_(std::make_shared<state>())
+		{ // serve the port fd (not owned) through manager
+		init(fd);
+		}
+
+	template<typename Streambuf>
+	async_serialport(serialport_manager& manager, Streambuf& buf)
+		: manager_(manager)
+		, state_(std::make_shared<state>())
+		{ // serve the port of a streambuffer (e.g. unchecked_serialport_streambuf)
+		init(buf.native_handle());
+		}
+
+	~async_serialport()
+		{ // destruct (stop serving the port)
+		manager_.remove(id_);
+		}
+
+	struct read_awaitable
+		{ // co_await: read_result
+		async_serialport* self;
+		std::size_t num;
+		int delim; // -1: read num bytes
+		duration timeout;
+		read_result result;
+
+		bool await_ready()
+			{
+			std::lock_guard<std::mutex> l(self->state_->m);
+			return self->try_read(*this);
+			}
+
+		bool await_suspend(std::coroutine_handle<> h)
+			{
+			auto st = self->state_;
+			std::lock_guard<std::mutex> l(st->m);
+			if(self->try_read(*this))
+				return false; // data arrived in between: continue right away
+			assert(!st->reader && "only one read at a time");
+			st->reader = h;
+			st->read_op = this;
+			const auto seq = ++st->read_seq;
+			st->read_timer = self->manager_.schedule(serialport_manager::clock_type::now() + timeout,
+				[st, seq]{ state::expire_read(*st, seq); });
+			return true; // notice: the coroutine may already run on another thread
+			}
+
+		read_result await_resume()
+			{
+			return std::move(result);
+			}
+		};
+
+	struct write_awaitable
+		{ // co_await: bool (false: port closed)
+		bool ok;
+		bool await_ready() const noexcept { return true; }
+		void await_suspend(std::coroutine_handle<>) const noexcept {}
+		bool await_resume() const noexcept { return ok; }
+		};
+
+	struct flush_awaitable
+		{ // co_await: bool (false: timeout or port closed)
+		async_serialport* self;
+		duration timeout;
+		bool result = false;
+
+		bool await_ready() const noexcept
+			{
+			return false;
+			}
+
+		bool await_suspend(std::coroutine_handle<> h)
+			{
+			auto st = self->state_;
+			std::unique_lock<std::mutex> l(st->m);
+			assert(!st->flusher && "only one flush at a time");
+			st->flusher = h;
+			st->flush_op = this;
+			st->flush_suspending = true; // a completion from now on must not resume h
+			const auto seq = ++st->flush_seq;
+			st->flush_timer = self->manager_.schedule(serialport_manager::clock_type::now() + timeout,
+				[st, seq]{ state::finish_flush(*st, seq, false, true); });
+			l.unlock();
+			auto& manager = self->manager_;
+			if(!manager.when_sent(self->id_, [st, seq, &manager](bool ok){
+					state::finish_flush(*st, seq, ok, false, &manager); }))
+				state::finish_flush(*st, seq, false, false, &manager); // port closed
+			l.lock();
+			st->flush_suspending = false;
+			return static_cast<bool>(st->flusher); // completed in between: continue right away
+			}
+
+		bool await_resume() const noexcept
+			{
+			return result;
+			}
+		};
+
+	read_awaitable async_read(std::size_t n, duration timeout)
+		{ // read exactly n bytes
+		return read_awaitable{this, n, -1, timeout, std::nullopt};
+		}
+
+	read_awaitable async_read_until(byte delim, duration timeout)
+		{ // read up to and including delim
+		return read_awaitable{this, 0, delim, timeout, std::nullopt};
+		}
+
+	write_awaitable async_write(std::span<const byte> data)
+		{ // queue data (never waits, see async_flush)
+		return write_awaitable{manager_.send(id_, data.data(), data.size())};
+		}
+
+	flush_awaitable async_flush(duration timeout)
+		{ // wait until the queued output is sent
+		return flush_awaitable{this, timeout};
+		}
+
+	port_id id() const
+		{ // port id of the manager
+		return id_;
+		}
+
+private:
+	struct state
+		{ // shared with the handler and the timers of the manager
+		std::mutex m;
+		std::vector<byte> rx;          // received, not yet read
+		bool closed = false;
+
+		std::coroutine_handle<> reader; // pending read
+		read_awaitable* read_op = nullptr;
+		serialport_manager::timer_id read_timer = 0;
+		unsigned long long read_seq = 0;
+
+		std::coroutine_handle<> flusher; // pending flush
+		flush_awaitable* flush_op = nullptr;
+		serialport_manager::timer_id flush_timer = 0;
+		unsigned long long flush_seq = 0;
+		bool flush_suspending = false;  // await_suspend did not return yet
+
+		static void expire_read(state& st, unsigned long long seq)
+			{ // deadline of a read
+			std::unique_lock<std::mutex> l(st.m);
+			if(!st.reader || st.read_seq != seq)
+				return; // completed in time
+			auto h = st.reader;
+			st.reader = nullptr;
+			st.read_op->result = std::nullopt;
+			l.unlock();
+			h.resume();
+			}
+
+		static void finish_flush(state& st, unsigned long long seq, bool ok, bool timeout,
+				serialport_manager* manager = nullptr)
+			{ // completion or deadline of a flush
+			std::unique_lock<std::mutex> l(st.m);
+			if(!st.flusher || st.flush_seq != seq)
+				return; // already completed
+			auto h = st.flusher;
+			st.flusher = nullptr;
+			st.flush_op->result = ok;
+			if(!timeout && manager)
+				manager->cancel(st.flush_timer);
+			if(st.flush_suspending)
+				return; // await_suspend continues the coroutine (no recursion on its stack)
+			l.unlock();
+			h.resume();
+			}
+		};
+
+	void init(int fd)
+		{ // register the port
+		auto st = state_;
+		auto& manager = manager_;
+		id_ = manager_.add(fd, [st, &manager](port_id, const byte* data, std::size_t n){
+			std::unique_lock<std::mutex> l(st->m);
+			if(n == 0)
+				st->closed = true;
+			else
+				st->rx.insert(st->rx.end(), data, data + n);
+			if(!st->reader || !Complete(*st, *st->read_op))
+				return;
+			auto h = st->reader;
+			st->reader = nullptr;
+			manager.cancel(st->read_timer);
+			l.unlock();
+			h.resume();
+			});
+		}
+
+	bool try_read(read_awaitable& op)
+		{ // complete op from the buffer (state_->m locked)
+		return Complete(*state_, op);
+		}
+
+	static bool Complete(state& st, read_awaitable& op)
+		{ // take the result of op from the buffer, if available (st.m locked)
+		std::size_t n = 0;
+		if(op.delim >= 0)
+			{
+			auto it = std::find(st.rx.begin(), st.rx.end(), static_cast<byte>(op.delim));
+			if(it != st.rx.end())
+				n = static_cast<std::size_t>(it - st.rx.begin()) + 1;
+			}
+		else if(st.rx.size() >= op.num)
+			n = op.num;
+
+		if(n == 0 && !(op.delim < 0 && op.num == 0))
+			{ // not enough data
+			if(!st.closed)
+				return false;
+			op.result = std::nullopt; // will never arrive
+			return true;
+			}
+		op.result = std::vector<byte>(st.rx.begin(), st.rx.begin() + n);
+		st.rx.erase(st.rx.begin(), st.rx.begin() + n);
+		return true;
+		}
+
+	serialport_manager& manager_;
+	std::shared_ptr<state> state_;
+	port_id id_ = 0;
+	};
@@ -0,0 +1,254 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     int main() { run_serialport_benchmarks(std::cout); }
+ *
+ * Description:
+ *     this file contains a throughput benchmark of the serialport streambuffers, which needs no
+ *     hardware: the streambuffer opens the slave side of a pseudo terminal, a device thread serves
+ *     the master side (sink, echo or source). every policy runs with several buffer sizes. the
+ *     results (and the metrics of each streambuffer) are written as one json object:
+ *
+ *     { "serialport_benchmarks": [ {"policy": ..., "direction": "tx", "buffer_size": ...,
+ *         "bytes": ..., "wire_bytes": ..., "seconds": ..., "mb_per_s": ..., "metrics": {...}}, ... ] }
+ *
+ *     a pseudo terminal ignores the baudrate: the numbers show the cost of the software path
+ *     (system calls, copies, compression, echo round trips), not of a real line
+ */
+
+#pragma once
+
+#ifdef _WIN32
+  #error "serialport_benchmark requires POSIX pseudo terminals"
+#endif
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "serialport_streambuf.h"
+#include "serialport_compression.h"
+
+
+struct serialport_benchmark_options
+	{ // parameters of the benchmark
+	std::vector<std::size_t> buffer_sizes = {16, 128, 1024, 4096, 65536}; // output (tx) or input (rx) buffer
+	std::size_t bytes = 256*1024;  // payload per run
+	std::size_t write_size = 32;   // elements per sputn/sgetn call (small messages)
+	};
+
+class serialport_pty
+	{ // pseudo terminal: the streambuffer opens name(), the device thread serves master()
+public:
+	serialport_pty()
+		: master_(posix_openpt(O_RDWR | O_NOCTTY))
+		{
+		if(master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0)
+			throw new std::runtime_error("unable to open pseudo terminal");
+		name_ = ptsname(master_);
+		}
+
+	~serialport_pty()
+		{
+		::close(master_);
+		}
+
+	serialport_pty(const serialport_pty&) = delete;
+	serialport_pty& operator = (const serialport_pty&) = delete;
+
+	int master() const { return master_; }
+	const char* name() const { return name_.c_str(); }
+
+private:
+	int master_;
+	std::string name_;
+	};
+
+class serialport_device
+	{ // thread on the master side of a pty: counts the received bytes, optionally echoes them
+public:
+	serialport_device(int fd, bool echo)
+		: fd_(fd)
+		, echo_(echo)
+		, thread_(&serialport_device::run, this)
+		{
+		}
+
+	~serialport_device()
+		{
+		stop_.store(true);
+		thread_.join();
+		}
+
+	unsigned long long received() const
+		{ // bytes received so far
+		return received_.load();
+		}
+
+	std::chrono::steady_clock::time_point last_received() const
+		{ // time of the last read
+		return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(last_.load()));
+		}
+
+private:
+	void run()
+		{
+		std::vector<byte> b(65536);
+		while(!stop_.load())
+			{
+			pollfd pfd = {fd_, POLLIN, 0};
+			if(::poll(&pfd, 1, 20) <= 0)
+				continue;
+			const ssize_t n = ::read(fd_, b.data(), b.size());
+			if(n <= 0)
+				continue;
+			if(echo_)
+				{ // bytes with the highest bit set come back inverted
+				for(ssize_t i=0; i<n; ++i)
+					if(b[i] & 0x80)
+						b[i] = static_cast<byte>(~b[i]);
+				for(ssize_t k=0; k<n; )
+					{
+					const ssize_t w = ::write(fd_, b.data() + k, n - k);
+					if(w <= 0)
+						break;
+					k += w;
+					}
+				}
+			last_.store(std::chrono::steady_clock::now().time_since_epoch().count());
+			received_ += static_cast<unsigned long long>(n);
+			}
+		}
+
+	int fd_;
+	bool echo_;
+	std::atomic<bool> stop_{false};
+	std::atomic<unsigned long long> received_{0};
+	std::atomic<std::chrono::steady_clock::rep> last_{0};
+	std::thread thread_; // started last
+	};
+
+inline std::vector<byte> Serialport_payload(std::size_t n)
+	{ // telemetry like text (compressible)
+	std::vector<byte> v;
+	v.reserve(n + 128);
+	for(unsigned i=0; v.size()<n; ++i)
+		{
+		const std::string line = "{\"t\":" + std::to_string(1000000 + 10*i) + ",\"temp\":"
+			+ std::to_string(20 + (i*7)%5) + ".5,\"state\":\"ok\"}\n";
+		v.insert(v.end(), line.begin(), line.end());
+		}
+	v.resize(n);
+	return v;
+	}
+
+inline void Serialport_result(std::ostream& json, bool& first, const char* policy, const char* direction,
+		std::size_t buf_size, std::size_t bytes, unsigned long long wire, double seconds,
+		const serialport_metrics_snapshot& m)
+	{ // one json result
+	json << (first ? "\n    " : ",\n    ") << "{\"policy\": \"" << policy << "\", \"direction\": \""
+		<< direction << "\", \"buffer_size\": " << buf_size << ", \"bytes\": " << bytes
+		<< ", \"wire_bytes\": " << wire << ", \"seconds\": " << seconds
+		<< ", \"mb_per_s\": " << (seconds > 0 ? double(bytes)/seconds/1e6 : 0.0) << ", \"metrics\": ";
+	m.write_json(json);
+	json << "}";
+	first = false;
+	}
+
+template<class Streambuf>
+	void Serialport_tx(std::ostream& json, bool& first, const char* policy, bool echo,
+		const serialport_benchmark_options& o, const std::vector<byte>& payload)
+	{ // write the payload in small pieces, the run ends with the last byte the device receives
+	for(std::size_t buf_size : o.buffer_sizes)
+		{
+		serialport_pty pty;
+		serialport_device device(pty.master(), echo);
+		Streambuf buf(pty.name(), 115200, buf_size);
+		const auto start = std::chrono::steady_clock::now();
+		for(std::size_t i=0; i<payload.size(); i+=o.write_size)
+			buf.sputn(payload.data() + i, std::min(o.write_size, payload.size() - i));
+		buf.pubsync();
+		auto end = std::chrono::steady_clock::now();
+		for(unsigned long long wire = ~0ULL; wire != device.received(); )
+			{ // wait until the line is idle (the wire size of compressing policies is unknown)
+			wire = device.received();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+		if(device.last_received() > end)
+			end = device.last_received();
+		const double s = std::chrono::duration<double>(end - start).count();
+		Serialport_result(json, first, policy, "tx", buf_size, payload.size(), device.received(), s, buf.metrics());
+		}
+	}
+
+template<class Streambuf>
+	void Serialport_rx(std::ostream& json, bool& first, const char* policy,
+		const serialport_benchmark_options& o, const std::vector<byte>& payload, const std::vector<byte>& wire)
+	{ // the device sends the wire bytes, read the payload in small pieces
+	for(std::size_t buf_size : o.buffer_sizes)
+		{
+		serialport_pty pty;
+		Streambuf buf(pty.name(), 115200, SERIALPORT_DEFAULT_OUTPUT_BUFSIZE, buf_size);
+		// non-blocking writes: if the reader gives up, the source must not hang on a full line
+		::fcntl(pty.master(), F_SETFL, ::fcntl(pty.master(), F_GETFL) | O_NONBLOCK);
+		std::atomic<bool> stop{false};
+		std::thread source([&]{
+			for(std::size_t k=0; k<wire.size() && !stop.load(); )
+				{
+				pollfd pfd = {pty.master(), POLLOUT, 0};
+				if(::poll(&pfd, 1, 20) <= 0)
+					continue;
+				const ssize_t w = ::write(pty.master(), wire.data() + k, wire.size() - k);
+				if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					continue;
+				if(w <= 0)
+					break;
+				k += static_cast<std::size_t>(w);
+				}
+			});
+		std::vector<byte> in(o.write_size);
+		std::size_t got = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while(got < payload.size())
+			{
+			const std::streamsize n = buf.sgetn(in.data(), static_cast<std::streamsize>(
+				std::min(o.write_size, payload.size() - got)));
+			if(n <= 0)
+				break; // timeout
+			got += static_cast<std::size_t>(n);
+			}
+		const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stop.store(true);
+		source.join();
+		Serialport_result(json, first, policy, "rx", buf_size, got, wire.size(), s, buf.metrics());
+		}
+	}
+
+inline void run_serialport_benchmarks(std::ostream& json,
+		const serialport_benchmark_options& o = serialport_benchmark_options())
+	{ // all policies, all buffer sizes
+	const auto payload = Serialport_payload(o.bytes);
+	std::vector<byte> compressed;
+	lz_stream_encoder encoder;
+	encoder.encode(payload.data(), payload.size(), compressed);
+
+	bool first = true;
+	json << "{\"serialport_benchmarks\": [";
+	Serialport_tx<unchecked_serialport_streambuf>(json, first, "unchecked", false, o, payload);
+	Serialport_tx<serialport_streambuf>(json, first, "pipelined_echo", true, o, payload);
+	Serialport_tx<compressed_serialport_streambuf>(json, first, "compressed", false, o, payload);
+	Serialport_rx<unchecked_serialport_streambuf>(json, first, "unchecked", o, payload, payload);
+	Serialport_rx<compressed_serialport_streambuf>(json, first, "compressed", o, payload, compressed);
+	json << "\n  ]}" << std::endl;
+	}
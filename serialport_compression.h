@@ -0,0 +1,358 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     auto buf = compressed_serialport_streambuf("/dev/ttyUSB0");  // both ends must compress
+ *     auto s = std::basic_iostream<byte>(&buf);  // pass buffer to an io-stream
+ *     s << telemetry << std::flush;  // flush: the data is complete on the other side
+ *
+ * Description:
+ *     this file contains a compressing writer policy and a decompressing reader policy for the
+ *     serialport streambuffer. the codec is a small LZ77 variant (similar to LZ4): repeated byte
+ *     sequences are replaced by references into the last 16 KiB of the stream. the dictionary
+ *     carries over from one write to the next, every write of the streambuffer (a flush) forms
+ *     one block, which the receiver decodes as soon as it is complete
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <assert.h>
+#include <stdexcept>
+
+#include "serialport_streambuf.h"
+
+#define SERIALPORT_LZ_WINDOW 16384 // history used for references (both sides keep this much)
+#define SERIALPORT_LZ_MAX_BLOCK 16384 // largest block (larger writes are split)
+
+
+/**
+ * CODEC
+ *
+ * block = type (0: stored, 1: compressed), raw size (u16), payload size (u16), payload
+ * payload = sequences: token (literals << 4 | match length - 4), [literal length], literals,
+ *           offset (u16), [match length]. the last sequence has no match
+ */
+
+class lz_stream_encoder
+	{
+public:
+	enum { hash_bits = 12 };
+
+	lz_stream_encoder()
+		: table_(std::size_t(1) << hash_bits, static_cast<unsigned long long>(npos))
+		{ // construct empty dictionary
+		window_.reserve(SERIALPORT_LZ_WINDOW + SERIALPORT_LZ_MAX_BLOCK);
+		}
+
+	void encode(const byte* data, std::size_t n, std::vector<byte>& out)
+		{ // append the blocks of n bytes to out
+		assert(n == 0 || data != nullptr);
+		while(n > 0)
+			{
+			const std::size_t num = n < SERIALPORT_LZ_MAX_BLOCK ? n : SERIALPORT_LZ_MAX_BLOCK;
+			encode_block(data, num, out);
+			data += num;
+			n -= num;
+			}
+		}
+
+private:
+	static const unsigned long long npos = ~0ULL;
+
+	void encode_block(const byte* data, std::size_t n, std::vector<byte>& out)
+		{ // append one block
+		const std::size_t header = out.size();
+		out.resize(header + 5);
+		const std::size_t start = window_.size();
+		window_.insert(window_.end(), data, data + n);
+		const byte* w = window_.data();
+		const std::size_t end = start + n;
+
+		std::size_t anchor = start; // first literal
+		std::size_t i = start;
+		while(i + 4 <= end)
+			{
+			const std::uint32_t seq = load32(w + i);
+			const std::size_t h = (seq * 2654435761u) >> (32 - hash_bits);
+			const unsigned long long cand = table_[h];
+			table_[h] = base_ + i;
+			if(cand == npos || cand < base_ || load32(w + (cand - base_)) != seq)
+				{
+				++i;
+				continue;
+				}
+			// match: extend it
+			const std::size_t c = static_cast<std::size_t>(cand - base_);
+			std::size_t len = 4;
+			while(i + len < end && w[c + len] == w[i + len])
+				++len;
+			put_sequence(out, w + anchor, i - anchor, i - c, len);
+			i += len;
+			anchor = i;
+			}
+		if(anchor < end)
+			put_sequence(out, w + anchor, end - anchor, 0, 0); // last literals
+
+		std::size_t size = out.size() - header - 5;
+		byte type = 1;
+		if(size >= n)
+			{ // incompressible: store
+			out.resize(header + 5);
+			out.insert(out.end(), data, data + n);
+			size = n;
+			type = 0;
+			}
+		out[header] = type;
+		out[header + 1] = byte(n);
+		out[header + 2] = byte(n >> 8);
+		out[header + 3] = byte(size);
+		out[header + 4] = byte(size >> 8);
+		trim();
+		}
+
+	static void put_sequence(std::vector<byte>& out, const byte* lit, std::size_t num_lit,
+			std::size_t offset, std::size_t len)
+		{ // literals and a match (len == 0: no match)
+		const std::size_t m = len > 0 ? len - 4 : 0;
+		out.push_back(byte((num_lit < 15 ? num_lit : 15) << 4 | (m < 15 ? m : 15)));
+		if(num_lit >= 15)
+			put_length(out, num_lit - 15);
+		out.insert(out.end(), lit, lit + num_lit);
+		if(len == 0)
+			return;
+		out.push_back(byte(offset));
+		out.push_back(byte(offset >> 8));
+		if(m >= 15)
+			put_length(out, m - 15);
+		}
+
+	static void put_length(std::vector<byte>& out, std::size_t n)
+		{ // 255, 255, ..., rest
+		for(; n >= 255; n -= 255)
+			out.push_back(255);
+		out.push_back(byte(n));
+		}
+
+	static std::uint32_t load32(const byte* p)
+		{
+		std::uint32_t v;
+		std::memcpy(&v, p, 4);
+		return v;
+		}
+
+	void trim()
+		{ // keep the last SERIALPORT_LZ_WINDOW bytes
+		if(window_.size() <= SERIALPORT_LZ_WINDOW)
+			return;
+		const std::size_t drop = window_.size() - SERIALPORT_LZ_WINDOW;
+		window_.erase(window_.begin(), window_.begin() + drop);
+		base_ += drop;
+		}
+
+	std::vector<byte> window_;    // history and current block
+	unsigned long long base_ = 0; // stream position of window_[0]
+	std::vector<unsigned long long> table_; // hash of 4 bytes -> last stream position
+	};
+
+class lz_stream_decoder
+	{
+public:
+	lz_stream_decoder()
+		{ // construct empty dictionary
+		window_.reserve(SERIALPORT_LZ_WINDOW + SERIALPORT_LZ_MAX_BLOCK);
+		}
+
+	bool feed(const byte* data, std::size_t n, std::vector<byte>& out)
+		{ // decode n bytes of the stream, append complete blocks to out (false: corrupt stream)
+		assert(n == 0 || data != nullptr);
+		block_.insert(block_.end(), data, data + n);
+		std::size_t pos = 0;
+		while(block_.size() - pos >= 5)
+			{
+			const byte* b = block_.data() + pos;
+			const std::size_t raw = b[1] | std::size_t(b[2]) << 8;
+			const std::size_t size = b[3] | std::size_t(b[4]) << 8;
+			if(block_.size() - pos - 5 < size)
+				break; // incomplete
+			if(!decode_block(b[0], b + 5, size, raw))
+				return false;
+			out.insert(out.end(), window_.end() - raw, window_.end());
+			trim();
+			pos += 5 + size;
+			}
+		block_.erase(block_.begin(), block_.begin() + pos);
+		return true;
+		}
+
+private:
+	bool decode_block(byte type, const byte* p, std::size_t size, std::size_t raw)
+		{ // append the block to the window
+		if(type == 0)
+			{ // stored
+			if(size != raw)
+				return false;
+			window_.insert(window_.end(), p, p + size);
+			return true;
+			}
+		if(type != 1)
+			return false;
+		const byte* end = p + size;
+		const std::size_t target = window_.size() + raw;
+		while(window_.size() < target)
+			{
+			if(p == end)
+				return false;
+			const byte token = *p++;
+			std::size_t num_lit = token >> 4;
+			if(num_lit == 15 && !get_length(p, end, num_lit))
+				return false;
+			if(std::size_t(end - p) < num_lit || window_.size() + num_lit > target)
+				return false;
+			window_.insert(window_.end(), p, p + num_lit);
+			p += num_lit;
+			if(window_.size() == target)
+				break; // last sequence
+
+			if(end - p < 2)
+				return false;
+			const std::size_t offset = p[0] | std::size_t(p[1]) << 8;
+			p += 2;
+			std::size_t len = token & 15;
+			if(len == 15 && !get_length(p, end, len))
+				return false;
+			len += 4;
+			if(offset == 0 || offset > window_.size() || window_.size() + len > target)
+				return false;
+			std::size_t from = window_.size() - offset;
+			for(std::size_t k=0; k<len; ++k)
+				window_.push_back(window_[from + k]); // may overlap
+			}
+		return p == end;
+		}
+
+	static bool get_length(const byte*& p, const byte* end, std::size_t& n)
+		{ // add the extension bytes of a length
+		byte b;
+		do  {
+			if(p == end)
+				return false;
+			b = *p++;
+			n += b;
+			} while(b == 255);
+		return true;
+		}
+
+	void trim()
+		{ // keep the last SERIALPORT_LZ_WINDOW bytes
+		if(window_.size() > SERIALPORT_LZ_WINDOW)
+			window_.erase(window_.begin(), window_.end() - SERIALPORT_LZ_WINDOW);
+		}
+
+	std::vector<byte> window_; // history
+	std::vector<byte> block_;  // received bytes of incomplete blocks
+	};
+
+
+/**
+ * POLICY CLASSES
+ *
+ * compression and decompression around another writer and reader policy
+ */
+
+template<template<class,class> class RawWriter, // sends the compressed blocks
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_lz_compressing_writer
+	{ // function object: provide compressing write function
+	// notice: the dictionary is part of the policy. after a failed write the receiver is out of
+	//         sync (reopen the port)
+	static_assert(sizeof(T) == 1, "character type has to be byte sized");
+
+	template<typename Handle>
+	void operator () (Handle serial_port, const T* buffer, std::size_t num)
+		{
+		assert(buffer!=nullptr); // make sure that the buffer exists
+		out_.clear();
+		encoder_.encode(reinterpret_cast<const byte*>(buffer), num, out_);
+		raw_(serial_port, reinterpret_cast<const T*>(out_.data()), out_.size());
+		}
+
+private:
+	RawWriter<T,Traits> raw_;
+	lz_stream_encoder encoder_;
+	std::vector<byte> out_; // compressed blocks
+	};
+
+template<template<class,class> class RawReader, // receives the compressed blocks
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_lz_decompressing_reader
+	{ // function object: provide decompressing read function
+	static_assert(sizeof(T) == 1, "character type has to be byte sized");
+
+	p_lz_decompressing_reader()
+		: in_(SERIALPORT_DEFAULT_INPUT_BUFSIZE)
+		{
+		}
+
+	template<typename Handle>
+	bool operator () (Handle serial_port, T* buffer, std::size_t num, std::size_t* num_read)
+		{
+		*num_read = 0;
+		while(pos_ == out_.size())
+			{ // read until a block is complete
+			out_.clear();
+			pos_ = 0;
+			std::size_t n = 0;
+			if(!raw_(serial_port, reinterpret_cast<T*>(in_.data()), in_.size(), &n))
+				return false;
+			if(n == 0)
+				return true; // timeout
+			if(!decoder_.feed(in_.data(), n, out_))
+				return false; // corrupt stream
+			}
+		std::size_t n = out_.size() - pos_;
+		if(n > num)
+			n = num;
+		std::memcpy(buffer, out_.data() + pos_, n);
+		pos_ += n;
+		*num_read = n;
+		return true;
+		}
+
+	template<typename Handle>
+	std::size_t pending(Handle)
+		{ // decoded elements, which were not read yet
+		return out_.size() - pos_;
+		}
+
+private:
+	RawReader<T,Traits> raw_;
+	lz_stream_decoder decoder_;
+	std::vector<byte> in_;  // compressed input
+	std::vector<byte> out_; // decoded input
+	std::size_t pos_ = 0;   // first unread element of out_
+	};
+
+
+#ifdef _WIN32
+
+// compressing stream-buffer: the other side has to use the same codec
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, HANDLE,
+		p_lz_compressing_writer<p_winapi_file_writer, byte>,    // writing policy
+		p_lz_decompressing_reader<p_winapi_file_reader, byte>,  // reading policy
+		p_winapi_file_deleter<byte>,                            // deleting policy
+		p_serialport_initializer<byte>>                         // initalizing policy
+	compressed_serialport_streambuf;
+
+#else // POSIX
+
+// compressing stream-buffer: the other side has to use the same codec
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, int,
+		p_lz_compressing_writer<p_posix_fd_writer, byte>,    // writing policy
+		p_lz_decompressing_reader<p_posix_fd_reader, byte>,  // reading policy
+		p_posix_fd_deleter<byte>,                            // deleting policy
+		p_posix_serialport_initializer<byte>>                // initalizing policy
+	compressed_serialport_streambuf;
+
+#endif // _WIN32
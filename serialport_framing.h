@@ -0,0 +1,367 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     auto buf = unchecked_serialport_streambuf("/dev/ttyUSB0", 250000);
+ *     auto out = frame_writer(&buf);  // batches small messages (default: at most 2 ms delay)
+ *     out.send(msg, n);
+ *
+ *     auto in = frame_reader(&buf);
+ *     std::vector<byte> msg;
+ *     while(in.receive(msg)) ...  // one complete, crc checked message per call
+ *
+ * Description:
+ *     this file contains a framed transport on top of a streambuffer. every message gets a crc32
+ *     and is COBS encoded (consistent overhead byte stuffing: the encoded frame contains no zero
+ *     bytes, a zero byte ends the frame). the decoder works incrementally, frames may be split
+ *     over any number of reads. damaged frames are dropped (and counted), there is no retransmission
+ */
+
+#pragma once
+
+#include <vector>
+#include <streambuf>
+#include <functional>
+#include <assert.h>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "serialport_streambuf.h"
+
+#define SERIALPORT_FRAME_MAX_BATCH 4096 // bytes collected by frame_writer before it flushes
+#define SERIALPORT_FRAME_LATENCY_US 2000 // time a message may wait in the batch
+#define SERIALPORT_FRAME_MAX_SIZE 65536 // largest accepted message (decoder)
+
+
+/**
+ * CRC32
+ *
+ * crc32 (ieee 802.3, reflected, polynomial 0xEDB88320) with slicing-by-8
+ */
+
+struct serialport_crc32_table
+	{ // eight lookup tables: table[k][b] = crc of b followed by k zero bytes
+	std::uint32_t table[8][256];
+
+	serialport_crc32_table()
+		{
+		for(std::uint32_t b=0; b<256; ++b)
+			{
+			std::uint32_t c = b;
+			for(int i=0; i<8; ++i)
+				c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+			table[0][b] = c;
+			}
+		for(std::uint32_t b=0; b<256; ++b)
+			for(int k=1; k<8; ++k)
+				table[k][b] = (table[k-1][b] >> 8) ^ table[0][table[k-1][b] & 0xFF];
+		}
+
+	static const serialport_crc32_table& get()
+		{ // tables are built on first use
+		static const serialport_crc32_table t;
+		return t;
+		}
+	};
+
+inline std::uint32_t serialport_crc32(const byte* data, std::size_t n, std::uint32_t crc = 0)
+	{ // crc32 of data (continue a previous crc with the crc argument)
+	assert(n == 0 || data != nullptr);
+	const auto& t = serialport_crc32_table::get().table;
+	crc = ~crc;
+	while(n >= 8)
+		{ // eight bytes per step
+		const std::uint32_t lo = crc ^ (std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8
+			| std::uint32_t(data[2]) << 16 | std::uint32_t(data[3]) << 24);
+		crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+			^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+		data += 8;
+		n -= 8;
+		}
+	while(n-- > 0)
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+	return ~crc;
+	}
+
+
+/**
+ * COBS
+ *
+ * frame = cobs(message + crc32 (little endian)) + 0x00
+ */
+
+inline void cobs_encode(const byte* data, std::size_t n, std::vector<byte>& out)
+	{ // append the frame of message data to out
+	assert(n == 0 || data != nullptr);
+	const std::uint32_t crc = serialport_crc32(data, n);
+	const byte tail[4] = {byte(crc), byte(crc >> 8), byte(crc >> 16), byte(crc >> 24)};
+
+	out.reserve(out.size() + n + n/254 + 6);
+	std::size_t code_pos = out.size(); // position of the current code byte
+	out.push_back(0);
+	byte code = 1;
+	for(std::size_t i=0; i<n+4; ++i)
+		{
+		const byte b = i < n ? data[i] : tail[i-n];
+		if(b != 0)
+			{
+			out.push_back(b);
+			++code;
+			}
+		if(b == 0 || code == 0xFF)
+			{ // close the block
+			out[code_pos] = code;
+			code_pos = out.size();
+			out.push_back(0);
+			code = 1;
+			}
+		}
+	out[code_pos] = code;
+	out.push_back(0); // frame delimiter
+	}
+
+class cobs_decoder
+	{
+public:
+	// notice: feed() accepts any piece of the byte stream. the handler is called for every complete,
+	//         undamaged frame (payload without the crc)
+
+	typedef std::function<void(const byte*, std::size_t)> handler_type;
+
+	explicit cobs_decoder(std::size_t max_size = SERIALPORT_FRAME_MAX_SIZE)
+		: max_size_(max_size + 4)
+		{ // construct empty decoder
+		frame_.reserve(256);
+		}
+
+	template<typename Handler>
+	void feed(const byte* data, std::size_t n, Handler&& handler)
+		{ // decode n bytes of the stream
+		assert(n == 0 || data != nullptr);
+		for(std::size_t i=0; i<n; ++i)
+			{
+			const byte b = data[i];
+			if(b == 0)
+				{ // end of frame
+				end_frame(handler);
+				continue;
+				}
+			if(overflow_)
+				continue; // skip to the next delimiter
+			if(left_ == 0)
+				{ // code byte
+				if(code_ != 0 && code_ != 0xFF)
+					frame_.push_back(0); // the previous block ended with a zero
+				code_ = b;
+				left_ = b - 1;
+				}
+			else
+				{
+				frame_.push_back(b);
+				--left_;
+				}
+			if(frame_.size() > max_size_)
+				overflow_ = true;
+			}
+		}
+
+	unsigned long long frames() const { return frames_; }          // number of good frames
+	unsigned long long crc_errors() const { return crc_errors_; }   // frames with a wrong crc
+	unsigned long long framing_errors() const { return framing_errors_; } // truncated or oversized frames
+
+private:
+	template<typename Handler>
+	void end_frame(Handler& handler)
+		{ // check and deliver the frame
+		if(code_ == 0 && frame_.empty() && !overflow_)
+			return; // empty frame (e.g. a delimiter used for resynchronisation)
+		if(overflow_ || left_ != 0 || frame_.size() < 4)
+			++framing_errors_;
+		else
+			{
+			const std::size_t n = frame_.size() - 4;
+			const std::uint32_t crc = std::uint32_t(frame_[n]) | std::uint32_t(frame_[n+1]) << 8
+				| std::uint32_t(frame_[n+2]) << 16 | std::uint32_t(frame_[n+3]) << 24;
+			if(serialport_crc32(frame_.data(), n) != crc)
+				++crc_errors_;
+			else
+				{
+				++frames_;
+				handler(frame_.data(), n);
+				}
+			}
+		frame_.clear();
+		code_ = 0;
+		left_ = 0;
+		overflow_ = false;
+		}
+
+	std::vector<byte> frame_; // decoded bytes of the current frame
+	std::size_t max_size_;
+	byte code_ = 0;           // code byte of the current block (0: none yet)
+	std::size_t left_ = 0;    // data bytes left in the current block
+	bool overflow_ = false;
+	unsigned long long frames_ = 0;
+	unsigned long long crc_errors_ = 0;
+	unsigned long long framing_errors_ = 0;
+	};
+
+
+/**
+ * TRANSPORT
+ *
+ * frame_writer and frame_reader on top of a streambuffer
+ */
+
+class frame_writer
+	{
+public:
+	// notice: messages are collected and written with one flush, once the batch is full or
+	//         the oldest message waited for the latency budget (background thread)
+	// notice: send may be called by several threads
+
+	typedef std::basic_streambuf<byte> streambuf_type;
+
+	// disable copy construction and copy assignment
+	frame_writer(const frame_writer&) = delete;
+	frame_writer& operator = (const frame_writer&) = delete;
+
+	explicit frame_writer(streambuf_type* dest,
+			std::chrono::microseconds latency = std::chrono::microseconds(SERIALPORT_FRAME_LATENCY_US),
+			std::size_t max_batch = SERIALPORT_FRAME_MAX_BATCH)
+		: dest_(dest)
+		, latency_(latency)
+		, max_batch_(max_batch)
+		{ // construct from parameters (dest is not owned)
+		assert(dest_ != nullptr);
+		batch_.reserve(max_batch_ + 64);
+		flusher_ = std::thread(&frame_writer::flush_loop, this);
+		}
+
+	~frame_writer()
+		{ // destruct (send the remaining messages)
+			{
+			std::lock_guard<std::mutex> l(m_);
+			stop_ = true;
+			}
+		cv_.notify_one();
+		flusher_.join();
+		flush();
+		}
+
+	bool send(const byte* msg, std::size_t n)
+		{ // queue message msg (false: an earlier write failed)
+		std::unique_lock<std::mutex> l(m_);
+		const bool first = batch_.empty();
+		cobs_encode(msg, n, batch_);
+		++messages_;
+		if(batch_.size() >= max_batch_)
+			return write_batch(l);
+		if(first)
+			{ // start the latency budget
+			deadline_ = std::chrono::steady_clock::now() + latency_;
+			cv_.notify_one();
+			}
+		return !failed_;
+		}
+
+	bool flush()
+		{ // write the batch now
+		std::unique_lock<std::mutex> l(m_);
+		return write_batch(l);
+		}
+
+	unsigned long long messages() const { std::lock_guard<std::mutex> l(m_); return messages_; } // queued messages
+	unsigned long long flushes() const { std::lock_guard<std::mutex> l(m_); return flushes_; }   // batches written
+
+private:
+	bool write_batch(std::unique_lock<std::mutex>&)
+		{ // pass the batch to the streambuffer (m_ locked)
+		if(batch_.empty())
+			return !failed_;
+		const std::streamsize n = static_cast<std::streamsize>(batch_.size());
+		if(dest_->sputn(batch_.data(), n) != n || dest_->pubsync() == -1)
+			failed_ = true;
+		batch_.clear();
+		++flushes_;
+		return !failed_;
+		}
+
+	void flush_loop()
+		{ // flusher thread: enforce the latency budget
+		std::unique_lock<std::mutex> l(m_);
+		while(!stop_)
+			{
+			if(batch_.empty())
+				cv_.wait(l);
+			else if(std::chrono::steady_clock::now() >= deadline_)
+				write_batch(l);
+			else
+				cv_.wait_until(l, deadline_);
+			}
+		}
+
+	streambuf_type* dest_;
+	std::chrono::microseconds latency_;
+	std::size_t max_batch_;
+
+	mutable std::mutex m_; // guards the members below
+	std::condition_variable cv_;
+	std::vector<byte> batch_; // encoded frames
+	std::chrono::steady_clock::time_point deadline_; // latest flush of the batch
+	bool failed_ = false;
+	bool stop_ = false;
+	unsigned long long messages_ = 0;
+	unsigned long long flushes_ = 0;
+
+	std::thread flusher_; // started last
+	};
+
+class frame_reader
+	{
+public:
+	// notice: receive blocks like the streambuffer does (e.g. the read timeout of the port)
+
+	typedef std::basic_streambuf<byte> streambuf_type;
+
+	explicit frame_reader(streambuf_type* src, std::size_t max_size = SERIALPORT_FRAME_MAX_SIZE)
+		: src_(src)
+		, decoder_(max_size)
+		, chunk_(4096)
+		{ // construct from parameters (src is not owned)
+		assert(src_ != nullptr);
+		}
+
+	bool receive(std::vector<byte>& msg)
+		{ // next good message (false: end of stream or timeout)
+		while(head_ == ready_.size())
+			{ // decode until a frame is complete
+			ready_.clear();
+			head_ = 0;
+			if(src_->sgetc() == std::char_traits<byte>::eof())
+				return false;
+			std::streamsize avail = src_->in_avail();
+			if(avail > static_cast<std::streamsize>(chunk_.size()))
+				avail = static_cast<std::streamsize>(chunk_.size());
+			const std::streamsize n = src_->sgetn(chunk_.data(), avail > 0 ? avail : 1);
+			decoder_.feed(chunk_.data(), static_cast<std::size_t>(n), [this](const byte* p, std::size_t len){
+				ready_.push_back(std::vector<byte>(p, p + len)); });
+			}
+		msg.swap(ready_[head_++]);
+		return true;
+		}
+
+	const cobs_decoder& decoder() const
+		{ // statistics of the decoder
+		return decoder_;
+		}
+
+private:
+	streambuf_type* src_;
+	cobs_decoder decoder_;
+	std::vector<byte> chunk_; // raw input
+	std::vector<std::vector<byte>> ready_; // decoded messages of the last chunk
+	std::size_t head_ = 0;    // next message of ready_
+	};
@@ -0,0 +1,427 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     serialport_manager m(2);  // two worker threads for all ports
+ *     auto buf = unchecked_serialport_streambuf("/dev/ttyUSB0", 115200);
+ *     auto id = m.add(buf, [](serialport_manager::port_id id, const byte* data, std::size_t n){
+ *         // called by a worker thread whenever data arrived (n == 0: port closed)
+ *     });
+ *     m.send(id, data, n);  // queued, sent as soon as the port is writable
+ *     m.schedule(std::chrono::steady_clock::now() + std::chrono::seconds(1), []{ ... });  // timer
+ *
+ * Description:
+ *     this file contains an event loop (linux: epoll), which serves many serial ports with a small,
+ *     fixed number of threads. the ports are switched to non-blocking mode. a worker thread reads
+ *     everything a ready port delivers, passes it to the port's handler and sends the port's
+ *     queued output. one port is never served by two threads at the same time.
+ *     timers (linux: timerfd) run on the same worker threads
+ */
+
+#pragma once
+
+#ifndef __linux__
+  #error "serialport_manager requires linux (epoll, eventfd)"
+#endif
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <assert.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "serialport_streambuf.h"
+
+#define SERIALPORT_MANAGER_READ_SIZE 4096 // bytes read per call (per worker thread)
+#define SERIALPORT_MANAGER_MAX_EVENTS 64 // events fetched per epoll_wait
+
+
+class serialport_manager
+	{
+public:
+	// notice: a port added by its streambuffer must not be used through the streambuffer any longer.
+	//         the streambuffer still owns (and finally closes) the handle: remove the port first
+	// notice: the handler of a port is called by one thread at a time, in the order of the data
+
+	typedef unsigned long long port_id;
+	typedef std::function<void(port_id, const byte*, std::size_t)> handler_type; // n == 0: port closed
+	typedef unsigned long long timer_id;
+	typedef std::chrono::steady_clock clock_type; // CLOCK_MONOTONIC
+
+	// disable copy construction and copy assignment
+	serialport_manager(const serialport_manager&) = delete;
+	serialport_manager& operator = (const serialport_manager&) = delete;
+
+	explicit serialport_manager(std::size_t num_threads = 1)
+		: epoll_(epoll_create1(EPOLL_CLOEXEC))
+		, wakeup_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+		, timer_(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK))
+		{ // construct from parameters (start the worker threads)
+		if(epoll_ < 0 || wakeup_ < 0 || timer_ < 0)
+			{
+			close_fds();
+			throw new std::runtime_error("unable to create event loop");
+			}
+		epoll_event ev = {};
+		ev.events = EPOLLIN; // level triggered: wakes all workers on shutdown
+		ev.data.u64 = wakeup_id;
+		epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev);
+		ev.events = EPOLLIN | EPOLLONESHOT; // one worker runs the expired timers
+		ev.data.u64 = timer_event_id;
+		epoll_ctl(epoll_, EPOLL_CTL_ADD, timer_, &ev);
+
+		if(num_threads == 0)
+			num_threads = 1;
+		for(std::size_t i=0; i<num_threads; ++i)
+			workers_.emplace_back(&serialport_manager::work, this);
+		}
+
+	~serialport_manager()
+		{ // destruct (stop the worker threads)
+		stop_.store(true);
+		const unsigned long long one = 1;
+		if(write(wakeup_, &one, sizeof(one)) < 0)
+			{} // the counter can't overflow here
+		for(auto& t : workers_)
+			t.join();
+		close_fds();
+		}
+
+	port_id add(int fd, handler_type handler)
+		{ // serve the port fd (not owned)
+		assert(fd >= 0 && handler);
+		const int flags = fcntl(fd, F_GETFL);
+		if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+			throw new std::runtime_error("unable to configure serial port");
+
+		auto p = std::make_shared<port>();
+		p->fd = fd;
+		p->handler = handler;
+		std::lock_guard<std::mutex> l(m_);
+		const port_id id = next_id_++;
+		p->id = id;
+		ports_[id] = p;
+		epoll_event ev = {};
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.u64 = id;
+		if(epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev) < 0)
+			{
+			ports_.erase(id);
+			throw new std::runtime_error("unable to register serial port");
+			}
+		return id;
+		}
+
+	template<typename Streambuf>
+	port_id add(Streambuf& buf, handler_type handler)
+		{ // serve the port of a streambuffer (e.g. unchecked_serialport_streambuf)
+		return add(buf.native_handle(), handler);
+		}
+
+	bool remove(port_id id)
+		{ // stop serving port id (the handler may still run once)
+		std::lock_guard<std::mutex> l(m_);
+		auto it = ports_.find(id);
+		if(it == ports_.end())
+			return false;
+		epoll_ctl(epoll_, EPOLL_CTL_DEL, it->second->fd, nullptr);
+		ports_.erase(it);
+		return true;
+		}
+
+	bool send(port_id id, const byte* data, std::size_t n)
+		{ // queue n bytes for port id (false: unknown or closed port)
+		assert(n == 0 || data);
+		auto p = find(id);
+		if(!p)
+			return false;
+		std::unique_lock<std::mutex> l(p->m);
+		if(p->closed)
+			return false;
+		p->tx.insert(p->tx.end(), data, data + n);
+		if(!p->busy)
+			{ // nobody serves the port: start right here
+			const bool ok = flush(*p);
+			if(ok && p->tx_pos < p->tx.size())
+				arm(*p); // wait for EPOLLOUT
+			notify_sent(*p, l, ok);
+			return ok;
+			}
+		return true;
+		}
+
+	bool when_sent(port_id id, std::function<void(bool)> done)
+		{ // call done(true) once the queued output of port id is sent (done(false): port closed)
+		assert(done);
+		auto p = find(id);
+		if(!p)
+			return false;
+		std::unique_lock<std::mutex> l(p->m);
+		if(p->closed)
+			return false;
+		p->sent.push_back(std::move(done));
+		if(!p->busy)
+			notify_sent(*p, l, true);
+		return true;
+		}
+
+	timer_id schedule(clock_type::time_point when, std::function<void()> fn)
+		{ // call fn on a worker thread at time when
+		assert(fn);
+		std::lock_guard<std::mutex> l(timer_m_);
+		const timer_id id = next_timer_id_++;
+		auto it = timers_.insert(std::make_pair(when, std::make_pair(id, std::move(fn))));
+		timer_index_[id] = it;
+		if(it == timers_.begin())
+			arm_timer(); // new earliest deadline
+		return id;
+		}
+
+	bool cancel(timer_id id)
+		{ // drop a timer, which did not run yet
+		std::lock_guard<std::mutex> l(timer_m_);
+		auto it = timer_index_.find(id);
+		if(it == timer_index_.end())
+			return false;
+		timers_.erase(it->second);
+		timer_index_.erase(it);
+		return true;
+		}
+
+	std::size_t size() const
+		{ // number of ports
+		std::lock_guard<std::mutex> l(m_);
+		return ports_.size();
+		}
+
+	std::size_t threads() const
+		{ // number of worker threads
+		return workers_.size();
+		}
+
+private:
+	struct port
+		{ // state of one serial port
+		port_id id = 0;
+		int fd = -1;
+		handler_type handler;
+		std::mutex m;              // guards the members below
+		std::vector<byte> tx;      // queued output
+		std::size_t tx_pos = 0;    // first unsent byte of tx
+		std::vector<std::function<void(bool)>> sent; // see when_sent
+		bool busy = false;         // a worker serves the port
+		bool again = false;        // another event arrived while busy
+		bool closed = false;
+		};
+
+	typedef std::multimap<clock_type::time_point, std::pair<timer_id, std::function<void()>>> timer_map;
+
+	static const port_id wakeup_id = ~0ULL;
+	static const port_id timer_event_id = ~0ULL - 1;
+
+	std::shared_ptr<port> find(port_id id) const
+		{ // port id (or null)
+		std::lock_guard<std::mutex> l(m_);
+		auto it = ports_.find(id);
+		return it == ports_.end() ? nullptr : it->second;
+		}
+
+	void arm(port& p)
+		{ // wait for the next event of p (p.m locked)
+		epoll_event ev = {};
+		ev.events = EPOLLIN | EPOLLONESHOT | (p.tx_pos < p.tx.size() ? static_cast<unsigned>(EPOLLOUT) : 0u);
+		ev.data.u64 = p.id;
+		epoll_ctl(epoll_, EPOLL_CTL_MOD, p.fd, &ev);
+		}
+
+	void notify_sent(port& p, std::unique_lock<std::mutex>& l, bool ok)
+		{ // call the when_sent callbacks if the output is sent (unlocks p.m)
+		std::vector<std::function<void(bool)>> done;
+		if(!ok || p.tx_pos == p.tx.size())
+			done.swap(p.sent);
+		l.unlock();
+		for(auto& fn : done)
+			fn(ok);
+		}
+
+	bool flush(port& p)
+		{ // send as much of the queued output as possible (p.m locked)
+		while(p.tx_pos < p.tx.size())
+			{
+			const ssize_t n = ::write(p.fd, &p.tx[p.tx_pos], p.tx.size() - p.tx_pos);
+			if(n > 0)
+				p.tx_pos += static_cast<std::size_t>(n);
+			else if(n < 0 && errno == EINTR)
+				continue;
+			else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				return true; // the rest goes out on EPOLLOUT
+			else
+				{ // write error
+				p.closed = true;
+				return false;
+				}
+			}
+		p.tx.clear();
+		p.tx_pos = 0;
+		return true;
+		}
+
+	void serve(port& p, byte* buffer)
+		{ // handle an event of p
+			{
+			std::lock_guard<std::mutex> l(p.m);
+			if(p.busy || p.closed)
+				{ // the serving worker takes care of it
+				p.again = true;
+				return;
+				}
+			p.busy = true;
+			}
+		for(;;)
+			{
+			// pass everything that was received to the handler (without holding the lock)
+			bool ok = true;
+			for(;;)
+				{
+				const ssize_t n = ::read(p.fd, buffer, SERIALPORT_MANAGER_READ_SIZE);
+				if(n > 0)
+					p.handler(p.id, buffer, static_cast<std::size_t>(n));
+				else if(n < 0 && errno == EINTR)
+					continue;
+				else
+					{ // n == 0 or EAGAIN: nothing left, anything else: failure
+					ok = (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) || (n == 0 && !hangup(p.fd));
+					break;
+					}
+				}
+
+			std::unique_lock<std::mutex> l(p.m);
+			if(ok)
+				ok = flush(p);
+			if(!ok)
+				{ // give up the port
+				p.closed = true;
+				p.busy = false;
+				epoll_ctl(epoll_, EPOLL_CTL_DEL, p.fd, nullptr);
+				notify_sent(p, l, false);
+				p.handler(p.id, nullptr, 0);
+				return;
+				}
+			if(p.again)
+				{
+				p.again = false;
+				continue;
+				}
+			p.busy = false;
+			arm(p);
+			notify_sent(p, l, true);
+			return;
+			}
+		}
+
+	void arm_timer()
+		{ // program the timerfd to the earliest deadline (timer_m_ locked)
+		itimerspec spec = {};
+		if(!timers_.empty())
+			{
+			auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				timers_.begin()->first.time_since_epoch()).count();
+			if(ns <= 0)
+				ns = 1; // zero would disarm the timer
+			spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+			spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+			}
+		timerfd_settime(timer_, TFD_TIMER_ABSTIME, &spec, nullptr);
+		}
+
+	void run_timers()
+		{ // run the expired timers
+		unsigned long long expirations;
+		if(read(timer_, &expirations, sizeof(expirations)) < 0)
+			{} // EAGAIN: the deadline was moved
+		std::vector<std::function<void()>> expired;
+			{
+			std::lock_guard<std::mutex> l(timer_m_);
+			const auto now = clock_type::now();
+			while(!timers_.empty() && timers_.begin()->first <= now)
+				{
+				expired.push_back(std::move(timers_.begin()->second.second));
+				timer_index_.erase(timers_.begin()->second.first);
+				timers_.erase(timers_.begin());
+				}
+			arm_timer();
+			}
+		epoll_event ev = {};
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.u64 = timer_event_id;
+		epoll_ctl(epoll_, EPOLL_CTL_MOD, timer_, &ev);
+		for(auto& fn : expired)
+			fn();
+		}
+
+	static bool hangup(int fd)
+		{ // a read returned 0: timeout (VMIN/VTIME) or closed port
+		pollfd pfd = {fd, 0, 0};
+		return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+		}
+
+	void work()
+		{ // worker thread
+		std::vector<byte> buffer(SERIALPORT_MANAGER_READ_SIZE);
+		epoll_event events[SERIALPORT_MANAGER_MAX_EVENTS];
+		while(!stop_.load())
+			{
+			const int n = epoll_wait(epoll_, events, SERIALPORT_MANAGER_MAX_EVENTS, -1);
+			if(n < 0 && errno != EINTR)
+				break;
+			for(int i=0; i<n; ++i)
+				{
+				if(events[i].data.u64 == wakeup_id)
+					continue; // shutdown
+				if(events[i].data.u64 == timer_event_id)
+					{
+					run_timers();
+					continue;
+					}
+				auto p = find(events[i].data.u64);
+				if(p)
+					serve(*p, &buffer.front());
+				}
+			}
+		}
+
+	void close_fds()
+		{ // close the epoll and the eventfd descriptor
+		if(epoll_ >= 0) ::close(epoll_);
+		if(wakeup_ >= 0) ::close(wakeup_);
+		if(timer_ >= 0) ::close(timer_);
+		}
+
+	int epoll_;  // event loop
+	int wakeup_; // eventfd to stop the workers
+	int timer_;  // timerfd (earliest deadline of timers_)
+	std::atomic<bool> stop_{false};
+
+	mutable std::mutex m_; // guards ports_ and next_id_
+	std::map<port_id, std::shared_ptr<port>> ports_;
+	port_id next_id_ = 0;
+
+	std::mutex timer_m_; // guards the timers
+	timer_map timers_;
+	std::map<timer_id, timer_map::iterator> timer_index_;
+	timer_id next_timer_id_ = 0;
+
+	std::vector<std::thread> workers_; // started last
+	};
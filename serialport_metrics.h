@@ -0,0 +1,231 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     auto buf = unchecked_serialport_streambuf("/dev/ttyUSB0");
+ *     ...
+ *     auto m = buf.metrics();  // snapshot of the counters and histograms
+ *     std::cout << m.flush_latency.p99 << " ns" << std::endl;
+ *     m.write_json(std::cout);
+ *
+ * Description:
+ *     this file contains the counters and latency histograms of the serialport streambuffer.
+ *     the histograms use log-linear buckets (like HdrHistogram): 32 buckets per power of two,
+ *     i.e. a relative error below 3%. recording is lock free, a snapshot summarizes them
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+
+struct latency_summary
+	{ // summary of a latency histogram (nanoseconds)
+	unsigned long long count = 0;
+	unsigned long long min = 0;
+	unsigned long long max = 0;
+	double mean = 0;
+	unsigned long long p50 = 0;
+	unsigned long long p90 = 0;
+	unsigned long long p99 = 0;
+	unsigned long long p999 = 0;
+
+	void write_json(std::ostream& os) const
+		{ // {"count": ..., "min_ns": ..., ...}
+		os << "{\"count\": " << count << ", \"min_ns\": " << min << ", \"max_ns\": " << max
+			<< ", \"mean_ns\": " << mean << ", \"p50_ns\": " << p50 << ", \"p90_ns\": " << p90
+			<< ", \"p99_ns\": " << p99 << ", \"p999_ns\": " << p999 << "}";
+		}
+	};
+
+class latency_histogram
+	{
+public:
+	// notice: values above 2^40 ns (18 minutes) are counted in the last bucket
+
+	enum {
+		sub_bits = 5,                         // 2^sub_bits buckets per power of two
+		sub_buckets = 1 << sub_bits,
+		max_bits = 40,                        // largest tracked value: 2^max_bits
+		buckets = (max_bits - sub_bits + 1) * sub_buckets
+		};
+
+	latency_histogram()
+		{ // construct empty histogram
+		reset();
+		}
+
+	// disable copy construction and copy assignment
+	latency_histogram(const latency_histogram&) = delete;
+	latency_histogram& operator = (const latency_histogram&) = delete;
+
+	void record(unsigned long long ns)
+		{ // count one value (thread safe)
+		counts_[index(ns)].fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(ns, std::memory_order_relaxed);
+		unsigned long long m = max_.load(std::memory_order_relaxed);
+		while(ns > m && !max_.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+			{}
+		m = min_.load(std::memory_order_relaxed);
+		while(ns < m && !min_.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+			{}
+		}
+
+	template<typename Rep, typename Period>
+	void record(std::chrono::duration<Rep, Period> d)
+		{ // count one duration (thread safe)
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+		record(static_cast<unsigned long long>(ns > 0 ? ns : 0));
+		}
+
+	latency_summary summary() const
+		{ // count, min, max, mean and percentiles (a snapshot)
+		latency_summary s;
+		unsigned long long counts[buckets];
+		for(int i=0; i<buckets; ++i)
+			{
+			counts[i] = counts_[i].load(std::memory_order_relaxed);
+			s.count += counts[i];
+			}
+		if(s.count == 0)
+			return s;
+		s.min = min_.load(std::memory_order_relaxed);
+		s.max = max_.load(std::memory_order_relaxed);
+		s.mean = double(sum_.load(std::memory_order_relaxed)) / double(s.count);
+		s.p50 = percentile(counts, s.count, 0.5);
+		s.p90 = percentile(counts, s.count, 0.9);
+		s.p99 = percentile(counts, s.count, 0.99);
+		s.p999 = percentile(counts, s.count, 0.999);
+		return s;
+		}
+
+	void reset()
+		{ // forget all values (not atomic with respect to concurrent records)
+		for(int i=0; i<buckets; ++i)
+			counts_[i].store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+		min_.store(~0ULL, std::memory_order_relaxed);
+		}
+
+private:
+	static int index(unsigned long long v)
+		{ // bucket of value v
+		if(v < 2*sub_buckets)
+			return static_cast<int>(v);
+		int msb = 63;
+		while(!(v >> msb))
+			--msb;
+		if(msb >= max_bits)
+			return buckets - 1;
+		const int shift = msb - sub_bits;
+		return shift*sub_buckets + static_cast<int>(v >> shift);
+		}
+
+	static unsigned long long upper_bound(int i)
+		{ // largest value of bucket i
+		if(i < 2*sub_buckets)
+			return static_cast<unsigned long long>(i);
+		const int shift = i/sub_buckets - 1;
+		const unsigned long long top = static_cast<unsigned long long>(i - shift*sub_buckets);
+		return ((top + 1) << shift) - 1;
+		}
+
+	unsigned long long percentile(const unsigned long long* counts, unsigned long long total, double p) const
+		{ // smallest bucket bound below which a fraction p of the values lies
+		const unsigned long long rank = static_cast<unsigned long long>(p*double(total - 1)) + 1;
+		unsigned long long seen = 0;
+		for(int i=0; i<buckets; ++i)
+			{
+			seen += counts[i];
+			if(seen >= rank)
+				{
+				const unsigned long long v = upper_bound(i);
+				const unsigned long long m = max_.load(std::memory_order_relaxed);
+				return v < m ? v : m;
+				}
+			}
+		return max_.load(std::memory_order_relaxed);
+		}
+
+	std::atomic<unsigned long long> counts_[buckets];
+	std::atomic<unsigned long long> sum_;
+	std::atomic<unsigned long long> max_;
+	std::atomic<unsigned long long> min_;
+	};
+
+
+struct serialport_metrics_snapshot
+	{ // counters and latencies of a streambuffer
+	unsigned long long bytes_in = 0;     // elements received
+	unsigned long long bytes_out = 0;    // elements sent
+	unsigned long long read_calls = 0;   // calls of the reading policy (about one system call each)
+	unsigned long long write_calls = 0;  // calls of the writing policy
+	unsigned long long timeouts = 0;     // reads which returned nothing
+	unsigned long long errors = 0;       // failed reads and writes
+	latency_summary flush_latency;       // time in the writing policy
+	latency_summary read_latency;        // time in the reading policy
+	latency_summary lock_wait;           // time waiting for the mutex of the streambuffer
+	latency_summary echo_rtt;            // round trip of a byte (echo checking writers only)
+
+	void write_json(std::ostream& os) const
+		{ // one json object
+		os << "{\"bytes_in\": " << bytes_in << ", \"bytes_out\": " << bytes_out
+			<< ", \"read_calls\": " << read_calls << ", \"write_calls\": " << write_calls
+			<< ", \"timeouts\": " << timeouts << ", \"errors\": " << errors;
+		os << ", \"flush_latency\": ";
+		flush_latency.write_json(os);
+		os << ", \"read_latency\": ";
+		read_latency.write_json(os);
+		os << ", \"lock_wait\": ";
+		lock_wait.write_json(os);
+		os << ", \"echo_rtt\": ";
+		echo_rtt.write_json(os);
+		os << "}";
+		}
+	};
+
+struct serialport_metrics
+	{ // live counters and histograms (thread safe)
+	typedef std::chrono::steady_clock clock_type;
+
+	std::atomic<unsigned long long> bytes_in{0};
+	std::atomic<unsigned long long> bytes_out{0};
+	std::atomic<unsigned long long> read_calls{0};
+	std::atomic<unsigned long long> write_calls{0};
+	std::atomic<unsigned long long> timeouts{0};
+	std::atomic<unsigned long long> errors{0};
+	latency_histogram flush_latency;
+	latency_histogram read_latency;
+	latency_histogram lock_wait;
+
+	serialport_metrics_snapshot snapshot() const
+		{ // copy of the current values
+		serialport_metrics_snapshot s;
+		s.bytes_in = bytes_in.load(std::memory_order_relaxed);
+		s.bytes_out = bytes_out.load(std::memory_order_relaxed);
+		s.read_calls = read_calls.load(std::memory_order_relaxed);
+		s.write_calls = write_calls.load(std::memory_order_relaxed);
+		s.timeouts = timeouts.load(std::memory_order_relaxed);
+		s.errors = errors.load(std::memory_order_relaxed);
+		s.flush_latency = flush_latency.summary();
+		s.read_latency = read_latency.summary();
+		s.lock_wait = lock_wait.summary();
+		return s;
+		}
+
+	void reset()
+		{ // start from zero
+		bytes_in.store(0);
+		bytes_out.store(0);
+		read_calls.store(0);
+		write_calls.store(0);
+		timeouts.store(0);
+		errors.store(0);
+		flush_latency.reset();
+		read_latency.reset();
+		lock_wait.reset();
+		}
+	};
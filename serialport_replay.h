@@ -0,0 +1,516 @@
+/* Author: Jannik Voss
+ *
+ * Example Usage:
+ *     // record the traffic of a real device
+ *     auto buf = recording_serialport_streambuf(serialport_record("/dev/ttyUSB0", "session.cap"), 19200);
+ *
+ *     // later: serve the capture to the parser under test (no hardware)
+ *     auto buf = replay_serialport_streambuf(serialport_replay("session.cap", serialport_replay_timing::fast));
+ *     auto s = std::basic_iostream<byte>(&buf);
+ *
+ * Description:
+ *     this file contains policies to record the traffic of a serialport streambuffer and to replay it.
+ *     the recording policies wrap the usual policies and tee every read and write into a capture
+ *     file (with timestamps). the replay policies serve the received data of a capture from a memory
+ *     mapped file: with the original timing, or as fast as possible (load tests of protocol parsers)
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <assert.h>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "serialport_streambuf.h"
+#include "mapped_file.h"
+
+
+/**
+ * CAPTURE FILE
+ *
+ * capture = magic "SPCAP\x01\r\n", records
+ * record  = kind (1: received, 2: sent), time (varint: ns since the previous record), size (varint), data
+ */
+
+enum serialport_capture_kind
+	{
+	serialport_capture_received = 1,
+	serialport_capture_sent = 2
+	};
+
+#define SERIALPORT_CAPTURE_MAGIC "SPCAP\x01\r\n"
+#define SERIALPORT_CAPTURE_MAGIC_SIZE 8
+
+class serialport_capture_writer
+	{
+public:
+	// notice: record may be called by several threads (e.g. full duplex streambuffers)
+
+	typedef filesys::mapped_file::char_type char_type;
+
+	// disable copy construction and copy assignment
+	serialport_capture_writer(const serialport_capture_writer&) = delete;
+	serialport_capture_writer& operator = (const serialport_capture_writer&) = delete;
+
+	explicit serialport_capture_writer(const char_type* path)
+		{ // create the capture file
+	  #ifdef _WIN32
+		file_ = _wfopen(path, L"wb");
+	  #else
+		file_ = std::fopen(path, "wb");
+	  #endif
+		if(file_ == nullptr)
+			throw new std::runtime_error("unable to create capture file");
+		std::setvbuf(file_, nullptr, _IOFBF, 64*1024);
+		std::fwrite(SERIALPORT_CAPTURE_MAGIC, 1, SERIALPORT_CAPTURE_MAGIC_SIZE, file_);
+		last_ = std::chrono::steady_clock::now();
+		}
+
+	~serialport_capture_writer()
+		{ // destruct (write the buffered records)
+		std::fclose(file_);
+		}
+
+	void record(serialport_capture_kind kind, const void* a, std::size_t na, const void* b = nullptr, std::size_t nb = 0)
+		{ // append one record (data: a followed by b)
+		assert((na == 0 || a != nullptr) && (nb == 0 || b != nullptr));
+		if(na + nb == 0)
+			return;
+		std::lock_guard<std::mutex> l(m_);
+		const auto now = std::chrono::steady_clock::now();
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+		last_ = now;
+
+		unsigned char header[1 + 2*10];
+		std::size_t len = 0;
+		header[len++] = static_cast<unsigned char>(kind);
+		len += put_varint(header + len, static_cast<unsigned long long>(ns > 0 ? ns : 0));
+		len += put_varint(header + len, na + nb);
+		std::fwrite(header, 1, len, file_);
+		std::fwrite(a, 1, na, file_);
+		if(nb > 0)
+			std::fwrite(b, 1, nb, file_);
+		}
+
+	void flush()
+		{ // pass the buffered records to the operating system
+		std::lock_guard<std::mutex> l(m_);
+		std::fflush(file_);
+		}
+
+private:
+	static std::size_t put_varint(unsigned char* p, unsigned long long v)
+		{ // 7 bits per byte, lowest first
+		std::size_t n = 0;
+		for(; v >= 0x80; v >>= 7)
+			p[n++] = static_cast<unsigned char>(v | 0x80);
+		p[n++] = static_cast<unsigned char>(v);
+		return n;
+		}
+
+	std::FILE* file_;
+	std::mutex m_; // guards the file and last_
+	std::chrono::steady_clock::time_point last_; // time of the previous record
+	};
+
+enum class serialport_replay_timing
+	{
+	original, // received data becomes available at the recorded time
+	fast      // all received data is available at once
+	};
+
+class serialport_capture_player
+	{
+public:
+	// notice: the data of received records is returned by read, sent records are skipped by it.
+	// notice: original timing: a write moves the clock to the time of the next sent record, so
+	//         answers keep their recorded delay after a request, even if the consumer is slower
+	// notice: at the end of the capture reads return nothing (like a timeout)
+
+	typedef filesys::mapped_file::char_type char_type;
+	typedef std::chrono::steady_clock clock_type;
+
+	// disable copy construction and copy assignment
+	serialport_capture_player(const serialport_capture_player&) = delete;
+	serialport_capture_player& operator = (const serialport_capture_player&) = delete;
+
+	serialport_capture_player(const char_type* path, serialport_replay_timing timing)
+		: file_(path)
+		, timing_(timing)
+		{ // map the capture file
+		if(!file_.is_open() || file_.size() < SERIALPORT_CAPTURE_MAGIC_SIZE
+				|| std::char_traits<char>::compare(reinterpret_cast<const char*>(file_.data()),
+					SERIALPORT_CAPTURE_MAGIC, SERIALPORT_CAPTURE_MAGIC_SIZE) != 0)
+			throw new std::runtime_error("invalid capture file");
+		rx_.p = tx_.p = file_.data() + SERIALPORT_CAPTURE_MAGIC_SIZE;
+		next(rx_, serialport_capture_received);
+		next(tx_, serialport_capture_sent);
+		}
+
+	bool read(byte* buffer, std::size_t num, std::size_t* num_read,
+			std::chrono::milliseconds timeout = std::chrono::milliseconds(SERIALPORT_DEFAULT_TIMEOUT_MS))
+		{ // copy up to num received bytes, wait for the first one at most timeout (original timing)
+		std::unique_lock<std::mutex> l(m_);
+		*num_read = 0;
+		if(!wait_due(l, timeout))
+			return true;
+		const auto now = clock_type::now();
+		while(*num_read < num && rx_.data != nullptr
+				&& (timing_ == serialport_replay_timing::fast || due_time(rx_) <= now))
+			{ // copy the due records
+			std::size_t n = num - *num_read;
+			if(n > rx_.left)
+				n = rx_.left;
+			std::char_traits<byte>::copy(buffer + *num_read, rx_.data, n);
+			*num_read += n;
+			rx_.data += n;
+			rx_.left -= n;
+			if(rx_.left == 0)
+				next(rx_, serialport_capture_received);
+			}
+		received_ += *num_read;
+		return !corrupt_ || *num_read > 0;
+		}
+
+	void wait(std::chrono::milliseconds timeout = std::chrono::milliseconds(SERIALPORT_DEFAULT_TIMEOUT_MS))
+		{ // wait until received data is due, at most timeout (original timing). a read won't block then
+		std::unique_lock<std::mutex> l(m_);
+		wait_due(l, timeout);
+		}
+
+	void write(const byte*, std::size_t num)
+		{ // the consumer sent num bytes (discarded)
+		std::lock_guard<std::mutex> l(m_);
+		start();
+		written_ += num;
+		if(timing_ != serialport_replay_timing::original || tx_.data == nullptr)
+			return;
+		start_ = clock_type::now() - std::chrono::duration_cast<clock_type::duration>(
+			std::chrono::nanoseconds(tx_.time));
+		tx_.data = nullptr;
+		next(tx_, serialport_capture_sent);
+		cv_.notify_all();
+		}
+
+	std::size_t pending()
+		{ // received bytes, which are due and not read yet (current record)
+		std::lock_guard<std::mutex> l(m_);
+		if(rx_.data == nullptr)
+			return 0;
+		if(timing_ == serialport_replay_timing::original && (!started_ || due_time(rx_) > clock_type::now()))
+			return 0;
+		return rx_.left;
+		}
+
+	unsigned long long received() const { std::lock_guard<std::mutex> l(m_); return received_; } // bytes read
+	unsigned long long written() const { std::lock_guard<std::mutex> l(m_); return written_; }   // bytes written
+	bool corrupt() const { std::lock_guard<std::mutex> l(m_); return corrupt_; } // capture ended in a damaged record
+
+private:
+	struct cursor
+		{ // position in the capture
+		const byte* p = nullptr;       // next record
+		unsigned long long time = 0;   // ns since the start of the capture (current record)
+		const byte* data = nullptr;    // unread data of the current record (nullptr: end)
+		std::size_t left = 0;
+		};
+
+	void next(cursor& c, serialport_capture_kind kind)
+		{ // move c to the next record of kind
+		const byte* end = file_.data() + file_.size();
+		c.data = nullptr;
+		c.left = 0;
+		while(c.p < end)
+			{
+			const byte k = *c.p++;
+			unsigned long long delta = 0, size = 0;
+			if(!get_varint(c.p, end, delta) || !get_varint(c.p, end, size)
+					|| size > static_cast<unsigned long long>(end - c.p)
+					|| (k != serialport_capture_received && k != serialport_capture_sent))
+				{ // damaged record: stop here
+				corrupt_ = true;
+				c.p = end;
+				return;
+				}
+			c.time += delta;
+			const byte* data = c.p;
+			c.p += size;
+			if(k == kind && size > 0)
+				{
+				c.data = data;
+				c.left = static_cast<std::size_t>(size);
+				return;
+				}
+			}
+		}
+
+	static bool get_varint(const byte*& p, const byte* end, unsigned long long& v)
+		{ // 7 bits per byte, lowest first
+		v = 0;
+		for(int shift=0; p < end && shift < 64; shift += 7)
+			{
+			const byte b = *p++;
+			v |= static_cast<unsigned long long>(b & 0x7F) << shift;
+			if(!(b & 0x80))
+				return true;
+			}
+		return false;
+		}
+
+	bool wait_due(std::unique_lock<std::mutex>& l, std::chrono::milliseconds timeout)
+		{ // wait until the current received record is due (false: timeout)
+		start();
+		const auto deadline = clock_type::now() + timeout;
+		while(rx_.data != nullptr && timing_ == serialport_replay_timing::original)
+			{ // wait until the record is due
+			const auto due = due_time(rx_);
+			if(due <= clock_type::now())
+				break;
+			if(due > deadline)
+				{ // not within the timeout
+				if(cv_.wait_until(l, deadline) == std::cv_status::timeout)
+					return false;
+				}
+			else
+				cv_.wait_until(l, due); // a write may move the clock
+			}
+		return true;
+		}
+
+	void start()
+		{ // the clock starts with the first access (m_ locked)
+		if(started_)
+			return;
+		start_ = clock_type::now();
+		started_ = true;
+		}
+
+	clock_type::time_point due_time(const cursor& c) const
+		{ // time at which the current record of c is due
+		return start_ + std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(c.time));
+		}
+
+	filesys::mapped_file file_;
+	serialport_replay_timing timing_;
+
+	mutable std::mutex m_; // guards the members below
+	std::condition_variable cv_; // the clock moved
+	cursor rx_; // next received data
+	cursor tx_; // next sent record (original timing)
+	clock_type::time_point start_;
+	bool started_ = false;
+	bool corrupt_ = false;
+	unsigned long long received_ = 0;
+	unsigned long long written_ = 0;
+	};
+
+
+/**
+ * POLICY CLASSES
+ *
+ * recording: wrap the writer, reader, deleter and initializer of a port
+ * replay: serve a capture instead of a port
+ */
+
+struct serialport_recording_target
+	{ // port name and capture file of a recording streambuffer
+	const filesys::mapped_file::char_type* port;
+	const filesys::mapped_file::char_type* capture;
+	};
+
+inline serialport_recording_target serialport_record(const filesys::mapped_file::char_type* port,
+		const filesys::mapped_file::char_type* capture)
+	{ // use as port name of a recording streambuffer
+	return serialport_recording_target{port, capture};
+	}
+
+template<typename Handle>
+	struct serialport_recording_handle
+	{ // handle of a recording streambuffer
+	Handle port;
+	serialport_capture_writer* capture; // owned by the initializer
+	};
+
+template<typename Writer, // sends the data
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_recording_writer
+	{ // function object: provide write function, which records the sent data
+	template<typename Handle>
+	void operator () (serialport_recording_handle<Handle> serial_port, const T* buffer, std::size_t num)
+		{
+		raw_(serial_port.port, buffer, num);
+		serial_port.capture->record(serialport_capture_sent, buffer, num*sizeof(T));
+		}
+
+	template<typename Handle>
+	void operator () (serialport_recording_handle<Handle> serial_port, const T* a, std::size_t na, const T* b, std::size_t nb)
+		{ // gather write (one record)
+		serialport_gather_write(raw_, serial_port.port, a, na, b, nb, 0);
+		serial_port.capture->record(serialport_capture_sent, a, na*sizeof(T), b, nb*sizeof(T));
+		}
+
+	Writer raw_;
+	};
+
+template<typename Reader, // receives the data
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_recording_reader
+	{ // function object: provide read function, which records the received data
+	template<typename Handle>
+	bool operator () (serialport_recording_handle<Handle> serial_port, T* buffer, std::size_t num, std::size_t* num_read)
+		{
+		const bool ok = raw_(serial_port.port, buffer, num, num_read);
+		if(*num_read > 0)
+			serial_port.capture->record(serialport_capture_received, buffer, *num_read*sizeof(T));
+		return ok;
+		}
+
+	template<typename Handle>
+	std::size_t pending(serialport_recording_handle<Handle> serial_port)
+		{ // elements waiting in the driver's input queue
+		return static_cast<std::size_t>(serialport_pending(raw_, serial_port.port, 0));
+		}
+
+	Reader raw_;
+	};
+
+template<typename Deleter, // closes the port
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_recording_deleter
+	{ // function object: provide custom deleter (the capture is closed by the initializer)
+	template<typename Handle>
+	void operator () (serialport_recording_handle<Handle>* serial_port)
+		{
+		Deleter d;
+		d(&serial_port->port);
+		}
+	};
+
+template<typename Initializer, // opens the port
+			typename T, typename Traits = std::char_traits<T>>
+	struct p_recording_initializer
+	{ // provide initializer, which creates the capture file and opens the port
+	// please notice that this policy isn't a function object! it owns the capture file
+	template<typename Handle>
+	p_recording_initializer(serialport_recording_handle<Handle>* serial_port,
+			const serialport_recording_target& target, std::size_t baud_rate=SERIALPORT_DEFAULT_BAUDRATE)
+		: capture_(new serialport_capture_writer(target.capture))
+		, init_(&serial_port->port, target.port, baud_rate)
+		{
+		serial_port->capture = capture_.get();
+		}
+
+	std::unique_ptr<serialport_capture_writer> capture_; // closed last (after the port)
+	Initializer init_;
+	};
+
+
+struct serialport_replay_source
+	{ // capture file and timing of a replay streambuffer
+	const filesys::mapped_file::char_type* capture;
+	serialport_replay_timing timing;
+	};
+
+inline serialport_replay_source serialport_replay(const filesys::mapped_file::char_type* capture,
+		serialport_replay_timing timing = serialport_replay_timing::original)
+	{ // use as port name of a replay streambuffer
+	return serialport_replay_source{capture, timing};
+	}
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_replay_writer
+	{ // function object: provide write function, which discards the data
+	static_assert(sizeof(T) == 1, "character type has to be byte sized");
+
+	void operator () (serialport_capture_player* serial_port, const T* buffer, std::size_t num)
+		{
+		assert(buffer!=nullptr); // make sure that the buffer exists
+		serial_port->write(reinterpret_cast<const byte*>(buffer), num);
+		}
+	};
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_replay_reader
+	{ // function object: provide read function, which serves the received data of the capture
+	// notice: the streambuffer calls wait without holding its mutex, thus a write can move the
+	//         clock of the player meanwhile. the read after it does not block
+
+	static_assert(sizeof(T) == 1, "character type has to be byte sized");
+
+	bool operator () (serialport_capture_player* serial_port, T* buffer, std::size_t num, std::size_t* num_read)
+		{
+		if(!waited_)
+			return serial_port->read(reinterpret_cast<byte*>(buffer), num, num_read);
+		waited_ = false;
+		return serial_port->read(reinterpret_cast<byte*>(buffer), num, num_read, std::chrono::milliseconds(0));
+		}
+
+	void wait(serialport_capture_player* serial_port)
+		{ // wait for due data (streambuffer unlocked)
+		serial_port->wait();
+		waited_ = true;
+		}
+
+	std::size_t pending(serialport_capture_player* serial_port)
+		{ // received bytes, which are due
+		return serial_port->pending();
+		}
+
+private:
+	bool waited_ = false; // the next read must not block
+	};
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_replay_deleter
+	{ // function object: provide custom deleter for capture players
+	void operator () (serialport_capture_player** serial_port)
+		{
+		delete *serial_port;
+		*serial_port = nullptr;
+		}
+	};
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_replay_initializer
+	{ // provide initializer, which maps the capture file (the baudrate is ignored)
+	p_replay_initializer(serialport_capture_player** serial_port, const serialport_replay_source& source,
+			std::size_t = SERIALPORT_DEFAULT_BAUDRATE)
+		{
+		*serial_port = new serialport_capture_player(source.capture, source.timing);
+		}
+	};
+
+
+#ifdef _WIN32
+
+// recording stream-buffer: the traffic of the port is written to a capture file
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, serialport_recording_handle<HANDLE>,
+		p_recording_writer<p_winapi_file_writer<byte>, byte>,         // writing policy
+		p_recording_reader<p_winapi_file_reader<byte>, byte>,         // reading policy
+		p_recording_deleter<p_winapi_file_deleter<byte>, byte>,       // deleting policy
+		p_recording_initializer<p_serialport_initializer<byte>, byte>> // initalizing policy
+	recording_serialport_streambuf;
+
+#else // POSIX
+
+// recording stream-buffer: the traffic of the port is written to a capture file
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, serialport_recording_handle<int>,
+		p_recording_writer<p_posix_fd_writer<byte>, byte>,                  // writing policy
+		p_recording_reader<p_posix_fd_reader<byte>, byte>,                  // reading policy
+		p_recording_deleter<p_posix_fd_deleter<byte>, byte>,                // deleting policy
+		p_recording_initializer<p_posix_serialport_initializer<byte>, byte>> // initalizing policy
+	recording_serialport_streambuf;
+
+#endif // _WIN32
+
+// replay stream-buffer: serves the received data of a capture file, writes are discarded
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, serialport_capture_player*,
+		p_replay_writer<byte>,       // writing policy
+		p_replay_reader<byte>,       // reading policy
+		p_replay_deleter<byte>,      // deleting policy
+		p_replay_initializer<byte>>  // initalizing policy
+	replay_serialport_streambuf;
@@ -1,7 +1,8 @@
 /* Author: Jannik Voss
  *
  * Example Usage:
- *     auto buf = unchecked_serialport_streambuf(L"COM3");  // open serial port
+ *     auto buf = unchecked_serialport_streambuf(L"COM3");  // open serial port (windows)
+ *     auto buf = unchecked_serialport_streambuf("/dev/ttyUSB0");  // open serial port (posix)
  *     auto s = std::basic_iostream<byte>(&buf);  // pass buffer to an io-stream
  *     s << byte('E') << std::flush;  // send 'E' over the wire
  *
@@ -16,16 +17,38 @@
 #include <vector>
 #include <streambuf>
 #include <functional>
-#include <Windows.h>
 #include <assert.h>
-#include <array>
 #include <thread>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <stdexcept>
 #include <iostream>
+#include "spsc_ring_buffer.h"
+#include "serialport_metrics.h"
+
+#ifdef _WIN32
+  #include <Windows.h>
+#else
+  #include <cerrno>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <termios.h>
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/uio.h>
+#endif
 
 typedef unsigned char byte; // 1 byte = 8 bits*/
 
 
 #define SERIALPORT_DEFAULT_BAUDRATE 19200 // default baudrate for serialport communication
+#define SERIALPORT_DEFAULT_INPUT_BUFSIZE 4096 // default size of the input buffer
+#define SERIALPORT_DEFAULT_OUTPUT_BUFSIZE 4096 // default size of the output buffer (larger writes bypass it)
+#define SERIALPORT_DEFAULT_RING_SIZE (64*1024) // default size of each ring buffer (full duplex mode)
+#define SERIALPORT_DEFAULT_TIMEOUT_MS 1000 // default time underflow waits for input (full duplex mode)
+#define SERIALPORT_MAX_READ_BACKOFF_MS 100 // longest pause after empty reads which did not block (full duplex mode)
 
 // nulltype is used as a placeholder-type to indicate that a
 // template parameter is not used in a specific scenario
@@ -37,28 +60,160 @@ class nulltype {}; // placeholder type
  *
  * these policy classes encapsulate certain tasks and represent
  * building blocks for the stream-buffer classes defined below.
+ *
+ * reader policies read up to num elements. they return as soon as at least one element
+ * is available (or after a timeout with *num_read == 0). optionally they provide
+ * 'pending(handle)', the number of elements waiting in the driver queue.
  */
 
-template<typename T, typename Traits = std::char_traits<T>>
-	struct p_winapi_file_writer
-	{ // function object: provide write function for file-handles
-	void operator () (HANDLE serial_port, const T* buffer, std::size_t num)
+// call reader.pending(handle) if the reader policy provides it (otherwise: 0, no information)
+template<typename Reader, typename Handle>
+	auto serialport_pending(Reader& r, Handle h, int) -> decltype(std::streamsize(r.pending(h)))
+	{
+	return std::streamsize(r.pending(h));
+	}
+
+template<typename Reader, typename Handle>
+	std::streamsize serialport_pending(Reader&, Handle, long)
+	{
+	return 0;
+	}
+
+// let the reader policy wait for input without the mutex (if it provides wait, e.g. p_replay_reader),
+// a write may be needed to make the input due
+template<typename Reader, typename Handle, typename Lock>
+	auto serialport_wait(Reader& r, Handle h, Lock& l, int) -> decltype(void(r.wait(h)))
+	{
+	l.unlock();
+	r.wait(h);
+	l.lock();
+	}
+
+template<typename Reader, typename Handle, typename Lock>
+	void serialport_wait(Reader&, Handle, Lock&, long)
+	{
+	}
+
+// echo round trip times of the writer policy (if it measures them, e.g. p_pipelined_echo_writer)
+template<typename Writer>
+	auto serialport_echo_rtt(const Writer& w, int) -> decltype(w.echo_rtt.summary())
+	{
+	return w.echo_rtt.summary();
+	}
+
+template<typename Writer>
+	latency_summary serialport_echo_rtt(const Writer&, long)
+	{
+	return latency_summary();
+	}
+
+template<typename Writer>
+	auto serialport_echo_rtt_reset(Writer& w, int) -> decltype(w.echo_rtt.reset())
+	{
+	w.echo_rtt.reset();
+	}
+
+template<typename Writer>
+	void serialport_echo_rtt_reset(Writer&, long)
+	{
+	}
+
+// call writer(handle, a, na, b, nb) if the writer policy can send two buffers at once (otherwise: two calls)
+template<typename Writer, typename Handle, typename T>
+	auto serialport_gather_write(Writer& w, Handle h, const T* a, std::size_t na, const T* b, std::size_t nb, int)
+		-> decltype(w(h, a, na, b, nb), void())
+	{
+	w(h, a, na, b, nb);
+	}
+
+template<typename Writer, typename Handle, typename T>
+	void serialport_gather_write(Writer& w, Handle h, const T* a, std::size_t na, const T* b, std::size_t nb, long)
+	{
+	if(na > 0)
+		w(h, a, na);
+	if(nb > 0)
+		w(h, b, nb);
+	}
+
+template<template<class,class> class RawWriter,    // writes the bytes to the port
+			template<class,class> class Reader,    // reads the echoes (blocking, with timeout)
+			typename T, typename Traits = std::char_traits<T>,
+			std::size_t Window = 16,              // bytes in flight (should fit into the device's fifo)
+			unsigned MaxRetries = 8>              // retransmissions without progress before giving up
+	struct p_pipelined_echo_writer
+	{ // function object: provide write function with echo verification
+	// the device echoes every byte (bytes with the highest bit set: inverted).
+	// up to Window bytes are written before their echoes arrive. the echoes are matched
+	// against the window as they come in. on a mismatch or a timeout, everything from the
+	// first unconfirmed byte on is sent again. waiting for echoes blocks in the reader.
+	typedef std::chrono::steady_clock clock_type;
+
+	latency_histogram echo_rtt; // time from sending a byte to its valid echo
+
+	template<typename Handle>
+	void operator () (Handle serial_port, const T* buffer, std::size_t num)
 		{
 		assert(buffer!=nullptr); // make sure that the buffer exists
-		std::size_t num_send = 0; // number of bytes which where already send
-		while(num_send < num) // all bytes send?
-			{ // send one byte at a time
-			DWORD num_written = 0; // output variable for WriteFile
-			if(WriteFile(serial_port, &buffer[num_send], num, &num_written, NULL) != 0) // try to write a few bytes
-				num_send += num_written; // update status
-			else // WriteFile failed
-				throw new std::runtime_error("unable to send data");
+		RawWriter<T,Traits> w;
+		Reader<T,Traits> r;
+		std::size_t num_acked = 0; // number of bytes with a valid echo
+		std::size_t num_send = 0;  // number of bytes which where already send
+		unsigned retries = 0;
+		T echo[Window];
+		clock_type::time_point sent_at[Window]; // send time of the bytes in flight
+		while(num_acked < num) // all bytes confirmed?
+			{
+			if(num_send < num && num_send - num_acked < Window)
+				{ // fill the window
+				std::size_t n = Window - (num_send - num_acked);
+				if(n > num - num_send)
+					n = num - num_send;
+				const auto now = clock_type::now();
+				for(std::size_t k=0; k<n; ++k)
+					sent_at[(num_send + k)%Window] = now;
+				w(serial_port, &buffer[num_send], n);
+				num_send += n;
+				}
+
+			// wait for echoes of the bytes in flight
+			std::size_t num_read = 0;
+			if(!r(serial_port, echo, num_send - num_acked, &num_read))
+				throw new std::runtime_error("unable to receive echo");
+			const auto received = clock_type::now();
+
+			std::size_t i = 0;
+			while(i < num_read && echo[i] == expected_echo(buffer[num_acked]))
+				{ // received valid echo
+				echo_rtt.record(received - sent_at[num_acked%Window]);
+				++i;
+				++num_acked;
+				}
+			if(i > 0)
+				retries = 0; // progress
+
+			if(num_read == 0 || i < num_read)
+				{ // timeout or mismatch: resend everything after the last confirmed byte
+				if(++retries > MaxRetries)
+					throw new std::runtime_error("no valid echo");
+				// the echoes of the remaining bytes in flight are stale. drop them
+				std::size_t stale = num_send - num_acked - (num_read - i);
+				while(stale > 0 && r(serial_port, echo, stale < Window ? stale : Window, &num_read) && num_read > 0)
+					stale -= num_read < stale ? num_read : stale;
+				num_send = num_acked;
+				}
 			}
 		}
+
+	static T expected_echo(T ch)
+		{ // echo of ch
+		return (ch&0b10000000)>0 ? static_cast<T>(~ch) : ch;
+		}
 	};
 
-template<template<class,class> typename Reader, typename T, typename Traits = std::char_traits<T>>
-	struct p_winapi_file_writer_with_echo
+#ifdef _WIN32
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_winapi_file_writer
 	{ // function object: provide write function for file-handles
 	void operator () (HANDLE serial_port, const T* buffer, std::size_t num)
 		{
@@ -67,34 +222,45 @@ template<template<class,class> typename Reader, typename T, typename Traits = st
 		while(num_send < num) // all bytes send?
 			{ // send one byte at a time
 			DWORD num_written = 0; // output variable for WriteFile
-			if(WriteFile(serial_port, &buffer[num_send], 1/*send only one at a time*/, &num_written, NULL) == FALSE) // try to write a few bytes
-				throw new std::runtime_error("unable to send data"); // WriteFile failed
-
-			// wait for echo
-			T required_echo = (buffer[num_send]&0b10000000)>0 ? ~(buffer[num_send]) : buffer[num_send];
-			Reader<T,Traits> r;
-			auto start_ts = std::chrono::steady_clock::now();
-			while(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_ts) < std::chrono::milliseconds(1000))
-				{ // "infinite loop". timeout after 1 second
-				DWORD num_read;
-				T read;
-				if(r(serial_port, &read, 1, &num_read) && num_read==1 && read == required_echo)
-					{ // received valid echo
-					num_send += num_written; // update number of bytes send
-					break;
-					}
-				}
+			if(WriteFile(serial_port, &buffer[num_send], static_cast<DWORD>(num - num_send), &num_written, NULL) != 0) // try to write a few bytes
+				num_send += num_written; // update status
+			else // WriteFile failed
+				throw new std::runtime_error("unable to send data");
 			}
 		}
 	};
 
+// old name of the echo checking writer (now pipelined, see p_pipelined_echo_writer)
+template<template<class,class> class Reader, typename T, typename Traits = std::char_traits<T>>
+	using p_winapi_file_writer_with_echo = p_pipelined_echo_writer<p_winapi_file_writer, Reader, T, Traits>;
+
 template<typename T, typename Traits = std::char_traits<T>>
 	struct p_winapi_file_reader
 	{ // function object: provide read function for file-handles
-	bool operator () (HANDLE serial_port, T* buffer, std::size_t num, DWORD* num_read)
+	bool operator () (HANDLE serial_port, T* buffer, std::size_t num, std::size_t* num_read)
 		{
+		// ReadFile waits until all requested bytes arrived (or a timeout).
+		// thus only request what is already there (at least one byte)
+		std::size_t avail = pending(serial_port);
+		if(avail == 0)
+			avail = 1;
+		if(num > avail)
+			num = avail;
+
 		// receive new data and store it in the buffer
-		return (ReadFile(serial_port, buffer, num, num_read, NULL) != FALSE);
+		DWORD n = 0;
+		const bool ok = (ReadFile(serial_port, buffer, static_cast<DWORD>(num*sizeof(T)), &n, NULL) != FALSE);
+		*num_read = n/sizeof(T);
+		return ok;
+		}
+
+	std::size_t pending(HANDLE serial_port)
+		{ // number of elements in the driver's input queue
+		DWORD errors = 0;
+		COMSTAT stat;
+		if(!ClearCommError(serial_port, &errors, &stat))
+			return 0;
+		return stat.cbInQue/sizeof(T);
 		}
 	};
 
@@ -164,6 +330,234 @@ template<typename T, typename Traits = std::char_traits<T>>
 		}
 	};
 
+#else // POSIX
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_posix_fd_writer
+	{ // function object: provide write function for file descriptors
+	void operator () (int serial_port, const T* buffer, std::size_t num)
+		{
+		assert(buffer!=nullptr); // make sure that the buffer exists
+		const char* p = reinterpret_cast<const char*>(buffer);
+		std::size_t left = num*sizeof(T); // number of bytes which still have to be send
+		while(left > 0)
+			{
+			ssize_t n = ::write(serial_port, p, left); // try to write a few bytes
+			if(n > 0)
+				{ // update status
+				p += n;
+				left -= static_cast<std::size_t>(n);
+				}
+			else if(n < 0 && errno == EAGAIN)
+				{ // non-blocking descriptor: wait until it is writable again
+				pollfd pfd = {serial_port, POLLOUT, 0};
+				::poll(&pfd, 1, 1000);
+				}
+			else if(n < 0 && errno != EINTR) // write failed
+				throw new std::runtime_error("unable to send data");
+			}
+		}
+
+	void operator () (int serial_port, const T* a, std::size_t na, const T* b, std::size_t nb)
+		{ // gather write: send a and b with one system call (writev)
+		assert((na == 0 || a != nullptr) && (nb == 0 || b != nullptr));
+		iovec iov[2] = {
+			{const_cast<T*>(a), na*sizeof(T)},
+			{const_cast<T*>(b), nb*sizeof(T)}};
+		iovec* v = iov;
+		int cnt = 2;
+		while(cnt > 0)
+			{
+			if(v->iov_len == 0)
+				{ // buffer done
+				++v;
+				--cnt;
+				continue;
+				}
+			ssize_t n = ::writev(serial_port, v, cnt); // try to write a few bytes
+			if(n > 0)
+				{ // update status
+				std::size_t done = static_cast<std::size_t>(n);
+				for(; cnt > 0 && done >= v->iov_len; ++v, --cnt)
+					done -= v->iov_len;
+				if(cnt > 0)
+					{
+					v->iov_base = static_cast<char*>(v->iov_base) + done;
+					v->iov_len -= done;
+					}
+				}
+			else if(n < 0 && errno == EAGAIN)
+				{ // non-blocking descriptor: wait until it is writable again
+				pollfd pfd = {serial_port, POLLOUT, 0};
+				::poll(&pfd, 1, 1000);
+				}
+			else if(n < 0 && errno != EINTR) // write failed
+				throw new std::runtime_error("unable to send data");
+			}
+		}
+	};
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_posix_fd_reader
+	{ // function object: provide read function for file descriptors
+	// the call blocks according to VMIN/VTIME (see p_posix_serialport_initializer)
+	bool operator () (int serial_port, T* buffer, std::size_t num, std::size_t* num_read)
+		{
+		// receive new data and store it in the buffer
+		ssize_t n;
+		do  {
+			n = ::read(serial_port, buffer, num*sizeof(T));
+			} while(n < 0 && errno == EINTR);
+		*num_read = n > 0 ? static_cast<std::size_t>(n)/sizeof(T) : 0;
+		return (n >= 0 || errno == EAGAIN);
+		}
+
+	std::size_t pending(int serial_port)
+		{ // number of elements in the driver's input queue
+		int n = 0;
+		if(ioctl(serial_port, FIONREAD, &n) != 0 || n < 0)
+			return 0;
+		return static_cast<std::size_t>(n)/sizeof(T);
+		}
+	};
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_posix_fd_deleter
+	{ // function object: provide custom deleter for file descriptors
+	void operator () (int* serial_port)
+		{
+		if(*serial_port >= 0)
+			{ // if descriptor is valid
+			::close(*serial_port); // close the descriptor
+			*serial_port = -1; // invalidate descriptor
+			}
+		}
+	};
+
+#if defined(__linux__) && !defined(__powerpc__) && !defined(__mips__) && !defined(__sparc__) && !defined(__alpha__)
+  #define SERIALPORT_HAS_TERMIOS2 // arbitrary baudrates (linux, generic termios layout)
+
+// struct termios2 of the kernel. <asm/termbits.h> can't be included together with <termios.h>
+struct serialport_termios2
+	{
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+	};
+#endif
+
+template<typename T, typename Traits = std::char_traits<T>>
+	struct p_posix_serialport_initializer
+	{ // provide initializer for serial ports (termios, raw mode)
+	// please notice that this policy isn't a function object!
+	// instead it has the ability to store data and thus should be stored as a member of the streambuffer
+	p_posix_serialport_initializer(int* serial_port, const char* port_name, std::size_t baud_rate=SERIALPORT_DEFAULT_BAUDRATE)
+		{
+		// open without waiting for the carrier (CLOCAL isn't set yet)
+		*serial_port = ::open(port_name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		if(*serial_port < 0) // failure?
+			 throw new std::runtime_error("invalid handle");
+
+		try {
+			termios config; // configuration struct
+			if(tcgetattr(*serial_port, &config) != 0) // retrieve current configuration
+				throw new std::runtime_error("unable to retrieve configuration");
+
+			cfmakeraw(&config); // no echo, no line editing, no character translation
+			config.c_cflag |= CLOCAL | CREAD; // ignore modem lines, enable receiver
+			config.c_cflag &= ~(CSIZE | PARENB | CSTOPB);
+			config.c_cflag |= CS8;           // 8bits per byte, disable parity, use one stop bit
+		  #ifdef CRTSCTS
+			config.c_cflag &= ~CRTSCTS;      // no hardware flow control
+		  #endif
+
+			// after one second it can be assumed that there is a problem with the connection
+			config.c_cc[VMIN] = 0;
+			config.c_cc[VTIME] = 10;
+
+			const speed_t speed = baud_constant(baud_rate);
+			if(speed != 0)
+				{ // standard baudrate
+				cfsetispeed(&config, speed);
+				cfsetospeed(&config, speed);
+				}
+			if(tcsetattr(*serial_port, TCSANOW, &config) != 0) // set configuration
+				throw new std::runtime_error("unable to change the configuration");
+			if(speed == 0)
+				set_custom_baudrate(*serial_port, baud_rate);
+
+			// back to blocking mode (reads are controlled by VMIN/VTIME)
+			const int flags = fcntl(*serial_port, F_GETFL);
+			if(flags < 0 || fcntl(*serial_port, F_SETFL, flags & ~O_NONBLOCK) != 0)
+				throw new std::runtime_error("unable to change the configuration");
+			tcflush(*serial_port, TCIOFLUSH); // discard stale data
+		}catch(...){
+			::close(*serial_port);
+			*serial_port = -1;
+			throw;
+		}
+		}
+
+	static void set_read_timeout(int serial_port, cc_t vmin, cc_t vtime)
+		{ // tune blocking reads: return after vmin bytes or vtime/10 seconds of silence
+		termios config;
+		if(tcgetattr(serial_port, &config) != 0)
+			throw new std::runtime_error("unable to retrieve configuration");
+		config.c_cc[VMIN] = vmin;
+		config.c_cc[VTIME] = vtime;
+		if(tcsetattr(serial_port, TCSANOW, &config) != 0)
+			throw new std::runtime_error("unable to change the configuration");
+		}
+
+	static void set_custom_baudrate(int serial_port, std::size_t baud_rate)
+		{ // set a baudrate which has no B... constant
+	  #ifdef SERIALPORT_HAS_TERMIOS2
+		serialport_termios2 config;
+		if(ioctl(serial_port, _IOR('T', 0x2A, serialport_termios2) /*TCGETS2*/, &config) != 0)
+			throw new std::runtime_error("unable to retrieve configuration");
+		config.c_cflag &= ~static_cast<tcflag_t>(0010017); // CBAUD
+		config.c_cflag |= 0010000;                         // BOTHER
+		config.c_ispeed = static_cast<speed_t>(baud_rate);
+		config.c_ospeed = static_cast<speed_t>(baud_rate);
+		if(ioctl(serial_port, _IOW('T', 0x2B, serialport_termios2) /*TCSETS2*/, &config) != 0)
+			throw new std::runtime_error("unable to change the baudrate");
+	  #else
+		(void)serial_port; (void)baud_rate;
+		throw new std::runtime_error("unsupported baudrate");
+	  #endif
+		}
+
+	static speed_t baud_constant(std::size_t baud_rate)
+		{ // termios constant of a standard baudrate (0 if there is none)
+		switch(baud_rate)
+			{
+			case 1200: return B1200;
+			case 2400: return B2400;
+			case 4800: return B4800;
+			case 9600: return B9600;
+			case 19200: return B19200;
+			case 38400: return B38400;
+			case 57600: return B57600;
+			case 115200: return B115200;
+			case 230400: return B230400;
+		  #ifdef B460800
+			case 460800: return B460800;
+		  #endif
+		  #ifdef B921600
+			case 921600: return B921600;
+		  #endif
+			default: return 0;
+			}
+		}
+	};
+
+#endif // _WIN32
+
 /**
  * THE INTERESTING STUFF
  *
@@ -180,7 +574,7 @@ template<typename T, typename Traits, // character type and character traits
 	: public std::basic_streambuf<T, Traits>
 	{
 public:
-	// notice: this streambuffer class doesn't use an input buffer and thus support putback
+	// notice: the input buffer is refilled with everything the port delivers in one read
 
 	typedef T char_type;
 	typedef Traits traits_type;
@@ -192,9 +586,13 @@ public:
 	basic_serialport_streambuf(const basic_serialport_streambuf&) = delete;
 	basic_serialport_streambuf& operator = (const basic_serialport_streambuf&) = delete;
 
+	template<typename PortName> // LPCWSTR (windows) or const char* (posix)
 	explicit basic_serialport_streambuf(
-			LPCWSTR port_name, std::size_t baud_rate=SERIALPORT_DEFAULT_BAUDRATE, std::size_t buf_size = 128)
+			PortName port_name, std::size_t baud_rate=SERIALPORT_DEFAULT_BAUDRATE,
+			std::size_t buf_size = SERIALPORT_DEFAULT_OUTPUT_BUFSIZE,
+			std::size_t in_buf_size = SERIALPORT_DEFAULT_INPUT_BUFSIZE)
 		: buffer_(buf_size+1)
+		, readbuf_(in_buf_size > 0 ? in_buf_size : 1)
 		, init_(&serial_port_, port_name, baud_rate)
 		{ // construct from parameters (create serial port RAII)
 		auto base = &buffer_.front();
@@ -203,7 +601,7 @@ public:
 		this->setp(base, base + buffer_.size() -1);
 
 		auto inbase = &readbuf_.front() + readbuf_.size(); // retrieve pointer to the end of the input buffer
-		this->setg(inbase, inbase,  inbase); // don't use an input buffer
+		this->setg(inbase, inbase,  inbase); // the input buffer is empty
 		}
 
 	~basic_serialport_streambuf()
@@ -212,6 +610,24 @@ public:
 		d(&serial_port_); // pass handle to the deleter
 		}
 
+	Handle native_handle() const
+		{ // underlying handle (e.g. to tune the port)
+		return serial_port_;
+		}
+
+	serialport_metrics_snapshot metrics() const
+		{ // counters and latencies since construction (or the last reset_metrics)
+		auto s = metrics_.snapshot();
+		s.echo_rtt = serialport_echo_rtt(writer_, 0);
+		return s;
+		}
+
+	void reset_metrics()
+		{ // start counting from zero
+		metrics_.reset();
+		serialport_echo_rtt_reset(writer_, 0);
+		}
+
 protected:
 	int_type overflow(int_type ch) override
 		{ // called if there are no empty slots in the buffer
@@ -232,56 +648,407 @@ protected:
 		return flush_buffer() ? 0/*success*/ : -1/*error*/;
 		}
 
+	std::streamsize xsputn(const char_type* s, std::streamsize n) override
+		{ // write n elements
+		if(n < this->epptr() - this->pptr())
+			return std::basic_streambuf<T, Traits>::xsputn(s, n); // small write: use the buffer
+
+		// large write: send the buffer and s together, straight from the caller's memory
+		if(!write_port(this->pbase(), static_cast<std::size_t>(this->pptr() - this->pbase()),
+				s, static_cast<std::size_t>(n)))
+			return 0; // write failed
+		this->pbump(static_cast<int>(this->pbase() - this->pptr())); // the buffer is now empty again
+		return n;
+		}
+
 	int_type underflow() override
-		{
-		DWORD num_read = 0; // number of bytes read
-		Reader r;
-		std::lock_guard<decltype(m_)> l(m_); // lock mutex
-		if(r(serial_port_, &readbuf_[0], 1, &num_read) && num_read > 0) // use the reader policy to read new data
-			return static_cast<int_type>(readbuf_[0]); // success
+		{ // called if the input buffer is empty
+		if(this->gptr() < this->egptr())
+			return traits_type::to_int_type(*(this->gptr()));
+
+		std::size_t num_read = 0; // number of elements read
+		auto l = lock(); // lock mutex
+		serialport_wait(reader_, serial_port_, l, 0);
+		auto base = &readbuf_.front();
+		// use the reader policy to read everything that is available (up to the buffer size)
+		if(read_port(base, readbuf_.size(), &num_read) && num_read > 0)
+			{ // success
+			this->setg(base, base, base + num_read);
+			return traits_type::to_int_type(*(this->gptr()));
+			}
 		return Traits::eof(); // failure
 		}
 
 	std::streamsize showmanyc() override
-		{
-		return 0; // no information available
+		{ // called if the input buffer is empty: elements waiting in the driver queue
+		return serialport_pending(reader_, serial_port_, 0);
 		}
 
-	int_type uflow() override
-		{
-		return readbuf_[0]; // return stored input
+	std::streamsize xsgetn(char_type* s, std::streamsize n) override
+		{ // read n elements
+		// drain the input buffer first
+		std::streamsize num = this->egptr() - this->gptr();
+		if(num > n)
+			num = n;
+		traits_type::copy(s, this->gptr(), static_cast<std::size_t>(num));
+		this->gbump(static_cast<int>(num));
+
+		if(n - num < static_cast<std::streamsize>(readbuf_.size()))
+			return num + std::basic_streambuf<T, Traits>::xsgetn(s + num, n - num); // small read: use the buffer
+
+		// large read: read straight into the caller's memory
+		auto l = lock(); // lock mutex
+		while(num < n)
+			{
+			std::size_t num_read = 0;
+			serialport_wait(reader_, serial_port_, l, 0);
+			if(!read_port(s + num, static_cast<std::size_t>(n - num), &num_read) || num_read == 0)
+				break; // failure or timeout
+			num += static_cast<std::streamsize>(num_read);
+			}
+		return num;
 		}
 
 private:
 	bool flush_buffer()
 		{ // send buffered data to the
-		std::ptrdiff_t num = pptr() - pbase(); // number of elements in the buffer
-		std::ptrdiff_t num_send = 0; // number of bytes send
+		std::ptrdiff_t num = this->pptr() - this->pbase(); // number of elements in the buffer
+		if(!write_port(this->pbase(), static_cast<std::size_t>(num), nullptr, 0))
+			return false; // write failed. data remains in buffer
+      this->pbump(-num); // the buffer is now empty again
+		return true;
+		}
+
+	std::unique_lock<std::mutex> lock()
+		{ // lock the mutex (records the waiting time)
+		const auto start = serialport_metrics::clock_type::now();
+		std::unique_lock<std::mutex> l(m_);
+		metrics_.lock_wait.record(serialport_metrics::clock_type::now() - start);
+		return l;
+		}
+
+	bool write_port(const char_type* a, std::size_t na, const char_type* b, std::size_t nb)
+		{ // use the writer policy to send a and b (one call)
+		if(na + nb == 0)
+			return true;
 		try{
-			Writer w;
-			std::lock_guard<decltype(m_)> l(m_); // lock mutex
-			w(serial_port_, &buffer_[num_send], num); // use the writer policy to send the data
+			auto l = lock(); // lock mutex
+			const auto start = serialport_metrics::clock_type::now();
+			if(nb == 0)
+				writer_(serial_port_, a, na);
+			else
+				serialport_gather_write(writer_, serial_port_, a, na, b, nb, 0);
+			metrics_.flush_latency.record(serialport_metrics::clock_type::now() - start);
 		}catch(...){
-			return false; // write failed. data remains in buffer
+			++metrics_.errors;
+			return false;
 		}
-      this->pbump(-num); // the buffer is now empty again
+		++metrics_.write_calls;
+		metrics_.bytes_out += na + nb;
 		return true;
 		}
 
+	bool read_port(char_type* s, std::size_t n, std::size_t* num_read)
+		{ // use the reader policy to receive up to n elements (mutex locked)
+		const auto start = serialport_metrics::clock_type::now();
+		const bool ok = reader_(serial_port_, s, n, num_read);
+		metrics_.read_latency.record(serialport_metrics::clock_type::now() - start);
+		++metrics_.read_calls;
+		if(!ok)
+			++metrics_.errors;
+		else if(*num_read == 0)
+			++metrics_.timeouts;
+		metrics_.bytes_in += *num_read;
+		return ok;
+		}
+
 	Handle serial_port_;
 	std::vector<char_type> buffer_; // output buffer
 
-	// input buffer.
-	// notice: the streambuffer doesn't fully support input buffers.
-	//			  this only exists to make the implementation of 'uflow' simpler
-	std::array<char_type, 1> readbuf_;
+	std::vector<char_type> readbuf_; // input buffer
 
 	Initializer init_; // notice!! Initializer may hold data
 
+	Writer writer_; // notice!! policies may hold state (e.g. a compression dictionary)
+	Reader reader_;
+
 	mutable std::mutex m_; // control reads and writes
+	serialport_metrics metrics_; // counters and histograms
+	};
+
+
+/**
+ * FULL DUPLEX
+ *
+ * the same streambuffer, but reading and writing run at the same time
+ */
+
+struct serialport_event
+	{ // wake up a thread which waits for a condition of a ring buffer
+	// the waiting thread announces itself. the other thread only takes the mutex if
+	// somebody waits, thus the fast path of both threads is lock free
+	template<typename Predicate>
+	bool wait_for(Predicate pred, std::chrono::milliseconds timeout)
+		{ // wait until pred() is true (false: timeout)
+		if(pred())
+			return true;
+		std::unique_lock<std::mutex> l(m_);
+		waiting_.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with notify
+		const bool ok = cv_.wait_for(l, timeout, pred);
+		waiting_.store(false, std::memory_order_relaxed);
+		return ok;
+		}
+
+	void notify()
+		{ // call after the condition changed
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with wait_for
+		if(waiting_.load(std::memory_order_relaxed))
+			{
+			std::lock_guard<std::mutex> l(m_); // the waiter is inside wait_for or gone
+			cv_.notify_one();
+			}
+		}
+
+private:
+	std::mutex m_;
+	std::condition_variable cv_;
+	std::atomic<bool> waiting_{false};
+	};
+
+template<typename T, typename Traits, // character type and character traits
+			typename Handle,			// type of the handle
+			typename Writer,			// writing policy
+			typename Reader,			// reading policy
+			typename Deleter,			// deleting policy
+			typename Initializer>   // initalizing policy
+	class basic_duplex_serialport_streambuf
+	: public std::basic_streambuf<T, Traits>
+	{
+public:
+	// notice: a receiving thread drains the port into a ring buffer, a sending thread empties a
+	//         second ring buffer into the port. the streambuffer itself only touches the rings,
+	//         reads and writes never wait for each other.
+	// notice: the writer must not read from the port (the echo checking writer does). the
+	//         receiving thread consumes all input
+	// notice: the receiving thread blocks in the reading policy. the destructor waits for the
+	//         read in progress (at most the read timeout of the port)
+	// notice: empty reads which return at once (end of file, hangup, polling port) make the
+	//         receiving thread pause, doubling up to SERIALPORT_MAX_READ_BACKOFF_MS
+	// notice: windows serializes synchronous reads and writes on the same handle. open the
+	//         port with FILE_FLAG_OVERLAPPED (own policies) to get real full duplex there
+
+	typedef T char_type;
+	typedef Traits traits_type;
+	typedef typename Traits::int_type int_type;
+	typedef std::streampos pos_type;
+	typedef std::streamoff off_type;
+
+	// disable copy construction and copy assignment
+	basic_duplex_serialport_streambuf(const basic_duplex_serialport_streambuf&) = delete;
+	basic_duplex_serialport_streambuf& operator = (const basic_duplex_serialport_streambuf&) = delete;
+
+	template<typename PortName> // LPCWSTR (windows) or const char* (posix)
+	explicit basic_duplex_serialport_streambuf(
+			PortName port_name, std::size_t baud_rate=SERIALPORT_DEFAULT_BAUDRATE,
+			std::size_t buf_size = SERIALPORT_DEFAULT_OUTPUT_BUFSIZE,
+			std::size_t in_buf_size = SERIALPORT_DEFAULT_INPUT_BUFSIZE,
+			std::size_t ring_size = SERIALPORT_DEFAULT_RING_SIZE,
+			std::chrono::milliseconds timeout = std::chrono::milliseconds(SERIALPORT_DEFAULT_TIMEOUT_MS))
+		: buffer_(buf_size > 0 ? buf_size : 1)
+		, readbuf_(in_buf_size > 0 ? in_buf_size : 1)
+		, init_(&serial_port_, port_name, baud_rate)
+		, rx_(ring_size)
+		, tx_(ring_size)
+		, timeout_(timeout)
+		{ // construct from parameters (create serial port RAII, start the i/o threads)
+		auto base = &buffer_.front();
+		this->setp(base, base + buffer_.size());
+
+		auto inbase = &readbuf_.front() + readbuf_.size(); // retrieve pointer to the end of the input buffer
+		this->setg(inbase, inbase,  inbase); // the input buffer is empty
+
+		receiver_ = std::thread(&basic_duplex_serialport_streambuf::receive_loop, this);
+		sender_ = std::thread(&basic_duplex_serialport_streambuf::send_loop, this);
+		}
+
+	~basic_duplex_serialport_streambuf()
+		{ // destruct (send remaining output, stop the i/o threads)
+		flush_buffer();
+		stop_.store(true);
+		tx_data_.notify();
+		rx_space_.notify();
+		sender_.join(); // sends what is left in the ring first
+		receiver_.join();
+		Deleter d;
+		d(&serial_port_); // pass handle to the deleter
+		}
+
+	Handle native_handle() const
+		{ // underlying handle (e.g. to tune the port)
+		return serial_port_;
+		}
+
+protected:
+	int_type overflow(int_type ch) override
+		{ // called if there are no empty slots in the buffer
+		if(!flush_buffer())
+			return traits_type::eof(); // error
+		if(ch != traits_type::eof())
+			{ // store ch in the (now empty) buffer
+			*(this->pptr()) = traits_type::to_char_type(ch);
+			this->pbump(1);
+			}
+		return traits_type::not_eof(ch); // success
+		}
+
+	int sync() override
+		{ // flush buffer and wait until the sending thread passed everything to the port
+		// -1 indicates error
+		if(!flush_buffer())
+			return -1;
+		while(!tx_error_.load() && num_sent_.load() != num_queued_)
+			tx_space_.wait_for([this]{ return tx_error_.load() || num_sent_.load() == num_queued_; }, timeout_);
+		return tx_error_.load() ? -1/*error*/ : 0/*success*/;
+		}
+
+	int_type underflow() override
+		{ // called if the input buffer is empty
+		if(this->gptr() < this->egptr())
+			return traits_type::to_int_type(*(this->gptr()));
+
+		// wait for the receiving thread (at most timeout_)
+		if(!rx_data_.wait_for([this]{ return !rx_.empty() || rx_done_.load(); }, timeout_))
+			return traits_type::eof(); // timeout
+		auto base = &readbuf_.front();
+		const std::size_t num_read = rx_.read(base, readbuf_.size());
+		rx_space_.notify();
+		if(num_read == 0)
+			return traits_type::eof(); // the receiving thread stopped (read error)
+		this->setg(base, base, base + num_read);
+		return traits_type::to_int_type(*(this->gptr()));
+		}
+
+	std::streamsize showmanyc() override
+		{ // called if the input buffer is empty: elements received by the receiving thread
+		return static_cast<std::streamsize>(rx_.size());
+		}
+
+private:
+	bool flush_buffer()
+		{ // pass buffered data to the sending thread
+		const char_type* p = this->pbase();
+		std::size_t num = this->pptr() - this->pbase(); // number of elements in the buffer
+		while(num > 0)
+			{
+			if(tx_error_.load())
+				return false; // the writer failed. data remains in buffer
+			const std::size_t n = tx_.write(p, num);
+			if(n > 0)
+				{
+				num_queued_ += n;
+				p += n;
+				num -= n;
+				tx_data_.notify();
+				}
+			else // ring is full
+				tx_space_.wait_for([this]{ return tx_.size() < tx_.capacity() || tx_error_.load(); }, timeout_);
+			}
+		this->setp(&buffer_.front(), &buffer_.front() + buffer_.size()); // the buffer is now empty again
+		return true;
+		}
+
+	void send_loop()
+		{ // sending thread: pass the ring to the writer policy
+		Writer w;
+		for(;;)
+			{
+			const char_type* p;
+			const std::size_t n = tx_.acquire_read(p);
+			if(n == 0)
+				{
+				if(stop_.load() && tx_.empty())
+					return;
+				tx_data_.wait_for([this]{ return !tx_.empty() || stop_.load(); }, timeout_);
+				continue;
+				}
+			try{
+				w(serial_port_, p, n);
+			}catch(...){
+				tx_error_.store(true); // give up: sync and overflow report the error
+				tx_space_.notify();
+				return;
+			}
+			tx_.commit_read(n);
+			num_sent_.fetch_add(n);
+			tx_space_.notify();
+			}
+		}
+
+	void receive_loop()
+		{ // receiving thread: read from the port straight into the ring
+		typedef std::chrono::steady_clock clock_type;
+		Reader r;
+		std::chrono::milliseconds backoff(0); // pause after an empty read which did not block
+		while(!stop_.load())
+			{
+			char_type* p;
+			const std::size_t n = rx_.acquire_write(p);
+			if(n == 0)
+				{ // ring is full: wait for the consumer
+				rx_space_.wait_for([this]{ return rx_.size() < rx_.capacity() || stop_.load(); }, timeout_);
+				continue;
+				}
+			std::size_t num_read = 0;
+			const auto start = clock_type::now();
+			if(!r(serial_port_, p, n, &num_read))
+				break; // read error
+			if(num_read > 0)
+				{
+				backoff = std::chrono::milliseconds(0);
+				rx_.commit_write(num_read);
+				rx_data_.notify();
+				}
+			else if(clock_type::now() - start < std::chrono::milliseconds(1))
+				{ // returned at once without data (end of file or hangup): don't spin
+				const std::chrono::milliseconds max_backoff(SERIALPORT_MAX_READ_BACKOFF_MS);
+				backoff = backoff.count() == 0 ? std::chrono::milliseconds(1)
+					: (2*backoff < max_backoff ? 2*backoff : max_backoff);
+				rx_space_.wait_for([this]{ return stop_.load(); }, backoff); // the destructor wakes us
+				}
+			else // the read timed out
+				backoff = std::chrono::milliseconds(0);
+			}
+		rx_done_.store(true);
+		rx_data_.notify();
+		}
+
+	Handle serial_port_;
+	std::vector<char_type> buffer_; // output buffer
+	std::vector<char_type> readbuf_; // input buffer
+
+	Initializer init_; // notice!! Initializer may hold data
+
+	algo::spsc_ring_buffer<char_type> rx_; // receiving thread -> underflow
+	algo::spsc_ring_buffer<char_type> tx_; // flush_buffer -> sending thread
+	serialport_event rx_data_;  // rx_ is not empty
+	serialport_event rx_space_; // rx_ is not full
+	serialport_event tx_data_;  // tx_ is not empty
+	serialport_event tx_space_; // tx_ is not full or elements were sent
+	std::size_t num_queued_ = 0; // elements passed to tx_ (only used by the stream side)
+	std::atomic<std::size_t> num_sent_{0}; // elements passed to the writer
+	std::atomic<bool> tx_error_{false};
+	std::atomic<bool> rx_done_{false};
+	std::atomic<bool> stop_{false};
+	std::chrono::milliseconds timeout_;
+
+	std::thread receiver_; // started last
+	std::thread sender_;
 	};
 
 
+#ifdef _WIN32
+
 // default stream-buffer: use the serialport to connect to the hardware
 typedef basic_serialport_streambuf<byte, std::char_traits<byte>, HANDLE,
 		p_winapi_file_writer_with_echo<p_winapi_file_reader, byte>,	// writing policy
@@ -299,3 +1066,32 @@ typedef basic_serialport_streambuf<byte, std::char_traits<byte>, HANDLE,
 		p_serialport_initializer<byte>>     // initalizing policy
 	unchecked_serialport_streambuf;
 
+#else // POSIX
+
+// default stream-buffer: use the serialport to connect to the hardware
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, int,
+		p_pipelined_echo_writer<p_posix_fd_writer, p_posix_fd_reader, byte>,	// writing policy
+		p_posix_fd_reader<byte>,                                             // reading policy
+		p_posix_fd_deleter<byte>,                                            // deleting policy
+		p_posix_serialport_initializer<byte>>                                // initalizing policy
+	serialport_streambuf;
+
+
+// default stream-buffer: use the serialport to connect to the hardware
+typedef basic_serialport_streambuf<byte, std::char_traits<byte>, int,
+		p_posix_fd_writer<byte>,                 // writing policy
+		p_posix_fd_reader<byte>,                 // reading policy
+		p_posix_fd_deleter<byte>,                // deleting policy
+		p_posix_serialport_initializer<byte>>    // initalizing policy
+	unchecked_serialport_streambuf;
+
+
+// full duplex stream-buffer: reads and writes run in parallel (no echo verification)
+typedef basic_duplex_serialport_streambuf<byte, std::char_traits<byte>, int,
+		p_posix_fd_writer<byte>,                 // writing policy
+		p_posix_fd_reader<byte>,                 // reading policy
+		p_posix_fd_deleter<byte>,                // deleting policy
+		p_posix_serialport_initializer<byte>>    // initalizing policy
+	duplex_serialport_streambuf;
+
+#endif // _WIN32
\ No newline at end of file
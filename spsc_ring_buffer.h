@@ -0,0 +1,182 @@
+// spsc_ring_buffer.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+class:
+	spsc_ring_buffer
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+
+namespace algo{
+
+/*
+TEMPLATE CLASS spsc_ring_buffer
+
+bounded single producer / single consumer queue of trivially copyable
+elements. one thread may write while another thread reads at the same time,
+no locks are involved. the capacity is rounded up to a power of two.
+
+the read and write positions live on separate cache lines. each side keeps
+a copy of the other side's position and only reloads it when it seems to be
+out of space (or data), thus the cache lines are rarely shared.
+
+acquire_write/commit_write and acquire_read/commit_read give direct access
+to the contiguous part of the free (or used) space, e.g. to read() into the
+queue without a temporary buffer.
+
+-> notice: exactly one producer thread and one consumer thread
+-> notice: the functions never block. waiting is up to the caller
+-> usage:   spsc_ring_buffer<char> q(4096);
+			q.write(data, n);      // producer: returns the number of elements stored
+			q.read(buffer, size);  // consumer: returns the number of elements taken
+*/
+
+	// TEMPLATE CLASS spsc_ring_buffer
+template<class T>
+	class spsc_ring_buffer
+	{   // lock free single producer / single consumer queue
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+
+	static_assert(std::is_trivially_copyable<T>::value, "elements are copied with memcpy");
+
+	explicit spsc_ring_buffer(size_type capacity)
+		: MyCapacity(Round_up(capacity))
+		, MyMask(MyCapacity - 1)
+		, MyData(new T[MyCapacity])
+		{   // construct empty queue (capacity: at least capacity elements)
+		MyWrite.pos.store(0, std::memory_order_relaxed);
+		MyWrite.cached = 0;
+		MyRead.pos.store(0, std::memory_order_relaxed);
+		MyRead.cached = 0;
+		}
+
+	spsc_ring_buffer(const spsc_ring_buffer&) = delete;
+	spsc_ring_buffer& operator = (const spsc_ring_buffer&) = delete;
+
+	// producer
+
+	size_type acquire_write(T*& p)
+		{   // contiguous free space starting at p
+		const size_type w = MyWrite.pos.load(std::memory_order_relaxed);
+		if(MyCapacity - (w - MyWrite.cached) == 0)
+			MyWrite.cached = MyRead.pos.load(std::memory_order_acquire);
+		const size_type free = MyCapacity - (w - MyWrite.cached);
+		const size_type to_end = MyCapacity - (w & MyMask);
+		p = MyData.get() + (w & MyMask);
+		return free < to_end ? free : to_end;
+		}
+
+	void commit_write(size_type n)
+		{   // publish n elements written to the space of acquire_write
+		MyWrite.pos.store(MyWrite.pos.load(std::memory_order_relaxed) + n, std::memory_order_release);
+		}
+
+	size_type write(const T* s, size_type n)
+		{   // store up to n elements, return the number stored
+		assert(n == 0 || s);
+		size_type num = 0;
+		T* p;
+		size_type avail;
+		while(num < n && (avail = acquire_write(p)) > 0)
+			{   // at most two rounds (wrap around)
+			if(avail > n - num)
+				avail = n - num;
+			std::memcpy(p, s + num, avail*sizeof(T));
+			commit_write(avail);
+			num += avail;
+			}
+		return num;
+		}
+
+	// consumer
+
+	size_type acquire_read(const T*& p)
+		{   // contiguous stored elements starting at p
+		const size_type r = MyRead.pos.load(std::memory_order_relaxed);
+		if(MyRead.cached == r)
+			MyRead.cached = MyWrite.pos.load(std::memory_order_acquire);
+		const size_type used = MyRead.cached - r;
+		const size_type to_end = MyCapacity - (r & MyMask);
+		p = MyData.get() + (r & MyMask);
+		return used < to_end ? used : to_end;
+		}
+
+	void commit_read(size_type n)
+		{   // release n elements of the space of acquire_read
+		MyRead.pos.store(MyRead.pos.load(std::memory_order_relaxed) + n, std::memory_order_release);
+		}
+
+	size_type read(T* s, size_type n)
+		{   // take up to n elements, return the number taken
+		assert(n == 0 || s);
+		size_type num = 0;
+		const T* p;
+		size_type avail;
+		while(num < n && (avail = acquire_read(p)) > 0)
+			{   // at most two rounds (wrap around)
+			if(avail > n - num)
+				avail = n - num;
+			std::memcpy(s + num, p, avail*sizeof(T));
+			commit_read(avail);
+			num += avail;
+			}
+		return num;
+		}
+
+	// both sides
+
+	size_type size() const
+		{   // number of stored elements (a snapshot)
+		const size_type r = MyRead.pos.load(std::memory_order_acquire);
+		const size_type w = MyWrite.pos.load(std::memory_order_acquire);
+		return w - r;
+		}
+
+	bool empty() const
+		{   // test if the queue is empty (a snapshot)
+		return size() == 0;
+		}
+
+	size_type capacity() const
+		{   // maximum number of stored elements
+		return MyCapacity;
+		}
+
+private:
+	static size_type Round_up(size_type n)
+		{   // smallest power of two >= n
+		size_type c = 1;
+		while(c < n)
+			c <<= 1;
+		return c;
+		}
+
+	struct alignas(64) Position
+		{   // position of one side and the last seen position of the other side
+		std::atomic<size_type> pos;
+		size_type cached;
+		};
+
+	const size_type MyCapacity;
+	const size_type MyMask;
+	std::unique_ptr<T[]> MyData;
+	Position MyWrite;   // producer (cached: read position)
+	Position MyRead;    // consumer (cached: write position)
+	};
+
+};//end: namespace
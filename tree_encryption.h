@@ -0,0 +1,762 @@
+// tree_encryption.h standart header - by jannik voss
+
+/*
+HEADER FILE INFORMATION:
+
+language: C++11 required
+source: no source file needed
+
+structs:
+	tree_encryption_options
+	tree_stage_stats
+	tree_encryption_result
+
+class:
+	aes256_tree_encryptor
+*/
+
+#pragma once
+
+#ifndef __linux__
+  #error "tree_encryption requires linux (pread, pwrite)"
+#endif
+
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "aes256_ctr.h"
+#include "aes_ctr_drbg.h"
+#include "directory_iterator.h"
+#include "mapped_file.h"
+
+#define TREE_ENCRYPTION_MAGIC "AESCTR1\n" // first 8 bytes of an encrypted file, the 16 byte iv follows
+#define TREE_ENCRYPTION_HEADER 24         // bytes in front of the ciphertext
+
+namespace crypto{
+
+enum class tree_direction
+	{   // what run() does with the files
+	encrypt,
+	decrypt
+	};
+
+	// STRUCT tree_encryption_options
+struct tree_encryption_options
+	{   // parameters of the pipeline
+	tree_encryption_options()
+		: readers(2)
+		, ciphers(0)
+		, writers(2)
+		, chunk_size(std::size_t(4) << 20)
+		, buffers(0)
+		, queue_depth(256)
+		, use_mmap(true)
+		, mmap_threshold(std::size_t(16) << 20)
+		{   // construct with default values
+		}
+
+	unsigned readers;           // threads of the read stage
+	unsigned ciphers;           // threads of the cipher stage (0: all cores)
+	unsigned writers;           // threads of the write stage
+	std::size_t chunk_size;     // bytes per work item: large files are split, small files batched
+	std::size_t buffers;        // chunk buffers in flight (0: 2 per thread). memory: buffers*chunk_size
+	std::size_t queue_depth;    // files queued between enumeration and the read stage
+	bool use_mmap;              // map large files instead of reading them
+	std::size_t mmap_threshold; // smallest file, which is mapped
+	};
+
+	// STRUCT tree_stage_stats
+struct tree_stage_stats
+	{   // counters of one stage
+	unsigned threads = 0;
+	unsigned long long items = 0;   // directories (enumerate), files (read) or chunks (cipher, write)
+	unsigned long long bytes = 0;
+	double busy_seconds = 0;        // sum over the threads of the stage
+	double wait_seconds = 0;        // blocked on a queue or on a free buffer
+
+	double utilization(double seconds) const
+		{   // busy fraction of the stage's threads (1: saturated)
+		return (seconds > 0 && threads > 0 ? busy_seconds / (seconds*threads) : 0.0);
+		}
+
+	void write_json(std::ostream& os, double seconds) const
+		{   // {"threads": ..., "items": ..., ...}
+		os << "{\"threads\": " << threads << ", \"items\": " << items << ", \"bytes\": " << bytes
+			<< ", \"mb_per_s\": " << (seconds > 0 ? double(bytes)/seconds/1e6 : 0.0)
+			<< ", \"busy_seconds\": " << busy_seconds << ", \"wait_seconds\": " << wait_seconds
+			<< ", \"utilization\": " << utilization(seconds) << "}";
+		}
+	};
+
+	// STRUCT tree_encryption_result
+struct tree_encryption_result
+	{   // statistics of a run (or of a running pipeline so far)
+	unsigned long long files = 0;       // files read
+	unsigned long long directories = 0; // directories created
+	unsigned long long skipped = 0;     // symlinks and special files
+	unsigned long long errors = 0;      // files or directories which failed (partial output is removed)
+	double seconds = 0;
+	tree_stage_stats enumerate;
+	tree_stage_stats read;
+	tree_stage_stats cipher;
+	tree_stage_stats write;
+
+	const char* bottleneck() const
+		{   // the stage with the highest utilization
+		const tree_stage_stats* s[] = {&enumerate, &read, &cipher, &write};
+		const char* names[] = {"enumerate", "read", "cipher", "write"};
+		int b = 0;
+		for(int i=1; i<4; ++i)
+			if(s[i]->utilization(seconds) > s[b]->utilization(seconds))
+				b = i;
+		return (names[b]);
+		}
+
+	void write_json(std::ostream& os) const
+		{   // one json object
+		os << "{\"files\": " << files << ", \"directories\": " << directories << ", \"skipped\": " << skipped
+			<< ", \"errors\": " << errors << ", \"seconds\": " << seconds
+			<< ", \"mb_per_s\": " << (seconds > 0 ? double(write.bytes)/seconds/1e6 : 0.0)
+			<< ", \"bottleneck\": \"" << bottleneck() << "\", \"stages\": {\"enumerate\": ";
+		enumerate.write_json(os, seconds);
+		os << ", \"read\": ";
+		read.write_json(os, seconds);
+		os << ", \"cipher\": ";
+		cipher.write_json(os, seconds);
+		os << ", \"write\": ";
+		write.write_json(os, seconds);
+		os << "}}";
+		}
+	};
+
+	// TEMPLATE CLASS Blocking_queue
+template<class T>
+	class Blocking_queue
+	{   // bounded multi producer / multi consumer queue
+public:
+	explicit Blocking_queue(std::size_t capacity)
+		: MyCapacity(capacity)
+		, MyClosed(false)
+		{
+		}
+
+	bool push(T&& v)
+		{   // append v, wait while the queue is full (false: closed)
+		std::unique_lock<std::mutex> l(MyMutex);
+		MyNot_full.wait(l, [this]{ return MyQueue.size() < MyCapacity || MyClosed; });
+		if(MyClosed)
+			return false;
+		MyQueue.push_back(std::move(v));
+		MyNot_empty.notify_one();
+		return true;
+		}
+
+	bool pop(T& v)
+		{   // take the oldest element, wait while the queue is empty (false: closed and empty)
+		std::unique_lock<std::mutex> l(MyMutex);
+		MyNot_empty.wait(l, [this]{ return !MyQueue.empty() || MyClosed; });
+		return (Take(v));
+		}
+
+	bool try_pop(T& v)
+		{   // take the oldest element, if there is one
+		std::lock_guard<std::mutex> l(MyMutex);
+		return (Take(v));
+		}
+
+	void close()
+		{   // no more elements: wake all waiting threads
+		std::lock_guard<std::mutex> l(MyMutex);
+		MyClosed = true;
+		MyNot_empty.notify_all();
+		MyNot_full.notify_all();
+		}
+
+private:
+	bool Take(T& v)
+		{   // pop front (MyMutex locked)
+		if(MyQueue.empty())
+			return false;
+		v = std::move(MyQueue.front());
+		MyQueue.pop_front();
+		MyNot_full.notify_one();
+		return true;
+		}
+
+	std::size_t MyCapacity;
+	bool MyClosed;
+	std::deque<T> MyQueue;
+	std::mutex MyMutex;
+	std::condition_variable MyNot_empty;
+	std::condition_variable MyNot_full;
+	};
+
+/*
+TEMPLATE CLASS Tree_encryptor
+
+encrypts (or decrypts) a whole directory tree with a pipeline of overlapped stages:
+
+	enumerate (1 thread)  ->  read  ->  cipher (counter mode)  ->  write
+
+the stages are connected by bounded queues, the chunk buffers come from a fixed pool, i.e. a slow stage
+throttles the others and the memory is bounded (buffers*chunk_size). large files are split into chunks,
+which are encrypted and written in parallel (counter mode: every chunk seeks to its position in the
+keystream, pwrite puts it at its offset). small files are batched: one chunk holds many files
+-> notice: every output file is: magic (8 bytes), random iv (16 bytes), ciphertext. decrypt reads the iv
+           from the file. the iv is never reused (aes256_ctr_drbg), counter mode does not authenticate
+-> notice: directories are created, regular files are processed, symlinks and special files are skipped.
+           files which fail are removed from the destination and counted as errors, so are source
+           directories which cannot be listed (completely)
+-> notice: the destination may lie inside the source, it is not processed itself (same device and
+           inode). source and destination must not be the same directory (error)
+-> notice: large files are mapped (mapped_file), the pages are read by the cipher stage. otherwise files
+           are read with pread into the chunk buffer, the cipher stage works in place
+-> notice: counters() returns the per stage statistics of the running pipeline (any thread). the stage
+           with the highest utilization is the bottleneck
+-> usage:   aes256_tree_encryptor e(key);  // 8 key words
+			auto r = e.run("/data/", "/archive/data/");
+			r.write_json(std::cout);
+			e.run("/archive/data/", "/restore/", tree_direction::decrypt);
+*/
+
+	// TEMPLATE CLASS Tree_encryptor
+template<class Cipher>
+	class Tree_encryptor
+	{   // pipelined bulk encryption of a directory tree
+public:
+	typedef typename Aes_ctr<Cipher>::bit32 bit32;
+	typedef typename Aes_ctr<Cipher>::bit8 bit8;
+	typedef std::string path_type;
+
+	explicit Tree_encryptor(const bit32* key, const tree_encryption_options& options = tree_encryption_options())
+		: MyOptions(options)
+		{   // construct from key (8 words)
+		assert(key);
+		const bit8 iv[16] = {};
+		MyMode.initialize(key, iv); // every cipher thread starts from a copy (one key schedule)
+		if(MyOptions.ciphers == 0)
+			MyOptions.ciphers = std::max(1u, std::thread::hardware_concurrency());
+		MyOptions.readers = std::max(1u, MyOptions.readers);
+		MyOptions.writers = std::max(1u, MyOptions.writers);
+		MyOptions.chunk_size = std::max<std::size_t>(MyOptions.chunk_size, 4096);
+		if(MyOptions.buffers == 0)
+			MyOptions.buffers = 2*(MyOptions.readers + MyOptions.ciphers + MyOptions.writers);
+		MyOptions.buffers = std::max<std::size_t>(MyOptions.buffers, MyOptions.readers + 1);
+		}
+
+	// disable copy construction and copy assignment
+	Tree_encryptor(const Tree_encryptor&) = delete;
+	Tree_encryptor& operator = (const Tree_encryptor&) = delete;
+
+	tree_encryption_result run(path_type src, path_type dst, tree_direction direction = tree_direction::encrypt)
+		{   // process the tree below src into dst (one run at a time)
+		if(src.empty() || src.back() != '/')
+			src.push_back('/');
+		if(dst.empty() || dst.back() != '/')
+			dst.push_back('/');
+		Reset(direction);
+
+		Blocking_queue<File_job> files(MyOptions.queue_depth);
+		Blocking_queue<Chunk_ptr> plain(MyOptions.buffers);
+		Blocking_queue<Chunk_ptr> done(MyOptions.buffers);
+		Blocking_queue<bit8*> pool(MyOptions.buffers);
+		std::vector<std::unique_ptr<bit8[]>> storage;
+		for(std::size_t i=0; i<MyOptions.buffers; ++i)
+			{
+			storage.push_back(std::unique_ptr<bit8[]>(new bit8[MyOptions.chunk_size]));
+			pool.push(storage.back().get());
+			}
+
+		std::atomic<unsigned> readers(MyOptions.readers);
+		std::atomic<unsigned> ciphers(MyOptions.ciphers);
+		std::vector<std::thread> threads;
+		threads.push_back(std::thread([&]{ Enumerate(src, dst, files); }));
+		for(unsigned i=0; i<MyOptions.readers; ++i)
+			threads.push_back(std::thread([&]{
+				Read(files, pool, plain);
+				if(--readers == 0)
+					plain.close();
+				}));
+		for(unsigned i=0; i<MyOptions.ciphers; ++i)
+			threads.push_back(std::thread([&]{
+				Encrypt(plain, done);
+				if(--ciphers == 0)
+					done.close();
+				}));
+		for(unsigned i=0; i<MyOptions.writers; ++i)
+			threads.push_back(std::thread([&]{ Write(done, pool); }));
+		for(auto& t : threads)
+			t.join();
+		MyEnd.store(clock_type::now().time_since_epoch().count());
+		return (counters());
+		}
+
+	tree_encryption_result counters() const
+		{   // statistics of the current (or last) run
+		tree_encryption_result r;
+		r.files = MyFiles.load();
+		r.directories = MyDirectories.load();
+		r.skipped = MySkipped.load();
+		r.errors = MyErrors.load();
+		const clock_type::rep end = MyEnd.load();
+		r.seconds = 1e-9 * double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::duration(
+			(end != 0 ? end : clock_type::now().time_since_epoch().count()) - MyStart.load())).count());
+		MyStages[0].Snapshot(r.enumerate, 1);
+		MyStages[1].Snapshot(r.read, MyOptions.readers);
+		MyStages[2].Snapshot(r.cipher, MyOptions.ciphers);
+		MyStages[3].Snapshot(r.write, MyOptions.writers);
+		return (r);
+		}
+
+	const tree_encryption_options& options() const
+		{   // parameters (defaults resolved)
+		return (MyOptions);
+		}
+
+private:
+	typedef std::chrono::steady_clock clock_type;
+
+	struct Stage_counters
+		{   // live counters of one stage
+		std::atomic<unsigned long long> MyItems{0};
+		std::atomic<unsigned long long> MyBytes{0};
+		std::atomic<long long> MyBusy{0}; // ns
+		std::atomic<long long> MyWait{0}; // ns
+
+		void Busy(clock_type::time_point start, unsigned long long bytes, long long waited = 0)
+			{   // one item done, processing started at start (minus the time waited in between)
+			MyItems.fetch_add(1, std::memory_order_relaxed);
+			MyBytes.fetch_add(bytes, std::memory_order_relaxed);
+			MyBusy.fetch_add(Since(start) - waited, std::memory_order_relaxed);
+			}
+
+		long long Wait(clock_type::time_point start)
+			{   // blocked since start, return the nanoseconds
+			const long long ns = Since(start);
+			MyWait.fetch_add(ns, std::memory_order_relaxed);
+			return (ns);
+			}
+
+		static long long Since(clock_type::time_point start)
+			{   // nanoseconds since start
+			return (std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+			}
+
+		void Snapshot(tree_stage_stats& s, unsigned threads) const
+			{   // copy of the counters
+			s.threads = threads;
+			s.items = MyItems.load(std::memory_order_relaxed);
+			s.bytes = MyBytes.load(std::memory_order_relaxed);
+			s.busy_seconds = MyBusy.load(std::memory_order_relaxed) * 1e-9;
+			s.wait_seconds = MyWait.load(std::memory_order_relaxed) * 1e-9;
+			}
+
+		void Reset()
+			{   // start from zero
+			MyItems.store(0);
+			MyBytes.store(0);
+			MyBusy.store(0);
+			MyWait.store(0);
+			}
+		};
+
+	struct Output_file
+		{   // destination of a file, closed (or removed, if failed) with its last chunk
+		Output_file(int fd, const path_type& path)
+			: MyFd(fd)
+			, MyPath(path)
+			, MyFailed(false)
+			{
+			}
+
+		~Output_file()
+			{
+			if(MyFd >= 0 && ::close(MyFd) != 0)
+				MyFailed = true;
+			if(MyFailed)
+				::unlink(MyPath.c_str());
+			}
+
+		Output_file(const Output_file&) = delete;
+		Output_file& operator = (const Output_file&) = delete;
+
+		int MyFd;
+		path_type MyPath;
+		std::atomic<bool> MyFailed;
+		};
+
+	struct File_job
+		{   // regular file found by the enumeration
+		path_type src;
+		path_type dst;
+		unsigned long long size;
+		};
+
+	struct Segment
+		{   // piece of one file in a chunk
+		std::shared_ptr<Output_file> out;
+		std::shared_ptr<filesys::mapped_file> map; // input mapping (large files)
+		const bit8* in;         // input: in the mapping, nullptr: in the chunk buffer
+		std::size_t offset;     // position in the chunk buffer
+		std::size_t length;
+		unsigned long long pos; // position in the keystream (plaintext offset)
+		off_t out_offset;       // position in the output file
+		bit8 iv[16];
+		};
+
+	struct Chunk
+		{   // one work item of the cipher and write stages
+		bit8* buffer;           // from the pool
+		std::size_t used;
+		std::vector<Segment> segments;
+		};
+
+	typedef std::unique_ptr<Chunk> Chunk_ptr;
+
+	void Reset(tree_direction direction)
+		{   // counters of a new run
+		MyDirection = direction;
+		MyFiles.store(0);
+		MyDirectories.store(0);
+		MySkipped.store(0);
+		MyErrors.store(0);
+		for(auto& s : MyStages)
+			s.Reset();
+		MyStart.store(clock_type::now().time_since_epoch().count());
+		MyEnd.store(0);
+		}
+
+	void Enumerate(const path_type& src, const path_type& dst, Blocking_queue<File_job>& files)
+		{   // stage 1: walk the tree, create the directories, queue the files
+		Stage_counters& stage = MyStages[0];
+		std::vector<std::pair<path_type, path_type>> stack(1, std::make_pair(src, dst));
+		bool have_dst = false; // identity of the destination root
+		dev_t dst_dev = 0;
+		ino_t dst_ino = 0;
+		while(!stack.empty())
+			{
+			const std::pair<path_type, path_type> d = std::move(stack.back());
+			stack.pop_back();
+			const clock_type::time_point start = clock_type::now();
+			long long waited = 0;
+			unsigned long long bytes = 0;
+			struct stat st;
+			if(::stat(d.first.c_str(), &st) != 0)
+				{   // source vanished or not accessible
+				++MyErrors;
+				continue;
+				}
+			if(have_dst && st.st_dev == dst_dev && st.st_ino == dst_ino)
+				continue; // the destination lies inside the source: don't process the output
+			filesys::directory_iterator it(d.first);
+			if(it == filesys::directory_iterator() && it.error() != 0)
+				{   // source not readable: its subtree is lost
+				++MyErrors;
+				continue;
+				}
+			if(::mkdir(d.second.c_str(), 0700) != 0 && errno != EEXIST)
+				{   // destination not writable: skip the subtree
+				++MyErrors;
+				continue;
+				}
+			if(!have_dst)
+				{   // root: remember the destination, it must not be the source
+				struct stat ds;
+				if(::stat(d.second.c_str(), &ds) != 0 || (ds.st_dev == st.st_dev && ds.st_ino == st.st_ino))
+					{
+					++MyErrors;
+					break;
+					}
+				dst_dev = ds.st_dev;
+				dst_ino = ds.st_ino;
+				have_dst = true;
+				}
+			++MyDirectories;
+			for(; it != filesys::directory_iterator(); ++it)
+				{
+				const char* name = it->c_str();
+				if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+					continue;
+				if(it->is_directory())
+					stack.push_back(std::make_pair(d.first + name + '/', d.second + name + '/'));
+				else if(!it->is_regular_file())
+					++MySkipped;
+				else
+					{
+					File_job job = {d.first + name, d.second + name, it->file_size()};
+					bytes += job.size;
+					const clock_type::time_point wait = clock_type::now();
+					files.push(std::move(job));
+					waited += stage.Wait(wait);
+					}
+				}
+			if(it.error() != 0)
+				++MyErrors; // the listing ended early: the rest of the directory is lost
+			stage.Busy(start, bytes, waited); // items: directories
+			}
+		files.close();
+		}
+
+	void Read(Blocking_queue<File_job>& files, Blocking_queue<bit8*>& pool, Blocking_queue<Chunk_ptr>& plain)
+		{   // stage 2: open the files, fill chunks (small files batched, large files split)
+		Stage_counters& stage = MyStages[1];
+		Chunk_ptr batch; // chunk with small files
+		File_job job;
+		for(;;)
+			{
+			if(!files.try_pop(job))
+				{   // nothing queued: pass the batch on instead of holding it back
+				if(batch)
+					Dispatch(batch, plain);
+				const clock_type::time_point wait = clock_type::now();
+				const bool more = files.pop(job);
+				stage.Wait(wait);
+				if(!more)
+					break;
+				}
+			const clock_type::time_point start = clock_type::now();
+			long long waited = 0;
+			const unsigned long long n = Read_file(job, batch, pool, plain, waited);
+			stage.Busy(start, n, waited);
+			}
+		if(batch)
+			Dispatch(batch, plain);
+		}
+
+	unsigned long long Read_file(const File_job& job, Chunk_ptr& batch, Blocking_queue<bit8*>& pool,
+			Blocking_queue<Chunk_ptr>& plain, long long& waited)
+		{   // queue the chunks of one file, return the bytes read (waited: ns blocked on the pool or the queue)
+		const int in = ::open(job.src.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if(in < 0 || ::fstat(in, &st) != 0)
+			{
+			if(in >= 0)
+				::close(in);
+			++MyErrors;
+			return (0);
+			}
+		Segment seg;
+		seg.in = nullptr;
+		seg.offset = 0;
+		seg.pos = 0;
+		unsigned long long in_offset = 0;
+		unsigned long long size = static_cast<unsigned long long>(st.st_size);
+		if(MyDirection == tree_direction::decrypt)
+			{   // header: magic and iv
+			bit8 header[TREE_ENCRYPTION_HEADER];
+			if(!Read_all(in, header, sizeof(header), 0) || std::memcmp(header, TREE_ENCRYPTION_MAGIC, 8) != 0)
+				{   // not encrypted by this class
+				::close(in);
+				++MyErrors;
+				return (0);
+				}
+			std::memcpy(seg.iv, header + 8, 16);
+			in_offset = TREE_ENCRYPTION_HEADER;
+			size -= TREE_ENCRYPTION_HEADER;
+			seg.out_offset = 0;
+			}
+		else
+			{
+			aes256_ctr_drbg::this_thread().generate(seg.iv, 16);
+			seg.out_offset = TREE_ENCRYPTION_HEADER;
+			}
+
+		const int out = ::open(job.dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+		if(out < 0)
+			{
+			::close(in);
+			++MyErrors;
+			return (0);
+			}
+		const std::shared_ptr<Output_file> file = std::make_shared<Output_file>(out, job.dst);
+		seg.out = file;
+		if(MyDirection == tree_direction::encrypt)
+			{   // header: magic and iv
+			bit8 header[TREE_ENCRYPTION_HEADER];
+			std::memcpy(header, TREE_ENCRYPTION_MAGIC, 8);
+			std::memcpy(header + 8, seg.iv, 16);
+			if(!Write_all(out, header, sizeof(header), 0))
+				file->MyFailed = true;
+			}
+
+		bool ok = true;
+		if(size < MyOptions.chunk_size)
+			{   // small file: into the batch
+			if(batch && batch->used + size > MyOptions.chunk_size)
+				waited += Dispatch(batch, plain);
+			if(!batch)
+				batch = New_chunk(pool, waited);
+			seg.offset = batch->used;
+			seg.length = static_cast<std::size_t>(size);
+			ok = Read_all(in, batch->buffer + seg.offset, seg.length, in_offset);
+			batch->used += seg.length;
+			batch->segments.push_back(std::move(seg));
+			}
+		else
+			{   // large file: one chunk per chunk_size bytes
+			if(MyOptions.use_mmap && size >= MyOptions.mmap_threshold)
+				{
+				seg.map = std::make_shared<filesys::mapped_file>(job.src.c_str());
+				if(!seg.map->is_open() || seg.map->size() != in_offset + size)
+					seg.map.reset(); // e.g. changed in the meantime: read it
+				}
+			const off_t out_base = seg.out_offset;
+			for(unsigned long long pos=0; ok && pos<size; pos+=MyOptions.chunk_size)
+				{
+				Chunk_ptr chunk = New_chunk(pool, waited);
+				Segment s = seg;
+				s.length = static_cast<std::size_t>(std::min<unsigned long long>(MyOptions.chunk_size, size - pos));
+				s.pos = pos;
+				s.out_offset = out_base + static_cast<off_t>(pos);
+				if(s.map)
+					s.in = s.map->data() + in_offset + pos;
+				else
+					ok = Read_all(in, chunk->buffer, s.length, in_offset + pos);
+				chunk->used = s.length;
+				chunk->segments.push_back(std::move(s));
+				waited += Dispatch(chunk, plain);
+				}
+			}
+		::close(in);
+		if(!ok)
+			{
+			file->MyFailed = true;
+			++MyErrors;
+			return (0);
+			}
+		++MyFiles;
+		return (size);
+		}
+
+	Chunk_ptr New_chunk(Blocking_queue<bit8*>& pool, long long& waited)
+		{   // empty chunk with a buffer of the pool (waits for a free one)
+		Chunk_ptr c(new Chunk());
+		c->used = 0;
+		const clock_type::time_point wait = clock_type::now();
+		pool.pop(c->buffer);
+		waited += MyStages[1].Wait(wait);
+		return (c);
+		}
+
+	long long Dispatch(Chunk_ptr& chunk, Blocking_queue<Chunk_ptr>& plain)
+		{   // pass a chunk to the cipher stage, return the ns blocked
+		const clock_type::time_point wait = clock_type::now();
+		plain.push(std::move(chunk));
+		chunk.reset();
+		return (MyStages[1].Wait(wait));
+		}
+
+	void Encrypt(Blocking_queue<Chunk_ptr>& plain, Blocking_queue<Chunk_ptr>& done)
+		{   // stage 3: counter mode, in place or from the mapping into the buffer
+		Stage_counters& stage = MyStages[2];
+		Aes_ctr<Cipher> mode = MyMode;
+		Chunk_ptr chunk;
+		for(;;)
+			{
+			clock_type::time_point wait = clock_type::now();
+			if(!plain.pop(chunk))
+				break;
+			stage.Wait(wait);
+			const clock_type::time_point start = clock_type::now();
+			for(Segment& s : chunk->segments)
+				{
+				mode.set_iv(s.iv);
+				mode.seek(s.pos);
+				mode.process(s.in ? s.in : chunk->buffer + s.offset, chunk->buffer + s.offset, s.length);
+				s.map.reset(); // unmapped with the last chunk of the file
+				}
+			stage.Busy(start, chunk->used);
+			wait = clock_type::now();
+			done.push(std::move(chunk));
+			stage.Wait(wait);
+			}
+		}
+
+	void Write(Blocking_queue<Chunk_ptr>& done, Blocking_queue<bit8*>& pool)
+		{   // stage 4: pwrite every segment at its offset, return the buffer
+		Stage_counters& stage = MyStages[3];
+		Chunk_ptr chunk;
+		for(;;)
+			{
+			const clock_type::time_point wait = clock_type::now();
+			if(!done.pop(chunk))
+				break;
+			stage.Wait(wait);
+			const clock_type::time_point start = clock_type::now();
+			for(Segment& s : chunk->segments)
+				{
+				if(!s.out->MyFailed && !Write_all(s.out->MyFd, chunk->buffer + s.offset, s.length, s.out_offset))
+					{
+					s.out->MyFailed = true;
+					++MyErrors;
+					}
+				s.out.reset(); // closed with the last segment
+				}
+			pool.push(std::move(chunk->buffer));
+			stage.Busy(start, chunk->used);
+			}
+		}
+
+	static bool Read_all(int fd, bit8* p, std::size_t n, unsigned long long offset)
+		{   // pread exactly n bytes
+		while(n > 0)
+			{
+			const ssize_t r = ::pread(fd, p, n, static_cast<off_t>(offset));
+			if(r < 0 && errno == EINTR)
+				continue;
+			if(r <= 0)
+				return false; // error or shorter than expected
+			p += r;
+			n -= static_cast<std::size_t>(r);
+			offset += static_cast<unsigned long long>(r);
+			}
+		return true;
+		}
+
+	static bool Write_all(int fd, const bit8* p, std::size_t n, off_t offset)
+		{   // pwrite exactly n bytes
+		while(n > 0)
+			{
+			const ssize_t w = ::pwrite(fd, p, n, offset);
+			if(w < 0 && errno == EINTR)
+				continue;
+			if(w <= 0)
+				return false;
+			p += w;
+			n -= static_cast<std::size_t>(w);
+			offset += w;
+			}
+		return true;
+		}
+
+	tree_encryption_options MyOptions;
+	Aes_ctr<Cipher> MyMode; // key schedule
+	tree_direction MyDirection = tree_direction::encrypt;
+	std::atomic<unsigned long long> MyFiles{0};
+	std::atomic<unsigned long long> MyDirectories{0};
+	std::atomic<unsigned long long> MySkipped{0};
+	std::atomic<unsigned long long> MyErrors{0};
+	Stage_counters MyStages[4]; // enumerate, read, cipher, write
+	std::atomic<clock_type::rep> MyStart{0}; // time of run()
+	std::atomic<clock_type::rep> MyEnd{0};   // end of the last run (0: running)
+	};
+
+	typedef Tree_encryptor<aes256_cipher> aes256_tree_encryptor;
+
+};//end: namespace